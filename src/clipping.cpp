@@ -0,0 +1,139 @@
+#include "clipping.h"
+
+/*******************************************************************************
+ * Clip planes
+********************************************************************************
+** A clip space vertex v is inside a plane p when dot(p, v) >= 0. With the
+** projection from mat4_make_perspective(), the visible volume is
+**     -w <= x <= w,   -w <= y <= w,   0 <= z <= w
+*******************************************************************************/
+#define NUM_CLIP_PLANES 6
+
+static const vec4_t clip_planes[NUM_CLIP_PLANES] = {
+    {  0.0f,  0.0f,  1.0f, 0.0f       }, // Near:   z >= 0
+    {  0.0f,  0.0f, -1.0f, 1.0f       }, // Far:    z <= w
+    {  1.0f,  0.0f,  0.0f, GUARD_BAND }, // Left:   x >= -band * w
+    { -1.0f,  0.0f,  0.0f, GUARD_BAND }, // Right:  x <=  band * w
+    {  0.0f,  1.0f,  0.0f, GUARD_BAND }, // Bottom: y >= -band * w
+    {  0.0f, -1.0f,  0.0f, GUARD_BAND }  // Top:    y <=  band * w
+};
+
+static float plane_distance(const vec4_t& plane, const vec4_t& vertex)
+{
+    return plane.x * vertex.x + plane.y * vertex.y + plane.z * vertex.z +
+           plane.w * vertex.w;
+}
+
+/*******************************************************************************
+ * Create a polygon from a clip space triangle
+*******************************************************************************/
+polygon_t polygon_from_triangle(const vec4_t vertices[3],
+                                const tex2_t texcoords[3])
+{
+    polygon_t polygon = {};
+    for (int i = 0; i < 3; ++i)
+    {
+        polygon.vertices[i] = vertices[i];
+        polygon.texcoords[i] = texcoords[i];
+    }
+    polygon.num_vertices = 3;
+    return polygon;
+}
+
+/*******************************************************************************
+ * Clip a polygon against one plane
+*******************************************************************************/
+static void clip_polygon_against_plane(polygon_t& polygon, const vec4_t& plane)
+{
+    vec4_t inside_vertices[MAX_NUM_POLY_VERTICES];
+    tex2_t inside_texcoords[MAX_NUM_POLY_VERTICES];
+    int num_inside_vertices = 0;
+
+    // Walk every edge, from the previous vertex to the current one
+    int previous = polygon.num_vertices - 1;
+    float previous_distance = plane_distance(plane, polygon.vertices[previous]);
+    for (int current = 0; current < polygon.num_vertices; ++current)
+    {
+        float current_distance = plane_distance(plane,
+                                                polygon.vertices[current]);
+
+        // The edge crosses the plane: add the intersection point
+        if ((current_distance >= 0.0f) != (previous_distance >= 0.0f))
+        {
+            float t = previous_distance /
+                      (previous_distance - current_distance);
+            const vec4_t& a = polygon.vertices[previous];
+            const vec4_t& b = polygon.vertices[current];
+            const tex2_t& a_uv = polygon.texcoords[previous];
+            const tex2_t& b_uv = polygon.texcoords[current];
+
+            inside_vertices[num_inside_vertices] = {
+                a.x + t * (b.x - a.x),
+                a.y + t * (b.y - a.y),
+                a.z + t * (b.z - a.z),
+                a.w + t * (b.w - a.w)
+            };
+            inside_texcoords[num_inside_vertices] = {
+                a_uv.u + t * (b_uv.u - a_uv.u),
+                a_uv.v + t * (b_uv.v - a_uv.v)
+            };
+            ++num_inside_vertices;
+        }
+
+        if (current_distance >= 0.0f)
+        {
+            inside_vertices[num_inside_vertices] = polygon.vertices[current];
+            inside_texcoords[num_inside_vertices] = polygon.texcoords[current];
+            ++num_inside_vertices;
+        }
+
+        previous = current;
+        previous_distance = current_distance;
+    }
+
+    for (int i = 0; i < num_inside_vertices; ++i)
+    {
+        polygon.vertices[i] = inside_vertices[i];
+        polygon.texcoords[i] = inside_texcoords[i];
+    }
+    polygon.num_vertices = num_inside_vertices;
+}
+
+/*******************************************************************************
+ * Clip a polygon against every plane
+*******************************************************************************/
+bool clip_polygon(polygon_t& polygon)
+{
+    // Bit i set when the vertex is outside plane i
+    int all_outside = (1 << NUM_CLIP_PLANES) - 1;
+    int any_outside = 0;
+    for (int i = 0; i < polygon.num_vertices; ++i)
+    {
+        int outside = 0;
+        for (int p = 0; p < NUM_CLIP_PLANES; ++p)
+        {
+            if (plane_distance(clip_planes[p], polygon.vertices[i]) < 0.0f)
+            {
+                outside |= 1 << p;
+            }
+        }
+        all_outside &= outside;
+        any_outside |= outside;
+    }
+
+    if (all_outside)
+    {
+        polygon.num_vertices = 0; // Every vertex behind the same plane
+        return true;
+    }
+
+    // Only clip against the planes some vertex is actually outside of
+    for (int p = 0; p < NUM_CLIP_PLANES && polygon.num_vertices > 0; ++p)
+    {
+        if (any_outside & (1 << p))
+        {
+            clip_polygon_against_plane(polygon, clip_planes[p]);
+        }
+    }
+    return any_outside != 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "vector.h"
+#include "texture.h"
+
+// A triangle clipped by the 6 planes gains at most one vertex per plane
+#define MAX_NUM_POLY_VERTICES 10
+#define MAX_NUM_POLY_TRIANGLES (MAX_NUM_POLY_VERTICES - 2)
+
+// Left/right/top/bottom planes sit GUARD_BAND times further out than the
+// screen edges. Triangles hanging slightly off screen are left whole for the
+// rasterizer to clamp, while screen coordinates stay bounded.
+#define GUARD_BAND 4.0f
+
+/*******************************************************************************
+ * Structures
+*******************************************************************************/
+struct polygon_t
+{
+    vec4_t vertices[MAX_NUM_POLY_VERTICES];
+    tex2_t texcoords[MAX_NUM_POLY_VERTICES];
+    int    num_vertices = 0;
+};
+
+/*******************************************************************************
+ * Clipping Functions
+*******************************************************************************/
+polygon_t polygon_from_triangle(const vec4_t vertices[3],
+                                const tex2_t texcoords[3]);
+
+// Sutherland-Hodgman in homogeneous clip space (before the perspective
+// divide) against the near, far and guard band planes. Vertex positions and
+// texture coordinates are interpolated linearly, which is exact in clip space.
+// False when every vertex was inside: the polygon is left untouched.
+bool clip_polygon(polygon_t& polygon);
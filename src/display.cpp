@@ -1,13 +1,20 @@
 #include "display.h"
-#include "swap.h"
-#include "triangle.h"
-#include "texture.h"
+#include "raster.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
-#include <cmath>
+#include <cstring>
 
-float* z_buffer = nullptr;
+// SSE2 is part of x86-64, no runtime check needed
+#if defined(__SSE2__) || defined(_M_X64)
+#define DISPLAY_SSE2
+#include <emmintrin.h>
+#endif
+
+void*  z_buffer = nullptr;
+float* hiz_buffer = nullptr;
 
 /*******************************************************************************
  * Initialize SDL Window & Renderer
@@ -53,31 +60,140 @@ void destroy_window(SDL_API& sdl)
     SDL_DestroyWindow(sdl.window);
 }
 
+/*******************************************************************************
+ * Fill memory with a 32-bit pattern
+********************************************************************************
+** Full-screen clears are much bigger than the caches, so the bulk goes out
+** with non-temporal stores instead of evicting lines that are still useful.
+*******************************************************************************/
+static void stream_fill(void* memory, size_t count, uint32_t value)
+{
+    char* bytes = (char*)memory;
+    size_t i = 0;
+#ifdef DISPLAY_SSE2
+    // Scalar stores up to the first 16-byte boundary
+    while (i < count && ((uintptr_t)(bytes + i * 4) & 15) != 0)
+    {
+        memcpy(bytes + i * 4, &value, 4);
+        ++i;
+    }
+    const __m128i pattern = _mm_set1_epi32((int)value);
+    for (; i + 4 <= count; i += 4)
+    {
+        _mm_stream_si128((__m128i*)(bytes + i * 4), pattern);
+    }
+    _mm_sfence(); // Order the streaming stores before later reads
+#endif
+    for (; i < count; ++i)
+    {
+        memcpy(bytes + i * 4, &value, 4);
+    }
+}
+
 /*******************************************************************************
  * Clear Color Buffer
 *******************************************************************************/
 void clear_color_buffer(ColorBuffer& color_buffer, uint32_t color)
 {
-    // Set every pixel to 'color'
-    for (uint32_t row = 0; row < color_buffer.height; ++row)
+    stream_fill(color_buffer.memory, color_buffer_size(color_buffer), color);
+}
+
+void clear_z_buffer(ColorBuffer& color_buffer)
+{
+    uint32_t count = color_buffer_size(color_buffer);
+    switch (color_buffer.depth_format)
     {
-        for (uint32_t column = 0; column < color_buffer.width; ++column)
+        case DEPTH_FORMAT::FLOAT32:
+        {
+            const float far_depth = 1.0f;
+            uint32_t far_bits = 0;
+            memcpy(&far_bits, &far_depth, sizeof(far_bits));
+            stream_fill(z_buffer, count, far_bits);
+        } break;
+        case DEPTH_FORMAT::UNORM24:
         {
-            color_buffer.memory[color_buffer.width * row + column] = color;
+            stream_fill(z_buffer, count, 0x00FFFFFF);
+        } break;
+        case DEPTH_FORMAT::UNORM16:
+        {
+            // Two values per 32-bit word, then the odd one out
+            stream_fill(z_buffer, count / 2, 0xFFFFFFFF);
+            if (count & 1)
+            {
+                ((uint16_t*)z_buffer)[count - 1] = 0xFFFF;
+            }
+        } break;
+    }
+
+    if (hiz_buffer)
+    {
+        uint32_t blocks = hiz_width(color_buffer) * hiz_height(color_buffer);
+        for (uint32_t i = 0; i < blocks; ++i)
+        {
+            hiz_buffer[i] = 1.0f;
         }
     }
 }
 
-void clear_z_buffer(ColorBuffer& color_buffer)
+/*******************************************************************************
+ * Color buffer, depth buffers and detiling staging for the current size
+********************************************************************************
+** A LINEAR frame presented with LOCK_TEXTURE has no memory of its own, it is
+** drawn into the locked texture between begin_frame() and present_frame(). The
+** z-buffer follows the texture's pitch so both share pixel_index().
+*******************************************************************************/
+bool draws_into_texture(const ColorBuffer& color_buffer)
+{
+    return color_buffer.present_mode == PRESENT_MODE::LOCK_TEXTURE &&
+           color_buffer.layout == FRAME_LAYOUT::LINEAR;
+}
+
+static void allocate_frame(ColorBuffer& color_buffer)
 {
-    // Set every pixel to 'color'
-    for (uint32_t row = 0; row < color_buffer.height; ++row)
+    color_buffer.pitch = 0;
+    if (draws_into_texture(color_buffer))
     {
-        for (uint32_t column = 0; column < color_buffer.width; ++column)
+        // The pitch of a texture stays the same from one lock to the next
+        void* pixels = nullptr;
+        int pitch = 0;
+        if (color_buffer.texture &&
+            SDL_LockTexture(color_buffer.texture, NULL, &pixels, &pitch) == 0)
+        {
+            SDL_UnlockTexture(color_buffer.texture);
+            color_buffer.pitch = (uint32_t)pitch / sizeof(uint32_t);
+        }
+        else
         {
-            z_buffer[color_buffer.width * row + column] = 1.0f;
+            fprintf(stderr, "Error when locking the texture : %s\n",
+                    SDL_GetError());
+            color_buffer.present_mode = PRESENT_MODE::UPDATE_TEXTURE;
         }
     }
+
+    uint32_t size = color_buffer_size(color_buffer);
+    color_buffer.memory = nullptr;
+    if (!draws_into_texture(color_buffer))
+    {
+        color_buffer.memory = (uint32_t*)malloc(sizeof(uint32_t) * size);
+    }
+    z_buffer = malloc(depth_format_size(color_buffer.depth_format) * size);
+    color_buffer.staging = nullptr;
+    if (color_buffer.layout == FRAME_LAYOUT::TILED)
+    {
+        color_buffer.staging = (uint32_t*)malloc(sizeof(uint32_t) *
+                                                 color_buffer.width *
+                                                 color_buffer.height);
+    }
+}
+
+static void free_frame(ColorBuffer& color_buffer)
+{
+    free(color_buffer.memory);
+    free(color_buffer.staging);
+    free(z_buffer);
+    color_buffer.memory = nullptr;
+    color_buffer.staging = nullptr;
+    z_buffer = nullptr;
 }
 
 /*******************************************************************************
@@ -88,17 +204,18 @@ void create_color_buffer(SDL_API sdl, ColorBuffer& color_buffer)
     int width = 0;
     int height = 0;
     SDL_GetWindowSize(sdl.window, &width, &height);
-    color_buffer.memory = (uint32_t*)malloc(sizeof(uint32_t) * width * height);
     color_buffer.texture = SDL_CreateTexture(
         sdl.renderer,
-        SDL_PIXELFORMAT_RGBA32,
+        FRAME_PIXEL_FORMAT,
         SDL_TEXTUREACCESS_STREAMING,
         width,
         height
     );
     color_buffer.width = width;
     color_buffer.height = height;
-    z_buffer = (float*)malloc(sizeof(float) * width * height);
+    allocate_frame(color_buffer);
+    hiz_buffer = (float*)malloc(sizeof(float) * hiz_width(color_buffer) *
+                                hiz_height(color_buffer));
 }
 
 /*******************************************************************************
@@ -111,25 +228,23 @@ void resize_color_buffer(SDL_API sdl, ColorBuffer& color_buffer, uint32_t width,
     {
         SDL_DestroyTexture(color_buffer.texture);
     }
-    if (color_buffer.memory)
-    {
-        free(color_buffer.memory);
-    }
-    if (z_buffer)
+    free_frame(color_buffer);
+    if (hiz_buffer)
     {
-        free(z_buffer);
+        free(hiz_buffer);
     }
-    color_buffer.memory = (uint32_t*)malloc(sizeof(uint32_t) * width * height);
     color_buffer.texture = SDL_CreateTexture(
         sdl.renderer,
-        SDL_PIXELFORMAT_ARGB8888,
+        FRAME_PIXEL_FORMAT,
         SDL_TEXTUREACCESS_STREAMING,
         width,
         height
     );
     color_buffer.width = width;
     color_buffer.height = height;
-    z_buffer = (float*)malloc(sizeof(float) * width * height);
+    allocate_frame(color_buffer);
+    hiz_buffer = (float*)malloc(sizeof(float) * hiz_width(color_buffer) *
+                                hiz_height(color_buffer));
 }
 
 /*******************************************************************************
@@ -140,461 +255,565 @@ void destroy_color_buffer(ColorBuffer& color_buffer)
     color_buffer.width = 0;
     color_buffer.height = 0;
     SDL_DestroyTexture(color_buffer.texture);
-    free(color_buffer.memory);
-    color_buffer.memory = nullptr;
-    free(z_buffer);
+    free_frame(color_buffer);
+    free(hiz_buffer);
+    hiz_buffer = nullptr;
 }
 
 /*******************************************************************************
- * Draw a single pixel
+ * Depth Buffer Format
 *******************************************************************************/
-void draw_pixel(ColorBuffer& color_buffer, int x, int y, uint32_t color)
+uint32_t depth_format_size(DEPTH_FORMAT depth_format)
 {
-    if (x >= 0 && x < (int)color_buffer.width &&
-        y >= 0 && y < (int)color_buffer.height)
-    {
-        color_buffer.memory[color_buffer.width * y + x] = color;
-    }
+    return depth_format == DEPTH_FORMAT::UNORM16 ? 2 : 4;
 }
 
-/*******************************************************************************
- * Draw Grid
-*******************************************************************************/
-void draw_grid(ColorBuffer& color_buffer, uint32_t size, uint32_t color)
+void set_depth_format(ColorBuffer& color_buffer, DEPTH_FORMAT depth_format)
 {
-    if (size > 0)
+    color_buffer.depth_format = depth_format;
+    free(z_buffer);
+    z_buffer = malloc(depth_format_size(depth_format) *
+                      color_buffer_size(color_buffer));
+    clear_z_buffer(color_buffer);
+}
+
+void clear_depth(const ColorBuffer& color_buffer, uint32_t first,
+                 uint32_t count)
+{
+    switch (color_buffer.depth_format)
     {
-        for (uint32_t row = 0; row < color_buffer.height; row += size)
+        case DEPTH_FORMAT::FLOAT32:
         {
-            for (uint32_t col = 0; col < color_buffer.width; col += size)
-            {
-                color_buffer.memory[color_buffer.width * row + col] = color;
-            }
-        }
+            float* depth = (float*)z_buffer + first;
+            std::fill(depth, depth + count, 1.0f);
+        } break;
+        case DEPTH_FORMAT::UNORM24:
+        {
+            uint32_t* depth = (uint32_t*)z_buffer + first;
+            std::fill(depth, depth + count, 0x00FFFFFFu);
+        } break;
+        case DEPTH_FORMAT::UNORM16:
+        {
+            uint16_t* depth = (uint16_t*)z_buffer + first;
+            std::fill(depth, depth + count, (uint16_t)0xFFFF);
+        } break;
     }
 }
 
 /*******************************************************************************
- * Draw Rectangle
+ * Frame Layout
+********************************************************************************
+** In the TILED layout a FRAME_BLOCK_SIZE square block is 256 contiguous bytes
+** of color: a triangle touching it pulls in 4 cache lines instead of 8 rows
+** one framebuffer pitch apart, and the same goes for the depth values. SDL
+** wants rows, so the frame is detiled once, when it is presented.
 *******************************************************************************/
-void draw_rect(ColorBuffer& color_buffer, int x, int y, uint32_t width,
-               uint32_t height, uint32_t color)
+uint32_t color_buffer_size(const ColorBuffer& color_buffer)
 {
-    for (int row = 0; row < (int)height; ++row)
+    if (color_buffer.layout == FRAME_LAYOUT::LINEAR)
     {
-        for (int column = 0; column < (int)width; ++column)
-        {
-            int current_x = x + column;
-            int current_y = y + row;
-            draw_pixel(color_buffer, current_x, current_y, color);
-        }
+        return row_pitch(color_buffer) * color_buffer.height;
     }
+    uint32_t blocks_x = (color_buffer.width + FRAME_BLOCK_SIZE - 1) /
+                        FRAME_BLOCK_SIZE;
+    uint32_t blocks_y = (color_buffer.height + FRAME_BLOCK_SIZE - 1) /
+                        FRAME_BLOCK_SIZE;
+    return blocks_x * blocks_y * FRAME_BLOCK_SIZE * FRAME_BLOCK_SIZE;
 }
 
-/*******************************************************************************
- * Draw Line
-*******************************************************************************/
-void draw_line(ColorBuffer& color_buffer, int x0, int y0, int x1, int y1,
-               uint32_t color)
+void set_frame_layout(ColorBuffer& color_buffer, FRAME_LAYOUT layout)
 {
-    // Based on DDA
-    int delta_x = x1 - x0;
-    int delta_y = y1 - y0;
-
-    int side_length = abs(delta_x) >= abs(delta_y) ?
-                      abs(delta_x) :
-                      abs(delta_y);
-
-    // How much incerement x and y each step
-    float x_inc = delta_x / (float)side_length;
-    float y_inc = delta_y / (float)side_length;
-
-    float current_x = (float)x0;
-    float current_y = (float)y0;
-
-    for (int i = 0; i <= side_length; ++i)
+    free_frame(color_buffer);
+    color_buffer.layout = layout;
+    allocate_frame(color_buffer);
+    if (color_buffer.memory)
     {
-        draw_pixel(color_buffer, (int)round(current_x),
-                   (int)round(current_y), color);
-        current_x += x_inc;
-        current_y += y_inc;
+        clear_color_buffer(color_buffer, 0xFF000000);
     }
+    clear_z_buffer(color_buffer);
 }
 
-void draw_triangle(ColorBuffer& color_buffer,
-                   int x0, int y0,
-                   int x1, int y1,
-                   int x2, int y2,
-                   uint32_t color)
+void set_present_mode(ColorBuffer& color_buffer, PRESENT_MODE present_mode)
 {
-    draw_line(color_buffer, x0, y0, x1, y1, color);
-    draw_line(color_buffer, x1, y1, x2, y2, color);
-    draw_line(color_buffer, x2, y2, x0, y0, color);
+    free_frame(color_buffer);
+    color_buffer.present_mode = present_mode;
+    allocate_frame(color_buffer);
+    if (color_buffer.memory)
+    {
+        clear_color_buffer(color_buffer, 0xFF000000);
+    }
+    clear_z_buffer(color_buffer);
 }
 
-/*******************************************************************************
-** Draw a filled a triangle with a flat bottom
-********************************************************************************
-**
-**        (x0,y0)
-**          / \
-**         /   \
-**        /     \
-**       /       \
-**      /         \
-**  (x1,y1)------(x2,y2)
-**
-*******************************************************************************/
-void fill_flat_bottom_triangle(ColorBuffer& color_buffer, int x0, int y0,
-                               int x1, int y1, int x2, int y2, uint32_t color)
+// The frame row by row into 'out', rows 'pitch' pixels apart
+static void copy_rows(const ColorBuffer& color_buffer, uint32_t* out,
+                      uint32_t pitch)
 {
-    // Find the two slopes (two triangle legs)
-    float inv_slope_1 = (float)(x1 - x0) / (y1 - y0);
-    float inv_slope_2 = (float)(x2 - x0) / (y2 - y0);
+    if (color_buffer.layout == FRAME_LAYOUT::LINEAR)
+    {
+        for (uint32_t y = 0; y < color_buffer.height; ++y)
+        {
+            memcpy(out + pitch * y,
+                   color_buffer.memory + row_pitch(color_buffer) * y,
+                   sizeof(uint32_t) * color_buffer.width);
+        }
+        return;
+    }
 
-    // Start x_start and x_end from the top vertex (x0,y0)
-    float x_start = x0;
-    float x_end = x0;
+    // A block row is 8 contiguous pixels on both sides: two 16-byte moves
+    uint32_t width = color_buffer.width;
+    uint32_t full_blocks = width / FRAME_BLOCK_SIZE;
+    uint32_t tail = width % FRAME_BLOCK_SIZE;
+    for (uint32_t y = 0; y < color_buffer.height; ++y)
+    {
+        const uint32_t* source = color_buffer.memory + pixel_index(color_buffer,
+                                                                   0, (int)y);
+        uint32_t* destination = out + pitch * y;
+        for (uint32_t block = 0; block < full_blocks; ++block)
+        {
+#ifdef DISPLAY_SSE2
+            __m128i left = _mm_loadu_si128((const __m128i*)source);
+            __m128i right = _mm_loadu_si128((const __m128i*)(source + 4));
+            _mm_storeu_si128((__m128i*)destination, left);
+            _mm_storeu_si128((__m128i*)(destination + 4), right);
+#else
+            memcpy(destination, source, sizeof(uint32_t) * FRAME_BLOCK_SIZE);
+#endif
+            source += FRAME_BLOCK_SIZE * FRAME_BLOCK_SIZE;
+            destination += FRAME_BLOCK_SIZE;
+        }
+        memcpy(destination, source, sizeof(uint32_t) * tail);
+    }
+}
 
-    // Loop all the scanlines from top to bottom
-    for (int y = y0; y <= y2; y++)
+const uint32_t* linear_pixels(ColorBuffer& color_buffer)
+{
+    if (color_buffer.layout == FRAME_LAYOUT::LINEAR)
     {
-        draw_line(color_buffer, x_start, y, x_end, y, color);
-        x_start += inv_slope_1;
-        x_end += inv_slope_2;
+        return color_buffer.memory;
     }
+    copy_rows(color_buffer, color_buffer.staging, color_buffer.width);
+    return color_buffer.staging;
 }
 
 /*******************************************************************************
-** Draw a filled a triangle with a flat top
+ * Present
 ********************************************************************************
-**
-**  (x0,y0)------(x1,y1)
-**      \         /
-**       \       /
-**        \     /
-**         \   /
-**          \ /
-**        (x2,y2)
-**
+** With LOCK_TEXTURE no full-frame copy is left: a LINEAR frame already is the
+** texture, a TILED one is detiled straight into it instead of into 'staging'.
+** A frame drawn into memory of its own (see frame_ring.h) is copied into the
+** locked texture.
 *******************************************************************************/
-void fill_flat_top_triangle(ColorBuffer& color_buffer, int x0, int y0,
-                            int x1, int y1, int x2, int y2, uint32_t color)
+bool begin_frame(ColorBuffer& color_buffer)
 {
-    // Find the two slopes (two triangle legs)
-    float inv_slope_1 = (float)(x2 - x0) / (y2 - y0);
-    float inv_slope_2 = (float)(x2 - x1) / (y2 - y1);
-
-    // Start x_start and x_end from the bottom vertex (x2,y2)
-    float x_start = x2;
-    float x_end = x2;
+    if (!draws_into_texture(color_buffer))
+    {
+        return true;
+    }
 
-    // Loop all the scanlines from bottom to top
-    for (int y = y2; y >= y0; y--)
+    void* pixels = nullptr;
+    int pitch = 0;
+    if (SDL_LockTexture(color_buffer.texture, NULL, &pixels, &pitch) != 0)
+    {
+        fprintf(stderr, "Error when locking the texture : %s\n",
+                SDL_GetError());
+        return false;
+    }
+    if ((uint32_t)pitch / sizeof(uint32_t) != row_pitch(color_buffer))
     {
-        draw_line(color_buffer, x_start, y, x_end, y, color);
-        x_start -= inv_slope_1;
-        x_end -= inv_slope_2;
+        // Another texture than the one the z-buffer was sized for
+        SDL_UnlockTexture(color_buffer.texture);
+        return false;
     }
+    color_buffer.memory = (uint32_t*)pixels;
+    color_buffer.locked = true;
+    return true;
 }
 
-void draw_triangle_pixel(ColorBuffer& color_buffer,
-    int x, int y, uint32_t color,
-    vec4_t point_a, vec4_t point_b, vec4_t point_c)
+void present_frame(SDL_API sdl, ColorBuffer& color_buffer)
 {
-    vec2_t p = { x, y };
-    vec2_t a = { point_a.x, point_a.y };
-    vec2_t b = { point_b.x, point_b.y };
-    vec2_t c = { point_c.x, point_c.y };
+    if (color_buffer.present_mode == PRESENT_MODE::UPDATE_TEXTURE)
+    {
+        SDL_UpdateTexture(color_buffer.texture, NULL,
+                          linear_pixels(color_buffer),
+                          sizeof(uint32_t) * row_pitch(color_buffer));
+    }
+    else if (color_buffer.locked)
+    {
+        SDL_UnlockTexture(color_buffer.texture);
+        color_buffer.memory = nullptr;
+        color_buffer.locked = false;
+    }
+    else
+    {
+        void* pixels = nullptr;
+        int pitch = 0;
+        if (SDL_LockTexture(color_buffer.texture, NULL, &pixels, &pitch) == 0)
+        {
+            copy_rows(color_buffer, (uint32_t*)pixels,
+                      (uint32_t)pitch / sizeof(uint32_t));
+            SDL_UnlockTexture(color_buffer.texture);
+        }
+    }
 
-    // Calculate the barycentric coordinates of our point 'p' inside the triangle
-    vec3_t weights = barycentric_weights(a, b, c, p);
+    SDL_RenderTexture(sdl.renderer, color_buffer.texture, NULL, NULL);
+    SDL_RenderPresent(sdl.renderer);
+}
 
-    float alpha = weights.x;
-    float beta = weights.y;
-    float gamma = weights.z;
+/*******************************************************************************
+ * Full Color Buffer Rectangle
+*******************************************************************************/
+rect_t color_buffer_rect(const ColorBuffer& color_buffer)
+{
+    rect_t rect = {};
+    rect.max_x = (int)color_buffer.width - 1;
+    rect.max_y = (int)color_buffer.height - 1;
+    return rect;
+}
 
-    float interpolated_reciprocal_w;
+/*******************************************************************************
+ * Scissor
+*******************************************************************************/
+void set_scissor(ColorBuffer& color_buffer, int x, int y, uint32_t width,
+                 uint32_t height)
+{
+    color_buffer.scissor.min_x = x;
+    color_buffer.scissor.min_y = y;
+    color_buffer.scissor.max_x = (int)std::min<int64_t>((int64_t)x + width - 1,
+                                                        INT_MAX);
+    color_buffer.scissor.max_y = (int)std::min<int64_t>((int64_t)y + height - 1,
+                                                        INT_MAX);
+}
 
-    // Interpolate the value of 1/w for the current pixel
-    interpolated_reciprocal_w = (1 / point_a.w) * alpha + (1 / point_b.w) * beta + (1 / point_c.w) * gamma;
+void reset_scissor(ColorBuffer& color_buffer)
+{
+    color_buffer.scissor = { 0, 0, INT_MAX, INT_MAX };
+}
 
-    interpolated_reciprocal_w = 1.0f - interpolated_reciprocal_w;
+rect_t scissor_rect(const ColorBuffer& color_buffer)
+{
+    rect_t rect = color_buffer.scissor;
+    rect.min_x = std::max(rect.min_x, 0);
+    rect.min_y = std::max(rect.min_y, 0);
+    rect.max_x = std::min(rect.max_x, (int)color_buffer.width - 1);
+    rect.max_y = std::min(rect.max_y, (int)color_buffer.height - 1);
+    return rect;
+}
 
-    // Only draw the pixel if the depth value is less than the one previously stored in the z-buffer
-    if (interpolated_reciprocal_w < z_buffer[(color_buffer.width * y) + x])
-    {
-        draw_pixel(color_buffer, x, y, color);
-        // Update the z-buffer with the 1/w
-        z_buffer[(color_buffer.width * y) + x] = interpolated_reciprocal_w;
-    }
+/*******************************************************************************
+ * Hierarchical Z-Buffer Size
+*******************************************************************************/
+uint32_t hiz_width(const ColorBuffer& color_buffer)
+{
+    return (color_buffer.width + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE;
+}
+
+uint32_t hiz_height(const ColorBuffer& color_buffer)
+{
+    return (color_buffer.height + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE;
 }
 
 /*******************************************************************************
-** Draw a filled triangle with the flat-top/flat-bottom method
-** We split the original triangle in two, half flat-bottom and half flat-top
-********************************************************************************
-**
-**          (x0,y0)
-**            / \
-**           /   \
-**          /     \
-**         /       \
-**        /         \
-**   (x1,y1)------(mx,my)
-**       \_           \
-**          \_         \
-**            \_        \
-**               \_      \
-**                 \_     \
-**                    \_   \
-**                       \_ \
-**                          \
-**                        (x2,y2)
-**
+ * Draw a single pixel
 *******************************************************************************/
-void draw_filled_triangle(ColorBuffer& color_buffer,
-                          int x0, int y0, float z0, float w0,
-                          int x1, int y1, float z1, float w1,
-                          int x2, int y2, float z2, float w2,
-                          uint32_t color)
+void draw_pixel(ColorBuffer& color_buffer, int x, int y, uint32_t color)
 {
-    // Sort vertices by ascending y-coordinate (y0 < y1 < y2)
-    if (y0  > y1)
-    
-        int_swap(x0, x1);
-        int_swap(y0, y1);
-        float_swap(z0, z1);
-        float_swap(w0, w1);
-    
-    if (y1  > y2)
-    {
-        int_swap(x1, x2);
-        int_swap(y1, y2);
-        float_swap(z1, z2);
-        float_swap(w1, w2);
-    }
-    // y0 y1 might have changed due to swap
-    if (y0  > y1)
+    // Single pixels are checked, bigger shapes clamp to the scissor up front
+    rect_t scissor = scissor_rect(color_buffer);
+    if (x >= scissor.min_x && x <= scissor.max_x &&
+        y >= scissor.min_y && y <= scissor.max_y)
     {
-        int_swap(x0, x1);
-        int_swap(y0, y1);
-        float_swap(z0, z1);
-        float_swap(w0, w1);
+        color_buffer.memory[pixel_index(color_buffer, x, y)] = color;
     }
+}
 
-    vec4_t point_a = { x0, y0, z0, w0 };
-    vec4_t point_b = { x1, y1, z1, w1 };
-    vec4_t point_c = { x2, y2, z2, w2 };
-
-    ///////////////////////////////////////////////////////
-    // Render the upper part of the triangle (flat-bottom)
-    ///////////////////////////////////////////////////////
-    float inv_slope_1 = 0.0f;
-    float inv_slope_2 = 0.0f;
-
-    if (y1 - y0 != 0) inv_slope_1 = (float)(x1 - x0) / abs(y1 - y0);
-    if (y2 - y0 != 0) inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
+/*******************************************************************************
+ * Draw Grid
+*******************************************************************************/
+void draw_grid(ColorBuffer& color_buffer, uint32_t size, uint32_t color)
+{
+    draw_grid(color_buffer, size, color, scissor_rect(color_buffer));
+}
 
-    if (y1 - y0 != 0.0f)
+void draw_grid(ColorBuffer& color_buffer, uint32_t size, uint32_t color,
+               const rect_t& bounds)
+{
+    if (size > 0)
     {
-        for (int y = y0; y <= y1; ++y)
+        // First grid line at or after the bounds origin
+        int first_row = (bounds.min_y + (int)size - 1) / (int)size * (int)size;
+        int first_col = (bounds.min_x + (int)size - 1) / (int)size * (int)size;
+        for (int row = first_row; row <= bounds.max_y; row += size)
         {
-            int x_start = x1 + (y - y1) * inv_slope_1;
-            int x_end = x0 + (y - y0) * inv_slope_2;
-
-            if (x_end < x_start)
+            for (int col = first_col; col <= bounds.max_x; col += size)
             {
-                int_swap(x_start, x_end); // swap if x_start is to the right of x_end
-            }
-
-            for (int x = x_start; x < x_end; ++x)
-            {
-                // Draw our pixel with a solid color
-                draw_triangle_pixel(color_buffer, x, y, color, point_a, point_b, point_c);
+                color_buffer.memory[pixel_index(color_buffer, col, row)] = color;
             }
         }
     }
+}
 
-    ///////////////////////////////////////////////////////
-    // Render the bottom part of the triangle (flat-top)
-    ///////////////////////////////////////////////////////
-    inv_slope_1 = 0.0f;
-    inv_slope_2 = 0.0f;
+/*******************************************************************************
+ * Draw Rectangle
+*******************************************************************************/
+void draw_rect(ColorBuffer& color_buffer, int x, int y, uint32_t width,
+               uint32_t height, uint32_t color)
+{
+    draw_rect(color_buffer, x, y, width, height, color,
+              scissor_rect(color_buffer));
+}
 
-    if (y2 - y1 != 0.0f) inv_slope_1 = (float)(x2 - x1) / abs(y2 - y1);
-    if (y2 - y0 != 0.0f) inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
+void draw_rect(ColorBuffer& color_buffer, int x, int y, uint32_t width,
+               uint32_t height, uint32_t color, const rect_t& bounds)
+{
+    // Clamp once to the bounds, then fill without per pixel checks
+    int start_x = std::max(x, bounds.min_x);
+    int start_y = std::max(y, bounds.min_y);
+    int end_x = (int)std::min<int64_t>((int64_t)x + width - 1, bounds.max_x);
+    int end_y = (int)std::min<int64_t>((int64_t)y + height - 1, bounds.max_y);
 
-    if (y2 - y1 != 0.0f)
+    for (int row = start_y; row <= end_y; ++row)
     {
-        for (int y = y1; y <= y2; ++y)
+        for (int column = start_x; column <= end_x; ++column)
         {
-            int x_start = x1 + (y - y1) * inv_slope_1;
-            int x_end = x0 + (y - y0) * inv_slope_2;
-
-            if (x_end < x_start)
-            {
-                int_swap(x_start, x_end); // swap if x_start is to the right of x_end
-            }
-
-            for (int x = x_start; x < x_end; ++x)
-            {
-                // Draw our pixel with a solid color
-                draw_triangle_pixel(color_buffer, x, y, color, point_a, point_b, point_c);
-            }
+            color_buffer.memory[pixel_index(color_buffer, column, row)] = color;
         }
     }
 }
 
-void draw_texel(ColorBuffer& color_buffer,
-    int x, int y, uint32_t* texture,
-    vec4_t point_a, vec4_t point_b, vec4_t point_c,
-    tex2_t a_uv, tex2_t b_uv, tex2_t c_uv)
-{
-    vec2_t p = { x, y };
-    vec2_t a = { point_a.x, point_a.y };
-    vec2_t b = { point_b.x, point_b.y };
-    vec2_t c = { point_c.x, point_c.y };
-
-    // Calculate the barycentric coordinates of our point 'p' inside the triangle
-    vec3_t weights = barycentric_weights(a, b, c, p);
-
-    float alpha = weights.x;
-    float beta = weights.y;
-    float gamma = weights.z;
-
-    // Variables to store the interpolated values of U, V, and also 1/w for the current pixel
-    float interpolated_u;
-    float interpolated_v;
-    float interpolated_reciprocal_w;
-
-    // Perform the interpolation of all U/w and V/w values using barycentric weights and a factor of 1/w
-    interpolated_u = (a_uv.u / point_a.w) * alpha + (b_uv.u / point_b.w) * beta + (c_uv.u / point_c.w) * gamma;
-    interpolated_v = (a_uv.v / point_a.w) * alpha + (b_uv.v / point_b.w) * beta + (c_uv.v / point_c.w) * gamma;
-
-    // Also interpolate the value of 1/w for the current pixel
-    interpolated_reciprocal_w = (1 / point_a.w) * alpha + (1 / point_b.w) * beta + (1 / point_c.w) * gamma;
+/*******************************************************************************
+ * Draw Line
+********************************************************************************
+** Integer Bresenham: stepping i pixels along the major axis moves
+**     offset(i) = floor((2 * i * minor + major) / (2 * major))
+** pixels along the minor axis, i * minor / major rounded to nearest.
+** The line is clipped to the bounds before any pixel is written:
+** Cohen-Sutherland outcodes reject or accept it whole, otherwise the first and
+** last step inside are solved for in integers. Clipping in step space keeps
+** exactly the pixels of the unclipped line, so tiles drawing their part of a
+** line join up seamlessly.
+*******************************************************************************/
+#define OUTCODE_LEFT   1
+#define OUTCODE_RIGHT  2
+#define OUTCODE_TOP    4
+#define OUTCODE_BOTTOM 8
 
-    // Now we can divide back both interpolated values by 1/w
-    interpolated_u /= interpolated_reciprocal_w;
-    interpolated_v /= interpolated_reciprocal_w;
+static int outcode(int x, int y, const rect_t& bounds)
+{
+    int code = 0;
+    if (x < bounds.min_x) { code |= OUTCODE_LEFT; }
+    if (x > bounds.max_x) { code |= OUTCODE_RIGHT; }
+    if (y < bounds.min_y) { code |= OUTCODE_TOP; }
+    if (y > bounds.max_y) { code |= OUTCODE_BOTTOM; }
+    return code;
+}
 
-    // Map the UV coordinate to the full texture width and height
-    int tex_x = abs((int)(interpolated_u * texture_width)) % texture_width;
-    int tex_y = abs((int)(interpolated_v * texture_height)) % texture_height;
+// Rounded towards -infinity / +infinity, for 0 < b
+static int64_t floor_div(int64_t a, int64_t b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
 
-    interpolated_reciprocal_w = 1.0f - interpolated_reciprocal_w;
+static int64_t ceil_div(int64_t a, int64_t b)
+{
+    return -floor_div(-a, b);
+}
 
-    // Only draw the pixel if the depth value is less than the one previously stored in the z-buffer
-    if (interpolated_reciprocal_w < z_buffer[(color_buffer.width * y) + x])
+// Narrow [first, last] to the steps whose offset(i) lies in [low, high]
+static bool clip_steps(int64_t minor, int64_t major, int64_t low, int64_t high,
+                       int64_t& first, int64_t& last)
+{
+    if (minor == 0)
     {
-        draw_pixel(color_buffer, x, y, texture[(texture_width * tex_y) + tex_x]);
-        // Update the z-buffer with the 1/w
-        z_buffer[(color_buffer.width * y) + x] = interpolated_reciprocal_w;
+        return low <= 0 && 0 <= high && first <= last;
     }
+    first = std::max(first, ceil_div((2 * low - 1) * major, 2 * minor));
+    last = std::min(last, floor_div((2 * high + 1) * major - 1, 2 * minor));
+    return first <= last;
 }
 
-void draw_textured_triangle(ColorBuffer& color_buffer,
-                            int x0, int y0, float z0, float w0,
-                            int x1, int y1, float z1, float w1,
-                            int x2, int y2, float z2, float w2,
-                            float u0, float v0,
-                            float u1, float v1,
-                            float u2, float v2,
-                            uint32_t* texture)
+void draw_line(ColorBuffer& color_buffer, int x0, int y0, int x1, int y1,
+               uint32_t color)
 {
-    // Sort vertices by ascending y-coordinate (y0 < y1 < y2)
-    if (y0  > y1)
+    draw_line(color_buffer, x0, y0, x1, y1, color,
+              scissor_rect(color_buffer));
+}
+
+void draw_line(ColorBuffer& color_buffer, int x0, int y0, int x1, int y1,
+               uint32_t color, const rect_t& bounds)
+{
+    int code0 = outcode(x0, y0, bounds);
+    int code1 = outcode(x1, y1, bounds);
+    if (code0 & code1)
     {
-        int_swap(x0, x1);
-        int_swap(y0, y1);
-        float_swap(z0, z1);
-        float_swap(w0, w1);
-        float_swap(u0, u1);
-        float_swap(v0, v1);
+        return; // Both ends beyond the same edge
     }
-    if (y1  > y2)
+
+    // Horizontal and vertical lines: clamp the run, then fill it
+    if (y0 == y1)
     {
-        int_swap(x1, x2);
-        int_swap(y1, y2);
-        float_swap(z1, z2);
-        float_swap(w1, w2);
-        float_swap(u1, u2);
-        float_swap(v1, v2);
+        int first = std::max(std::min(x0, x1), bounds.min_x);
+        int last = std::min(std::max(x0, x1), bounds.max_x);
+        for (int x = first; x <= last; ++x)
+        {
+            color_buffer.memory[pixel_index(color_buffer, x, y0)] = color;
+        }
+        return;
     }
-    // y0 y1 might have changed due to swap
-    if (y0  > y1)
+    if (x0 == x1)
     {
-        int_swap(x0, x1);
-        int_swap(y0, y1);
-        float_swap(z0, z1);
-        float_swap(w0, w1);
-        float_swap(u0, u1);
-        float_swap(v0, v1);
+        int first = std::max(std::min(y0, y1), bounds.min_y);
+        int last = std::min(std::max(y0, y1), bounds.max_y);
+        for (int y = first; y <= last; ++y)
+        {
+            color_buffer.memory[pixel_index(color_buffer, x0, y)] = color;
+        }
+        return;
     }
 
-    vec4_t point_a = { x0, y0, z0, w0 };
-    vec4_t point_b = { x1, y1, z1, w1 };
-    vec4_t point_c = { x2, y2, z2, w2 };
-    tex2_t a_uv = { u0, v0 };
-    tex2_t b_uv = { u1, v1 };
-    tex2_t c_uv = { u2, v2 };
+    int64_t delta_x = (int64_t)x1 - x0;
+    int64_t delta_y = (int64_t)y1 - y0;
+    int step_x = delta_x > 0 ? 1 : -1;
+    int step_y = delta_y > 0 ? 1 : -1;
+    bool x_major = std::abs(delta_x) >= std::abs(delta_y);
 
-    ///////////////////////////////////////////////////////
-    // Render the upper part of the triangle (flat-bottom)
-    ///////////////////////////////////////////////////////
-    float inv_slope_1 = 0.0f;
-    float inv_slope_2 = 0.0f;
+    int64_t major = x_major ? std::abs(delta_x) : std::abs(delta_y);
+    int64_t minor = x_major ? std::abs(delta_y) : std::abs(delta_x);
+    int64_t first = 0;
+    int64_t last = major;
 
-    if (y1 - y0 != 0) inv_slope_1 = (float)(x1 - x0) / abs(y1 - y0);
-    if (y2 - y0 != 0) inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
-
-    if (y1 - y0 != 0.0f)
+    if (code0 | code1)
     {
-        for (int y = y0; y <= y1; ++y)
+        // Steps inside the bounds along x, then along y
+        int64_t low_x = step_x > 0 ? bounds.min_x - x0 : x0 - bounds.max_x;
+        int64_t high_x = step_x > 0 ? bounds.max_x - x0 : x0 - bounds.min_x;
+        int64_t low_y = step_y > 0 ? bounds.min_y - y0 : y0 - bounds.max_y;
+        int64_t high_y = step_y > 0 ? bounds.max_y - y0 : y0 - bounds.min_y;
+        int64_t low_major = x_major ? low_x : low_y;
+        int64_t high_major = x_major ? high_x : high_y;
+
+        first = std::max(first, low_major);
+        last = std::min(last, high_major);
+        if (!clip_steps(minor, major, x_major ? low_y : low_x,
+                        x_major ? high_y : high_x, first, last))
         {
-            int x_start = x1 + (y - y1) * inv_slope_1;
-            int x_end = x0 + (y - y0) * inv_slope_2;
+            return;
+        }
+    }
 
-            if (x_end < x_start)
-            {
-                int_swap(x_start, x_end); // swap if x_start is to the right of x_end
-            }
+    // Error term and minor offset at the first step drawn
+    int64_t numerator = 2 * first * minor + major;
+    int64_t offset = numerator / (2 * major);
+    int64_t error = numerator % (2 * major);
 
-            for (int x = x_start; x < x_end; ++x)
+    int64_t x = x0 + step_x * (x_major ? first : offset);
+    int64_t y = y0 + step_y * (x_major ? offset : first);
+    if (color_buffer.layout == FRAME_LAYOUT::TILED)
+    {
+        // Blocks break the constant row stride, address every pixel
+        int major_x = x_major ? step_x : 0;
+        int major_y = x_major ? 0 : step_y;
+        for (int64_t i = first; i <= last; ++i)
+        {
+            color_buffer.memory[pixel_index(color_buffer, (int)x, (int)y)] =
+                color;
+            x += major_x;
+            y += major_y;
+            error += 2 * minor;
+            if (error >= 2 * major)
             {
-                // Draw our pixel with the color that comes from the texture
-                draw_texel(color_buffer, x, y, texture, point_a, point_b, point_c, a_uv, b_uv, c_uv);
+                error -= 2 * major;
+                x += step_x - major_x;
+                y += step_y - major_y;
             }
         }
+        return;
     }
 
-    ///////////////////////////////////////////////////////
-    // Render the bottom part of the triangle (flat-top)
-    ///////////////////////////////////////////////////////
-    inv_slope_1 = 0.0f;
-    inv_slope_2 = 0.0f;
+    int64_t pixel = (int64_t)row_pitch(color_buffer) * y + x;
 
-    if (y2 - y1 != 0.0f) inv_slope_1 = (float)(x2 - x1) / abs(y2 - y1);
-    if (y2 - y0 != 0.0f) inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
-
-    if (y2 - y1 != 0.0f)
+    int64_t row_step = step_y * (int64_t)row_pitch(color_buffer);
+    int64_t major_step = x_major ? step_x : row_step;
+    int64_t minor_step = x_major ? row_step : step_x;
+    for (int64_t i = first; i <= last; ++i)
     {
-        for (int y = y1; y <= y2; ++y)
+        color_buffer.memory[pixel] = color;
+        pixel += major_step;
+        error += 2 * minor;
+        if (error >= 2 * major)
         {
-            int x_start = x1 + (y - y1) * inv_slope_1;
-            int x_end = x0 + (y - y0) * inv_slope_2;
+            error -= 2 * major;
+            pixel += minor_step;
+        }
+    }
+}
 
-            if (x_end < x_start)
-            {
-                int_swap(x_start, x_end); // swap if x_start is to the right of x_end
-            }
+void draw_triangle(ColorBuffer& color_buffer,
+                   int x0, int y0,
+                   int x1, int y1,
+                   int x2, int y2,
+                   uint32_t color)
+{
+    draw_line(color_buffer, x0, y0, x1, y1, color);
+    draw_line(color_buffer, x1, y1, x2, y2, color);
+    draw_line(color_buffer, x2, y2, x0, y0, color);
+}
 
-            for (int x = x_start; x < x_end; ++x)
-            {
-                // Draw our pixel with the color that comes from the texture
-                draw_texel(color_buffer, x, y, texture, point_a, point_b, point_c, a_uv, b_uv, c_uv);
-            }
-        }
+/*******************************************************************************
+** Draw a filled triangle with edge functions
+** The edge and 1/w values are set up once per triangle (see raster.cpp) and
+** the pixel loop only steps them by constant increments in x and y
+*******************************************************************************/
+void draw_filled_triangle(ColorBuffer& color_buffer,
+                          int x0, int y0, float z0, float w0,
+                          int x1, int y1, float z1, float w1,
+                          int x2, int y2, float z2, float w2,
+                          uint32_t color)
+{
+    const vec4_t points[3] = {
+        { (float)x0, (float)y0, z0, w0 },
+        { (float)x1, (float)y1, z1, w1 },
+        { (float)x2, (float)y2, z2, w2 }
+    };
+    const tex2_t texcoords[3] = {};
+
+    raster_triangle_t triangle;
+    if (raster_setup_triangle(triangle, color_buffer, points, texcoords))
+    {
+        raster_filled_triangle(color_buffer, triangle, color,
+                               scissor_rect(color_buffer));
     }
-}
\ No newline at end of file
+}
+
+/*******************************************************************************
+** Draw a textured triangle with edge functions
+** u/w, v/w and 1/w are interpolated linearly in screen space, then divided
+** back per pixel for perspective correct texture mapping
+*******************************************************************************/
+void draw_textured_triangle(ColorBuffer& color_buffer,
+                            int x0, int y0, float z0, float w0,
+                            int x1, int y1, float z1, float w1,
+                            int x2, int y2, float z2, float w2,
+                            float u0, float v0,
+                            float u1, float v1,
+                            float u2, float v2,
+                            uint32_t* texture)
+{
+    const vec4_t points[3] = {
+        { (float)x0, (float)y0, z0, w0 },
+        { (float)x1, (float)y1, z1, w1 },
+        { (float)x2, (float)y2, z2, w2 }
+    };
+    const tex2_t texcoords[3] = {
+        { u0, v0 },
+        { u1, v1 },
+        { u2, v2 }
+    };
+
+    raster_triangle_t triangle;
+    if (raster_setup_triangle(triangle, color_buffer, points, texcoords))
+    {
+        raster_textured_triangle(color_buffer, triangle, texture,
+                                 scissor_rect(color_buffer));
+    }
+}
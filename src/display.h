@@ -1,6 +1,9 @@
 #pragma once
 #include <SDL3/SDL.h>
 
+#include <climits>
+#include <cmath>
+
 /*******************************************************************************
  * Structures
 *******************************************************************************/
@@ -13,6 +16,15 @@ enum class RENDER_MODE
     TEXTURED_TRIANGLES,
     TEXTURED_TRIANGLES_AND_WIREFRAME
 };
+#define NUM_RENDER_MODES 6
+
+// How texture coordinates outside [0, 1] pick a texel
+enum class WRAP_MODE
+{
+    REPEAT,
+    CLAMP
+};
+#define NUM_WRAP_MODES 2
 
 struct SDL_API
 {
@@ -21,7 +33,54 @@ struct SDL_API
     bool          is_running  = false;
     bool          fullscreen  = true;
     bool          culling     = true;
+    bool          depth_test  = true;
     RENDER_MODE   render_mode = RENDER_MODE::FILLED_TRIANGLES;
+    WRAP_MODE     wrap_mode   = WRAP_MODE::REPEAT;
+};
+
+// Storage of z_buffer. Depth is (1/near - 1/w) / (1/near - 1/far) with the
+// depth range of the ColorBuffer, 0 at near and 1 at far, so it stays in
+// [0, 1] over the clipped range. The unorm formats keep 1/2^24 or 1/2^16
+// steps of it.
+enum class DEPTH_FORMAT
+{
+    FLOAT32,
+    UNORM24, // Low 24 bits of a 32-bit word, the top 8 bits spare
+    UNORM16
+};
+#define NUM_DEPTH_FORMATS 3
+
+// Pixel order of ColorBuffer::memory and z_buffer
+enum class FRAME_LAYOUT
+{
+    LINEAR, // Row by row
+    TILED   // FRAME_BLOCK_SIZE square blocks one after the other, row by row,
+            // and each block's pixels row by row. Padded to whole blocks.
+};
+#define FRAME_BLOCK_SIZE 8
+
+// How a finished frame reaches the streaming texture
+enum class PRESENT_MODE
+{
+    UPDATE_TEXTURE, // Drawn into owned memory, copied with SDL_UpdateTexture
+    LOCK_TEXTURE    // LINEAR frames are drawn straight into the locked
+                    // texture, TILED ones are detiled into it
+};
+
+// Present mode the app starts in
+#define DEFAULT_PRESENT_MODE PRESENT_MODE::LOCK_TEXTURE
+
+// Texture format matching the 0xAARRGGBB colors in native byte order, so SDL
+// never converts the frame
+#define FRAME_PIXEL_FORMAT SDL_PIXELFORMAT_ARGB8888
+
+// Inclusive pixel rectangle
+struct rect_t
+{
+    int min_x = 0;
+    int min_y = 0;
+    int max_x = -1;
+    int max_y = -1;
 };
 
 struct ColorBuffer
@@ -30,9 +89,58 @@ struct ColorBuffer
     SDL_Texture* texture  = nullptr;
     uint32_t     width    = 0;
     uint32_t     height   = 0;
+    // Draw calls only write inside the scissor, clamped to the buffer size.
+    // Unbounded by default.
+    rect_t       scissor  = { 0, 0, INT_MAX, INT_MAX };
+    DEPTH_FORMAT depth_format = DEPTH_FORMAT::FLOAT32;
+    // View space w stored as depth 0 and 1, the projection's near and far
+    // planes. The defaults store 1 - 1/w.
+    float        depth_near   = 1.0f;
+    float        depth_far    = INFINITY;
+    FRAME_LAYOUT layout       = FRAME_LAYOUT::LINEAR;
+    uint32_t*    staging      = nullptr; // Linear copy of a TILED buffer
+    uint32_t     pitch        = 0; // LINEAR row stride in pixels, 0: width
+    PRESENT_MODE present_mode = PRESENT_MODE::UPDATE_TEXTURE;
+    bool         locked       = false; // 'memory' is the locked texture
 };
 
-extern float* z_buffer;
+// Hierarchical z-buffer: the farthest depth stored in each HIZ_BLOCK_SIZE
+// square block of z_buffer, so hidden triangles can be rejected per block
+// before any pixel work. Optional, ignored when null.
+#define HIZ_BLOCK_SIZE 8
+// The rows of a hierarchical z block are then contiguous in either layout
+static_assert(HIZ_BLOCK_SIZE == FRAME_BLOCK_SIZE,
+              "Hierarchical z blocks must match the TILED frame blocks");
+
+extern void*  z_buffer; // One value per pixel, in ColorBuffer::depth_format
+extern float* hiz_buffer;
+
+/*******************************************************************************
+ * Pixel Addressing
+*******************************************************************************/
+// Pixels from one LINEAR row to the next. Static so the copies inlined into
+// the AVX2 rasterizer are never linked anywhere else.
+static inline uint32_t row_pitch(const ColorBuffer& color_buffer)
+{
+    return color_buffer.pitch ? color_buffer.pitch : color_buffer.width;
+}
+
+// Index of pixel (x, y) in ColorBuffer::memory and z_buffer
+static inline uint32_t pixel_index(const ColorBuffer& color_buffer, int x,
+                                   int y)
+{
+    if (color_buffer.layout == FRAME_LAYOUT::LINEAR)
+    {
+        return row_pitch(color_buffer) * y + x;
+    }
+
+    uint32_t blocks_per_row = (color_buffer.width + FRAME_BLOCK_SIZE - 1) /
+                              FRAME_BLOCK_SIZE;
+    uint32_t block = blocks_per_row * (y / FRAME_BLOCK_SIZE) +
+                     x / FRAME_BLOCK_SIZE;
+    return block * FRAME_BLOCK_SIZE * FRAME_BLOCK_SIZE +
+           FRAME_BLOCK_SIZE * (y % FRAME_BLOCK_SIZE) + x % FRAME_BLOCK_SIZE;
+}
 
 /*******************************************************************************
  * SDL related Functions
@@ -49,16 +157,61 @@ void create_color_buffer(SDL_API sdl, ColorBuffer& color_buffer);
 void resize_color_buffer(SDL_API sdl, ColorBuffer& color_buffer, uint32_t width,
                          uint32_t height);
 void destroy_color_buffer(ColorBuffer& color_buffer);
+rect_t color_buffer_rect(const ColorBuffer& color_buffer);
+// Pixels stored, including the row padding or the padding to whole blocks
+uint32_t color_buffer_size(const ColorBuffer& color_buffer);
+// Reallocates the color buffer and z_buffer in the new layout, both cleared
+void set_frame_layout(ColorBuffer& color_buffer, FRAME_LAYOUT layout);
+// Reallocates the frame for the new present mode. LOCK_TEXTURE falls back to
+// UPDATE_TEXTURE when the texture cannot be locked.
+void set_present_mode(ColorBuffer& color_buffer, PRESENT_MODE present_mode);
+// Pixels row by row: the buffer itself when LINEAR (row_pitch() apart), else
+// detiled into 'staging' ('width' apart)
+const uint32_t* linear_pixels(ColorBuffer& color_buffer);
+// A LINEAR frame presented with LOCK_TEXTURE: drawn into the locked texture
+bool draws_into_texture(const ColorBuffer& color_buffer);
+// Makes 'memory' writable for a frame: locks the texture when drawing into it
+// directly. False when it cannot be locked, or its pitch is not the one the
+// buffers were made for: nothing may be drawn then.
+bool begin_frame(ColorBuffer& color_buffer);
+// Hands the frame to the texture and presents it
+void present_frame(SDL_API sdl, ColorBuffer& color_buffer);
+
+/*******************************************************************************
+ * Depth Buffer related Functions
+*******************************************************************************/
+uint32_t depth_format_size(DEPTH_FORMAT depth_format); // Bytes per pixel
+// Reallocates z_buffer in the new format, cleared to the far plane
+void     set_depth_format(ColorBuffer& color_buffer, DEPTH_FORMAT depth_format);
+// Resets 'count' z_buffer values from pixel 'first' on to the far plane
+void     clear_depth(const ColorBuffer& color_buffer, uint32_t first,
+                     uint32_t count);
+
+/*******************************************************************************
+ * Scissor related Functions
+*******************************************************************************/
+void   set_scissor(ColorBuffer& color_buffer, int x, int y, uint32_t width,
+                   uint32_t height);
+void   reset_scissor(ColorBuffer& color_buffer);
+rect_t scissor_rect(const ColorBuffer& color_buffer); // Clamped to the buffer
+uint32_t hiz_width(const ColorBuffer& color_buffer);
+uint32_t hiz_height(const ColorBuffer& color_buffer);
 
 /*******************************************************************************
  * Draw Functions
 *******************************************************************************/
 void draw_pixel(ColorBuffer& color_buffer, int x, int y, uint32_t color);
 void draw_grid(ColorBuffer& color_buffer, uint32_t size, uint32_t color);
+void draw_grid(ColorBuffer& color_buffer, uint32_t size, uint32_t color,
+               const rect_t& bounds);
 void draw_rect(ColorBuffer& color_buffer, int x, int y, uint32_t width,
                uint32_t height, uint32_t color);
+void draw_rect(ColorBuffer& color_buffer, int x, int y, uint32_t width,
+               uint32_t height, uint32_t color, const rect_t& bounds);
 void draw_line(ColorBuffer& color_buffer, int x0, int y0, int x1, int y1,
                uint32_t color);
+void draw_line(ColorBuffer& color_buffer, int x0, int y0, int x1, int y1,
+               uint32_t color, const rect_t& bounds);
 void draw_triangle(ColorBuffer& color_buffer,
                    int x0, int y0,
                    int x1, int y1,
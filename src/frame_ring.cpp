@@ -0,0 +1,210 @@
+#include "frame_ring.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+/*******************************************************************************
+ * Frame thread: draws the queued frames in order
+*******************************************************************************/
+static void frame_thread_main(frame_ring_t& ring)
+{
+    std::unique_lock<std::mutex> lock(ring.mutex);
+    while (true)
+    {
+        ring.wake.wait(lock, [&ring]() {
+            return ring.quit || ring.completed < ring.submitted;
+        });
+        if (ring.completed == ring.submitted)
+        {
+            return; // Quit once nothing is left to draw
+        }
+
+        // The calling thread leaves the slot alone until the frame is drawn
+        frame_slot_t& slot = ring.slots[ring.completed % ring.size];
+        lock.unlock();
+        slot.job(slot.target);
+        slot.job = nullptr;
+        lock.lock();
+
+        ++ring.completed;
+        ring.done.notify_all();
+    }
+}
+
+/*******************************************************************************
+ * Init & Destroy
+*******************************************************************************/
+void frame_ring_init(frame_ring_t& ring, uint32_t size, SDL_Renderer* renderer)
+{
+    ring.size = std::clamp<uint32_t>(size, 1, MAX_FRAMES_IN_FLIGHT);
+    ring.renderer = renderer;
+    ring.submitted = 0;
+    ring.completed = 0;
+    ring.presented = 0;
+    ring.quit = false;
+    if (ring.size > 1)
+    {
+        ring.thread = std::thread(frame_thread_main, std::ref(ring));
+    }
+}
+
+void frame_ring_destroy(frame_ring_t& ring)
+{
+    frame_ring_flush(ring);
+    if (ring.thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(ring.mutex);
+            ring.quit = true;
+        }
+        ring.wake.notify_all();
+        ring.thread.join();
+    }
+
+    for (frame_slot_t& slot : ring.slots)
+    {
+        free(slot.memory);
+        slot.memory = nullptr;
+        slot.capacity = 0;
+    }
+}
+
+/*******************************************************************************
+ * Slot textures
+*******************************************************************************/
+// Locks the slot's own texture as the memory of slot.target. The texture is
+// made at the size of the first frame after a flush.
+static bool lock_slot_texture(const frame_ring_t& ring, frame_slot_t& slot)
+{
+    if (!ring.renderer)
+    {
+        return false;
+    }
+    if (!slot.texture)
+    {
+        slot.texture = SDL_CreateTexture(ring.renderer, FRAME_PIXEL_FORMAT,
+                                         SDL_TEXTUREACCESS_STREAMING,
+                                         (int)slot.target.width,
+                                         (int)slot.target.height);
+        if (!slot.texture)
+        {
+            return false;
+        }
+    }
+    slot.target.texture = slot.texture;
+    return begin_frame(slot.target);
+}
+
+static void destroy_slot_textures(frame_ring_t& ring)
+{
+    for (frame_slot_t& slot : ring.slots)
+    {
+        if (slot.texture)
+        {
+            SDL_DestroyTexture(slot.texture);
+            slot.texture = nullptr;
+        }
+    }
+}
+
+/*******************************************************************************
+ * Render & Present
+*******************************************************************************/
+bool frame_ring_render(frame_ring_t& ring, const ColorBuffer& color_buffer,
+                       frame_job_t job)
+{
+    std::unique_lock<std::mutex> lock(ring.mutex);
+    if (ring.submitted - ring.presented >= ring.size)
+    {
+        return false;
+    }
+
+    // Free: the frame drawn in this slot before was presented
+    frame_slot_t& slot = ring.slots[ring.submitted % ring.size];
+    slot.target = color_buffer;
+    if (ring.size == 1)
+    {
+        lock.unlock();
+        if (!begin_frame(slot.target))
+        {
+            return false;
+        }
+        job(slot.target);
+        lock.lock();
+        ++ring.submitted;
+        ++ring.completed;
+        return true;
+    }
+
+    // Drawn straight into the slot's texture, or into its memory
+    if (!draws_into_texture(color_buffer) || !lock_slot_texture(ring, slot))
+    {
+        uint32_t pixels = color_buffer_size(color_buffer);
+        if (slot.capacity < pixels)
+        {
+            free(slot.memory);
+            slot.memory = (uint32_t*)malloc(sizeof(uint32_t) * pixels);
+            slot.capacity = pixels;
+        }
+        slot.target = color_buffer;
+        slot.target.memory = slot.memory;
+        slot.target.locked = false;
+    }
+    slot.job = std::move(job);
+    ++ring.submitted;
+    lock.unlock();
+    ring.wake.notify_one();
+    return true;
+}
+
+void frame_ring_present(frame_ring_t& ring, SDL_API sdl)
+{
+    std::unique_lock<std::mutex> lock(ring.mutex);
+    if (ring.submitted - ring.presented < ring.size)
+    {
+        return;
+    }
+
+    ring.done.wait(lock, [&ring]() {
+        return ring.completed > ring.presented;
+    });
+    frame_slot_t& slot = ring.slots[ring.presented % ring.size];
+    lock.unlock();
+    present_frame(sdl, slot.target);
+    lock.lock();
+    ++ring.presented;
+}
+
+uint32_t frame_ring_next_slot(const frame_ring_t& ring)
+{
+    // Only the calling thread queues frames
+    return (uint32_t)(ring.submitted % ring.size);
+}
+
+void frame_ring_wait(frame_ring_t& ring)
+{
+    std::unique_lock<std::mutex> lock(ring.mutex);
+    ring.done.wait(lock, [&ring]() {
+        return ring.completed == ring.submitted;
+    });
+}
+
+void frame_ring_flush(frame_ring_t& ring)
+{
+    std::unique_lock<std::mutex> lock(ring.mutex);
+    ring.done.wait(lock, [&ring]() {
+        return ring.completed == ring.submitted;
+    });
+    for (; ring.presented < ring.submitted; ++ring.presented)
+    {
+        frame_slot_t& slot = ring.slots[ring.presented % ring.size];
+        if (slot.target.locked)
+        {
+            SDL_UnlockTexture(slot.target.texture);
+            slot.target.locked = false;
+        }
+    }
+
+    // Made again at the size of the next frames
+    destroy_slot_textures(ring);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "display.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#define MAX_FRAMES_IN_FLIGHT 3
+// Frames the app queues behind the one presented, in every present mode: one
+// frame of extra input latency
+#define FRAMES_IN_FLIGHT 1
+
+/*******************************************************************************
+ * Structures
+*******************************************************************************/
+// Draws a whole frame into 'color_buffer'
+typedef std::function<void(ColorBuffer& color_buffer)> frame_job_t;
+
+struct frame_slot_t
+{
+    uint32_t*    memory   = nullptr; // Color pixels owned by the slot
+    uint32_t     capacity = 0;       // In pixels
+    SDL_Texture* texture  = nullptr; // Streaming texture owned by the slot
+    ColorBuffer  target;             // The color buffer the frame was drawn as
+    frame_job_t  job;
+};
+
+struct frame_ring_t
+{
+    frame_slot_t            slots[MAX_FRAMES_IN_FLIGHT];
+    uint32_t                size      = 1;
+    SDL_Renderer*           renderer  = nullptr; // Makes the slot textures
+    uint64_t                submitted = 0; // Frames handed to frame_ring_render
+    uint64_t                completed = 0; // Frames drawn
+    uint64_t                presented = 0; // Frames presented or dropped
+    std::thread             thread;
+    std::mutex              mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool                    quit = false;
+};
+
+/*******************************************************************************
+ * Frame Ring
+********************************************************************************
+** With a ring of 2 or 3 color buffers, frames are drawn on a frame thread, one
+** after the other, while the calling thread presents the previous frame. SDL
+** wants its renderer used from the main thread, so presenting stays there and
+** drawing moves away: a frame costs max(draw, present) instead of the sum.
+** The depth buffers are shared, frames are drawn one at a time.
+**
+** Frames drawn into the locked texture (see draws_into_texture()) get a
+** streaming texture per slot, made with the ring's renderer: the calling
+** thread locks it before queuing the frame and unlocks it to present, so no
+** frame is copied. Without a renderer, or when the lock fails, the frame is
+** drawn into the slot's memory and copied into the texture when presented.
+**
+** Each frame: frame_ring_render() then frame_ring_present(). Up to size - 1
+** frames stay in flight behind the one being presented, which bounds the
+** latency. A ring of size 1 draws on the calling thread, straight into the
+** locked texture with LOCK_TEXTURE.
+**
+** The input of a frame job, like its triangles, is kept per slot too: between
+** frame_ring_present() and the next frame_ring_render(), the input of
+** frame_ring_next_slot() can be refilled while the queued frames are drawn.
+*******************************************************************************/
+void frame_ring_init(frame_ring_t& ring, uint32_t size,
+                     SDL_Renderer* renderer = nullptr);
+void frame_ring_destroy(frame_ring_t& ring);
+
+// Queues a frame drawn like 'color_buffer' is set up now. False when nothing
+// was queued: the ring is full, or the texture could not be locked.
+bool frame_ring_render(frame_ring_t& ring, const ColorBuffer& color_buffer,
+                       frame_job_t job);
+// Presents the oldest frame once size frames are in flight, after it is drawn
+void frame_ring_present(frame_ring_t& ring, SDL_API sdl);
+// Slot of the next frame queued, its previous frame is presented
+uint32_t frame_ring_next_slot(const frame_ring_t& ring);
+// Returns once every queued frame is drawn
+void frame_ring_wait(frame_ring_t& ring);
+// Waits, then drops the frames not presented yet. Needed before the color
+// buffer, its texture or the depth buffers change.
+void frame_ring_flush(frame_ring_t& ring);
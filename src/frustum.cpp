@@ -0,0 +1,163 @@
+#include "frustum.h"
+#include "clipping.h"
+
+#include <algorithm>
+#include <cmath>
+
+/*******************************************************************************
+ * Frustum planes
+*******************************************************************************/
+// Clip space planes, as in clipping.cpp: inside when dot(p, v) >= 0
+static void make_clip_planes(vec4_t out_planes[NUM_FRUSTUM_PLANES], float band)
+{
+    out_planes[0] = {  0.0f,  0.0f,  1.0f, 0.0f }; // Near:   z >= 0
+    out_planes[1] = {  0.0f,  0.0f, -1.0f, 1.0f }; // Far:    z <= w
+    out_planes[2] = {  1.0f,  0.0f,  0.0f, band }; // Left:   x >= -band * w
+    out_planes[3] = { -1.0f,  0.0f,  0.0f, band }; // Right:  x <=  band * w
+    out_planes[4] = {  0.0f,  1.0f,  0.0f, band }; // Bottom: y >= -band * w
+    out_planes[5] = {  0.0f, -1.0f,  0.0f, band }; // Top:    y <=  band * w
+}
+
+// Plane p as seen before 'mat': dot(p, mat * v) = dot(p * mat, v)
+static vec4_t transform_plane(const vec4_t& plane, const mat4_t& mat)
+{
+    vec4_t result = {};
+    for (int column = 0; column < 4; ++column)
+    {
+        result.data[column] = plane.x * mat.m[0][column] +
+                              plane.y * mat.m[1][column] +
+                              plane.z * mat.m[2][column] +
+                              plane.w * mat.m[3][column];
+    }
+    return result;
+}
+
+static vec4_t normalize_plane(const vec4_t& plane)
+{
+    float inverse = 1.0f / sqrtf(plane.x * plane.x + plane.y * plane.y +
+                                 plane.z * plane.z);
+    return { plane.x * inverse, plane.y * inverse, plane.z * inverse,
+             plane.w * inverse };
+}
+
+frustum_t make_frustum(const mat4_t& projection_matrix)
+{
+    frustum_t frustum = {};
+    vec4_t visible_planes[NUM_FRUSTUM_PLANES];
+    vec4_t clip_planes[NUM_FRUSTUM_PLANES];
+    make_clip_planes(visible_planes, 1.0f);
+    make_clip_planes(clip_planes, GUARD_BAND);
+    for (int i = 0; i < NUM_FRUSTUM_PLANES; ++i)
+    {
+        frustum.visible_planes[i] = normalize_plane(
+            transform_plane(visible_planes[i], projection_matrix));
+        frustum.clip_planes[i] = normalize_plane(
+            transform_plane(clip_planes[i], projection_matrix));
+    }
+    return frustum;
+}
+
+/*******************************************************************************
+ * Bounds against the planes
+*******************************************************************************/
+static FRUSTUM_TEST test_sphere(const vec4_t planes[NUM_FRUSTUM_PLANES],
+                                const vec3_t& center, float radius)
+{
+    FRUSTUM_TEST result = FRUSTUM_TEST::INSIDE;
+    for (int i = 0; i < NUM_FRUSTUM_PLANES; ++i)
+    {
+        float distance = planes[i].x * center.x + planes[i].y * center.y +
+                         planes[i].z * center.z + planes[i].w;
+        if (distance < -radius)
+        {
+            return FRUSTUM_TEST::OUTSIDE;
+        }
+        if (distance < radius)
+        {
+            result = FRUSTUM_TEST::INTERSECTING;
+        }
+    }
+    return result;
+}
+
+// Planes already in object space, not normalized
+static FRUSTUM_TEST test_box(const vec4_t planes[NUM_FRUSTUM_PLANES],
+                             const vec3_t& center, const vec3_t& extent)
+{
+    FRUSTUM_TEST result = FRUSTUM_TEST::INSIDE;
+    for (int i = 0; i < NUM_FRUSTUM_PLANES; ++i)
+    {
+        // Distance of the center, and how far the box reaches along the plane
+        // normal
+        float distance = planes[i].x * center.x + planes[i].y * center.y +
+                         planes[i].z * center.z + planes[i].w;
+        float reach = fabsf(planes[i].x) * extent.x +
+                      fabsf(planes[i].y) * extent.y +
+                      fabsf(planes[i].z) * extent.z;
+        if (distance < -reach)
+        {
+            return FRUSTUM_TEST::OUTSIDE;
+        }
+        if (distance < reach)
+        {
+            result = FRUSTUM_TEST::INTERSECTING;
+        }
+    }
+    return result;
+}
+
+// Outside the visible volume first, then inside the clip planes
+static FRUSTUM_TEST combine_tests(FRUSTUM_TEST visible, FRUSTUM_TEST clip)
+{
+    if (visible == FRUSTUM_TEST::OUTSIDE)
+    {
+        return FRUSTUM_TEST::OUTSIDE;
+    }
+    return clip == FRUSTUM_TEST::INSIDE ? FRUSTUM_TEST::INSIDE
+                                        : FRUSTUM_TEST::INTERSECTING;
+}
+
+FRUSTUM_TEST frustum_test_sphere(const frustum_t& frustum, const vec3_t& center,
+                                 float radius)
+{
+    return combine_tests(test_sphere(frustum.visible_planes, center, radius),
+                         test_sphere(frustum.clip_planes, center, radius));
+}
+
+FRUSTUM_TEST frustum_test_box(const frustum_t& frustum,
+                              const mat4_t& world_matrix, const vec3_t& min,
+                              const vec3_t& max)
+{
+    vec4_t visible_planes[NUM_FRUSTUM_PLANES];
+    vec4_t clip_planes[NUM_FRUSTUM_PLANES];
+    for (int i = 0; i < NUM_FRUSTUM_PLANES; ++i)
+    {
+        visible_planes[i] = transform_plane(frustum.visible_planes[i],
+                                            world_matrix);
+        clip_planes[i] = transform_plane(frustum.clip_planes[i], world_matrix);
+    }
+    vec3_t center = (min + max) * 0.5f;
+    vec3_t extent = (max - min) * 0.5f;
+    return combine_tests(test_box(visible_planes, center, extent),
+                         test_box(clip_planes, center, extent));
+}
+
+FRUSTUM_TEST frustum_test_mesh(const frustum_t& frustum, const mesh_t& in_mesh,
+                               const mat4_t& world_matrix)
+{
+    // World space sphere: the radius grows with the largest axis scale
+    vec3_t center = world_matrix.mul_vec4(
+        in_mesh.sphere_center.to_vec4()).to_vec3();
+    float radius = in_mesh.sphere_radius *
+                   mat4_max_axis_scale(world_matrix);
+
+    // Conclusive when the sphere is out of view or all in view, otherwise the
+    // box may still be out of view
+    FRUSTUM_TEST visible = test_sphere(frustum.visible_planes, center, radius);
+    if (visible != FRUSTUM_TEST::INTERSECTING)
+    {
+        return visible;
+    }
+    return frustum_test_box(frustum, world_matrix, in_mesh.bounds_min,
+                            in_mesh.bounds_max);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "matrix.h"
+#include "mesh.h"
+#include "vector.h"
+
+#define NUM_FRUSTUM_PLANES 6
+
+/*******************************************************************************
+ * Structures
+*******************************************************************************/
+enum class FRUSTUM_TEST
+{
+    OUTSIDE,      // Nothing of it can be seen
+    INTERSECTING,
+    INSIDE        // Inside the clip planes, nothing to clip
+};
+
+// World space planes, inside when dot(plane.xyz, p) + plane.w >= 0
+struct frustum_t
+{
+    vec4_t visible_planes[NUM_FRUSTUM_PLANES]; // Near, far and screen edges
+    vec4_t clip_planes[NUM_FRUSTUM_PLANES];    // As clip_polygon() clips
+};
+
+/*******************************************************************************
+ * Frustum Culling
+********************************************************************************
+** The planes come from the projection matrix: a clip space plane p becomes
+** p * projection in world space. An object is tested with its bounding sphere
+** first, and with its box in object space when the sphere is not conclusive.
+**
+** OUTSIDE is tested against the visible volume, INSIDE against the clip
+** planes: with the guard band, objects hanging off the screen edges still
+** skip clipping.
+*******************************************************************************/
+frustum_t    make_frustum(const mat4_t& projection_matrix);
+FRUSTUM_TEST frustum_test_sphere(const frustum_t& frustum, const vec3_t& center,
+                                 float radius);
+// The object space box of a mesh placed with 'world_matrix'
+FRUSTUM_TEST frustum_test_box(const frustum_t& frustum,
+                              const mat4_t& world_matrix, const vec3_t& min,
+                              const vec3_t& max);
+FRUSTUM_TEST frustum_test_mesh(const frustum_t& frustum, const mesh_t& in_mesh,
+                               const mat4_t& world_matrix);
@@ -0,0 +1,245 @@
+#include "geometry.h"
+#include "clipping.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+
+/*******************************************************************************
+ * Faces to triangles
+*******************************************************************************/
+// The view in the object space of the mesh, derived once per call
+struct object_view_t
+{
+    vec3_t camera;
+    float  facing;        // -1 when the world matrix mirrors, flipping faces
+    float  scale;         // Largest axis scale of the world matrix
+    mat4_t normal_matrix; // Object to world space normals, no translation
+};
+
+static object_view_t make_object_view(const geometry_view_t& view)
+{
+    object_view_t object = {};
+    mat4_t inverse = mat4_inverse_affine(view.world_matrix);
+    object.camera = inverse.mul_vec4(view.camera_pos.to_vec4()).to_vec3();
+    object.facing = mat4_determinant_3x3(view.world_matrix) < 0.0f ? -1.0f
+                                                                    : 1.0f;
+    object.scale = mat4_max_axis_scale(view.world_matrix);
+
+    // Inverse transpose, signed so the normals keep the winding of the face
+    object.normal_matrix = mat4_identity();
+    for (int row = 0; row < 3; ++row)
+    {
+        for (int column = 0; column < 3; ++column)
+        {
+            object.normal_matrix.m[row][column] = object.facing *
+                                                  inverse.m[column][row];
+        }
+    }
+    return object;
+}
+
+static void assemble_range(const mesh_t& in_mesh,
+                           const transformed_mesh_t& transformed,
+                           const geometry_view_t& view,
+                           const object_view_t& object, bool clipping,
+                           uint32_t first, uint32_t last,
+                           std::vector<triangle_t>& out_triangles)
+{
+    for (uint32_t i = first; i < last; ++i)
+    {
+        const face_t& mesh_face = in_mesh.faces[i];
+        const int face_indices[3] = {
+            mesh_face.a - 1,
+            mesh_face.b - 1,
+            mesh_face.c - 1
+        };
+
+        // Back-face culling: the camera against the object space plane
+        if (view.culling)
+        {
+            float camera_side = in_mesh.face_normals[i].dot_product(
+                object.camera) - in_mesh.face_distances[i];
+            if (object.facing * camera_side <= 0) { continue; }
+        }
+
+        // Clip in homogeneous clip space, before the perspective divide
+        vec4_t clip_vertices[3];
+        for (int j = 0; j < 3; ++j)
+        {
+            clip_vertices[j] = transformed_clip(transformed, face_indices[j]);
+        }
+        const tex2_t face_texcoords[3] = {
+            mesh_face.a_uv,
+            mesh_face.b_uv,
+            mesh_face.c_uv
+        };
+        polygon_t polygon = polygon_from_triangle(clip_vertices, face_texcoords);
+        bool clipped = clipping && clip_polygon(polygon);
+
+        // Light shading (flat-shading), with the world space normal
+        vec3_t normal = object.normal_matrix.mul_vec4(
+            in_mesh.face_normals[i].to_vec4()).to_vec3();
+        normal.normalize();
+        float percentage = -normal.dot_product(view.light.direction);
+        uint32_t color = light_apply_intensity(mesh_face.color, percentage);
+
+        // Break the clipped polygon back into a triangle fan
+        for (int t = 1; t + 1 < polygon.num_vertices; ++t)
+        {
+            const int indices[3] = { 0, t, t + 1 };
+
+            triangle_t projected_triangle = {};
+            for (int j = 0; j < 3; ++j)
+            {
+                projected_triangle.texcoord[j] = polygon.texcoords[indices[j]];
+                if (!clipped)
+                {
+                    // Projected in the vertex stage already
+                    projected_triangle.points[j] = transformed_screen(
+                        transformed, face_indices[j]);
+                    continue;
+                }
+
+                vec4_t projected_point = polygon.vertices[indices[j]];
+
+                // Perspective divide, w stays the view space depth
+                projected_point.x /= projected_point.w;
+                projected_point.y /= projected_point.w;
+                projected_point.z /= projected_point.w;
+
+                // Invert the y values to account for y screen coordinates
+                projected_point.y *= -1.0f;
+
+                // Scale into the view
+                projected_point.x *= view.width / 2.0f;
+                projected_point.y *= view.height / 2.0f;
+
+                // Translate the points to the middle of the screen
+                projected_point.x += view.width / 2.0f;
+                projected_point.y += view.height / 2.0f;
+
+                projected_triangle.points[j] = projected_point;
+            }
+            projected_triangle.color = color;
+            out_triangles.push_back(projected_triangle);
+        }
+    }
+}
+
+void assemble_faces(const mesh_t& in_mesh, const transformed_mesh_t& transformed,
+                    const geometry_view_t& view, uint32_t first, uint32_t last,
+                    std::vector<triangle_t>& out_triangles)
+{
+    object_view_t object = make_object_view(view);
+    assemble_range(in_mesh, transformed, view, object, view.clipping, first,
+                   last, out_triangles);
+}
+
+// Meshlets [first, last): whole meshlets are culled before their faces.
+// Returns how many were culled.
+static uint32_t assemble_meshlets(const mesh_t& in_mesh,
+                                  const transformed_mesh_t& transformed,
+                                  const geometry_view_t& view, uint32_t first,
+                                  uint32_t last,
+                                  std::vector<triangle_t>& out_triangles)
+{
+    object_view_t object = make_object_view(view);
+    uint32_t culled = 0;
+    for (uint32_t i = first; i < last; ++i)
+    {
+        const meshlet_t& meshlet = in_mesh.meshlets[i];
+        if (view.culling && meshlet_backfacing(meshlet, object.camera,
+                                               object.facing))
+        {
+            ++culled;
+            continue;
+        }
+
+        bool clipping = view.clipping;
+        vec3_t center = view.world_matrix.mul_vec4(
+            meshlet.center.to_vec4()).to_vec3();
+        float radius = meshlet.radius * object.scale;
+        if (view.frustum_culling)
+        {
+            FRUSTUM_TEST test = frustum_test_sphere(view.frustum, center,
+                                                    radius);
+            if (test == FRUSTUM_TEST::OUTSIDE)
+            {
+                ++culled;
+                continue;
+            }
+            clipping = clipping && test != FRUSTUM_TEST::INSIDE;
+        }
+        if (view.occlusion && occlusion_test_sphere(*view.occlusion, center,
+                                                    radius))
+        {
+            ++culled;
+            continue;
+        }
+
+        assemble_range(in_mesh, transformed, view, object, clipping,
+                       meshlet.first_face,
+                       meshlet.first_face + meshlet.face_count, out_triangles);
+    }
+    return culled;
+}
+
+/*******************************************************************************
+ * Parallel geometry stage
+*******************************************************************************/
+void assemble_triangles(geometry_bins_t& bins, const mesh_t& in_mesh,
+                        const transformed_mesh_t& transformed,
+                        const geometry_view_t& view,
+                        std::vector<triangle_t>& out_triangles)
+{
+    // Batches of faces, or of meshlets holding about as many faces
+    bool use_meshlets = !in_mesh.meshlets.empty();
+    uint32_t batch_size = use_meshlets ? MESHLETS_PER_BATCH
+                                       : GEOMETRY_BATCH_SIZE;
+    uint32_t count = use_meshlets ? (uint32_t)in_mesh.meshlets.size()
+                                  : (uint32_t)in_mesh.faces.size();
+    uint32_t batches = (count + batch_size - 1) / batch_size;
+    if (bins.bins.size() < batches)
+    {
+        bins.bins.resize(batches);
+    }
+    bins.offsets.resize(batches + 1);
+    bins.culled.assign(batches, 0);
+
+    parallel_for(batches, [&](uint32_t batch) {
+        uint32_t first = batch * batch_size;
+        uint32_t last = std::min(first + batch_size, count);
+        std::vector<triangle_t>& bin = bins.bins[batch];
+        bin.clear();
+        if (use_meshlets)
+        {
+            bins.culled[batch] = assemble_meshlets(in_mesh, transformed, view,
+                                                   first, last, bin);
+        }
+        else
+        {
+            assemble_faces(in_mesh, transformed, view, first, last, bin);
+        }
+    });
+
+    bins.meshlets_culled = 0;
+    for (uint32_t culled : bins.culled)
+    {
+        bins.meshlets_culled += culled;
+    }
+
+    // Where each bin starts in the merged list
+    bins.offsets[0] = (uint32_t)out_triangles.size();
+    for (uint32_t batch = 0; batch < batches; ++batch)
+    {
+        bins.offsets[batch + 1] = bins.offsets[batch] +
+                                  (uint32_t)bins.bins[batch].size();
+    }
+
+    out_triangles.resize(bins.offsets[batches]);
+    parallel_for(batches, [&](uint32_t batch) {
+        const std::vector<triangle_t>& bin = bins.bins[batch];
+        std::copy(bin.begin(), bin.end(),
+                  out_triangles.begin() + bins.offsets[batch]);
+    });
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "frustum.h"
+#include "light.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "occlusion.h"
+#include "triangle.h"
+#include "vector.h"
+
+#include <cstdint>
+#include <vector>
+
+// Faces assembled per job in the geometry stage
+#define GEOMETRY_BATCH_SIZE 1024
+#define MESHLETS_PER_BATCH (GEOMETRY_BATCH_SIZE / MESHLET_MAX_FACES)
+
+/*******************************************************************************
+ * Structures
+*******************************************************************************/
+// What the faces are assembled for
+struct geometry_view_t
+{
+    vec3_t    camera_pos      = { 0.0f, 0.0f, 0.0f }; // World space
+    mat4_t    world_matrix    = mat4_identity();      // Of the mesh
+    light_t   light;
+    bool      culling         = true;
+    bool      clipping        = true; // False when inside the clip planes
+    // Meshlets out of 'frustum' are skipped when 'frustum_culling' is set
+    bool      frustum_culling = false;
+    frustum_t frustum         = {};
+    float     width           = 0.0f; // Viewport, in pixels
+    float     height          = 0.0f;
+    // Meshlets hidden behind its occluders are skipped, when not null
+    const occlusion_buffer_t* occlusion = nullptr;
+};
+
+// One triangle list per batch of faces, kept between frames to reuse their
+// allocations
+struct geometry_bins_t
+{
+    std::vector<std::vector<triangle_t>> bins;
+    std::vector<uint32_t>                offsets; // First triangle of each bin
+    std::vector<uint32_t>                culled;  // Meshlets culled per bin
+    uint32_t                             meshlets_culled = 0; // Last call
+};
+
+/*******************************************************************************
+ * Geometry Stage
+********************************************************************************
+** Turns the faces of a transformed mesh into screen space triangles: back-face
+** culling, flat shading, clipping, then the clipped polygons as triangle fans.
+** The mesh needs its face planes (mesh_compute_face_planes): the camera is
+** moved into object space once, then culling is a dot product per face and
+** only the normals of the faces kept are transformed and normalized.
+**
+** assemble_triangles() splits the faces into batches of GEOMETRY_BATCH_SIZE
+** handled on the thread pool. Each batch writes its own bin, the bins are then
+** copied out one after the other: the triangles come out in face order, the
+** same list assemble_faces() gives for all the faces.
+**
+** Without 'clipping', the faces are assumed inside the clip planes and go
+** straight to the screen positions of the vertex stage.
+**
+** A mesh with meshlets is handled meshlet by meshlet: a meshlet whose normal
+** cone faces away from the camera, out of the frustum or behind the occluders
+** is skipped before any of its faces is looked at. A meshlet inside the clip planes is not
+** clipped.
+*******************************************************************************/
+// Appends the triangles of faces [first, last) on the calling thread
+void assemble_faces(const mesh_t& in_mesh, const transformed_mesh_t& transformed,
+                    const geometry_view_t& view, uint32_t first, uint32_t last,
+                    std::vector<triangle_t>& out_triangles);
+
+// Appends the triangles of every face
+void assemble_triangles(geometry_bins_t& bins, const mesh_t& in_mesh,
+                        const transformed_mesh_t& transformed,
+                        const geometry_view_t& view,
+                        std::vector<triangle_t>& out_triangles);
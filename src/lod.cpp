@@ -0,0 +1,603 @@
+#include "lod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+// Open edges weigh this much more than the faces along them
+#define BOUNDARY_WEIGHT 10.0
+// Levels stop once they would have fewer faces
+#define LOD_MIN_FACES 64
+
+/*******************************************************************************
+ * Quadrics
+********************************************************************************
+** Q = sum of w * (n, d)(n, d)^T over planes n.p + d = 0, stored as its upper
+** triangle: xx xy xz xw yy yz yw zz zw ww. error(p) = (p, 1)^T Q (p, 1).
+*******************************************************************************/
+struct quadric_t
+{
+    double q[10] = {};
+};
+
+static void quadric_add_plane(quadric_t& quadric, double nx, double ny,
+                              double nz, double d, double weight)
+{
+    double* q = quadric.q;
+    q[0] += weight * nx * nx; q[1] += weight * nx * ny;
+    q[2] += weight * nx * nz; q[3] += weight * nx * d;
+    q[4] += weight * ny * ny; q[5] += weight * ny * nz;
+    q[6] += weight * ny * d;  q[7] += weight * nz * nz;
+    q[8] += weight * nz * d;  q[9] += weight * d * d;
+}
+
+static void quadric_add(quadric_t& quadric, const quadric_t& other)
+{
+    for (int i = 0; i < 10; ++i)
+    {
+        quadric.q[i] += other.q[i];
+    }
+}
+
+static double quadric_error(const quadric_t& quadric, const vec3_t& p)
+{
+    const double* q = quadric.q;
+    double x = p.x, y = p.y, z = p.z;
+    return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z +
+           2.0 * q[3] * x + q[4] * y * y + 2.0 * q[5] * y * z +
+           2.0 * q[6] * y + q[7] * z * z + 2.0 * q[8] * z + q[9];
+}
+
+// Point of least error, false when the quadric is too flat to decide
+static bool quadric_optimum(const quadric_t& quadric, vec3_t& out_point)
+{
+    const double* q = quadric.q;
+    double a = q[0], b = q[1], c = q[2];
+    double e = q[4], f = q[5], i = q[7];
+    double det = a * (e * i - f * f) - b * (b * i - f * c) +
+                 c * (b * f - e * c);
+    double scale = std::max({ fabs(a), fabs(e), fabs(i) });
+    if (fabs(det) <= 1e-12 * scale * scale * scale || scale == 0.0)
+    {
+        return false;
+    }
+
+    // Cramer's rule on A p = -(xw, yw, zw)
+    double rx = -q[3], ry = -q[6], rz = -q[8];
+    double x = (rx * (e * i - f * f) - b * (ry * i - f * rz) +
+                c * (ry * f - e * rz)) / det;
+    double y = (a * (ry * i - f * rz) - rx * (b * i - f * c) +
+                c * (b * rz - ry * c)) / det;
+    double z = (a * (e * rz - ry * f) - b * (b * rz - ry * c) +
+                rx * (b * f - e * c)) / det;
+    out_point = { (float)x, (float)y, (float)z };
+    return true;
+}
+
+/*******************************************************************************
+ * Edge collapse
+*******************************************************************************/
+struct collapse_t
+{
+    double   cost;
+    uint32_t v0;
+    uint32_t v1;
+    uint32_t version0;
+    uint32_t version1;
+    vec3_t   position;
+
+    bool operator > (const collapse_t& other) const
+    {
+        return cost > other.cost;
+    }
+};
+
+struct simplifier_t
+{
+    std::vector<vec3_t>                positions;
+    std::vector<quadric_t>             quadrics;
+    std::vector<uint32_t>              versions;
+    std::vector<uint8_t>               removed;
+    std::vector<std::vector<uint32_t>> vertex_faces;
+    std::vector<uint32_t>              corners; // 3 per face
+    std::vector<uint8_t>               alive;
+    uint32_t                           live_faces = 0;
+    std::priority_queue<collapse_t, std::vector<collapse_t>,
+                        std::greater<collapse_t>> heap;
+};
+
+// Same key for both directions of an edge
+static uint64_t edge_key(uint32_t a, uint32_t b)
+{
+    return (uint64_t)std::min(a, b) << 32 | std::max(a, b);
+}
+
+static vec3_t face_cross(const simplifier_t& simplifier, uint32_t face,
+                         uint32_t moved, const vec3_t& position)
+{
+    vec3_t p[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        uint32_t v = simplifier.corners[face * 3 + i];
+        p[i] = v == moved ? position : simplifier.positions[v];
+    }
+    return (p[1] - p[0]).cross_product(p[2] - p[0]);
+}
+
+static void push_collapse(simplifier_t& simplifier, uint32_t v0, uint32_t v1)
+{
+    quadric_t quadric = simplifier.quadrics[v0];
+    quadric_add(quadric, simplifier.quadrics[v1]);
+
+    collapse_t collapse = {};
+    collapse.v0 = v0;
+    collapse.v1 = v1;
+    collapse.version0 = simplifier.versions[v0];
+    collapse.version1 = simplifier.versions[v1];
+    if (quadric_optimum(quadric, collapse.position))
+    {
+        collapse.cost = quadric_error(quadric, collapse.position);
+    }
+    else
+    {
+        // One of the ends or the middle, whichever costs least
+        const vec3_t& a = simplifier.positions[v0];
+        const vec3_t& b = simplifier.positions[v1];
+        const vec3_t candidates[3] = { a, b, (a + b) * 0.5f };
+        collapse.cost = INFINITY;
+        for (const vec3_t& candidate : candidates)
+        {
+            double cost = quadric_error(quadric, candidate);
+            if (cost < collapse.cost)
+            {
+                collapse.cost = cost;
+                collapse.position = candidate;
+            }
+        }
+    }
+    simplifier.heap.push(collapse);
+}
+
+// No face around v0 or v1 may turn over when they move to 'position'
+static bool collapse_keeps_faces(const simplifier_t& simplifier, uint32_t v0,
+                                 uint32_t v1, const vec3_t& position)
+{
+    for (uint32_t v : { v0, v1 })
+    {
+        for (uint32_t face : simplifier.vertex_faces[v])
+        {
+            const uint32_t* corners = &simplifier.corners[face * 3];
+            bool has_v0 = corners[0] == v0 || corners[1] == v0 ||
+                          corners[2] == v0;
+            bool has_v1 = corners[0] == v1 || corners[1] == v1 ||
+                          corners[2] == v1;
+            if (!simplifier.alive[face] || (has_v0 && has_v1))
+            {
+                continue; // Removed by the collapse
+            }
+
+            vec3_t before = face_cross(simplifier, face, v,
+                                       simplifier.positions[v]);
+            vec3_t after = face_cross(simplifier, face, v, position);
+            if (before.dot_product(before) == 0.0f)
+            {
+                continue; // Already degenerate, like the faces at a pole
+            }
+            if (before.dot_product(after) <= 0.0f)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void apply_collapse(simplifier_t& simplifier, const collapse_t& collapse)
+{
+    uint32_t v0 = collapse.v0;
+    uint32_t v1 = collapse.v1;
+    simplifier.positions[v0] = collapse.position;
+    quadric_add(simplifier.quadrics[v0], simplifier.quadrics[v1]);
+    simplifier.removed[v1] = 1;
+    ++simplifier.versions[v0];
+    ++simplifier.versions[v1];
+
+    // Faces on the edge disappear, the other faces of v1 move to v0
+    for (uint32_t face : simplifier.vertex_faces[v1])
+    {
+        if (!simplifier.alive[face])
+        {
+            continue;
+        }
+        uint32_t* corners = &simplifier.corners[face * 3];
+        if (corners[0] == v0 || corners[1] == v0 || corners[2] == v0)
+        {
+            simplifier.alive[face] = 0;
+            --simplifier.live_faces;
+            continue;
+        }
+        for (int i = 0; i < 3; ++i)
+        {
+            if (corners[i] == v1)
+            {
+                corners[i] = v0;
+            }
+        }
+        simplifier.vertex_faces[v0].push_back(face);
+    }
+    simplifier.vertex_faces[v1].clear();
+
+    std::vector<uint32_t>& faces = simplifier.vertex_faces[v0];
+    faces.erase(std::remove_if(faces.begin(), faces.end(),
+                               [&](uint32_t face) {
+                                   return !simplifier.alive[face];
+                               }),
+                faces.end());
+
+    // New costs for every edge around v0
+    std::vector<uint32_t> neighbours;
+    for (uint32_t face : faces)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            uint32_t v = simplifier.corners[face * 3 + i];
+            if (v != v0)
+            {
+                neighbours.push_back(v);
+            }
+        }
+    }
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()),
+                     neighbours.end());
+    for (uint32_t v : neighbours)
+    {
+        push_collapse(simplifier, v0, v);
+    }
+}
+
+bool simplify_mesh(const mesh_t& in_mesh, uint32_t target_faces,
+                   mesh_t& out_mesh)
+{
+    uint32_t vertex_count = mesh_vertex_count(in_mesh);
+    uint32_t face_count = (uint32_t)in_mesh.faces.size();
+
+    simplifier_t simplifier;
+    simplifier.positions.resize(vertex_count);
+    for (uint32_t v = 0; v < vertex_count; ++v)
+    {
+        simplifier.positions[v] = mesh_position(in_mesh, v);
+    }
+    simplifier.quadrics.resize(vertex_count);
+    simplifier.versions.assign(vertex_count, 0);
+    simplifier.removed.assign(vertex_count, 0);
+    simplifier.vertex_faces.resize(vertex_count);
+    simplifier.corners.resize(face_count * 3);
+    simplifier.alive.assign(face_count, 1);
+    simplifier.live_faces = face_count;
+
+    // Face planes, weighted by area, and how many faces use each edge
+    std::unordered_map<uint64_t, uint32_t> edge_faces;
+    for (uint32_t face = 0; face < face_count; ++face)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            uint32_t v = (uint32_t)(in_mesh.faces[face].data[i] - 1);
+            simplifier.corners[face * 3 + i] = v;
+            simplifier.vertex_faces[v].push_back(face);
+        }
+
+        const uint32_t* corners = &simplifier.corners[face * 3];
+        vec3_t normal = face_cross(simplifier, face, UINT32_MAX, {});
+        double length = normal.length();
+        if (length > 0.0)
+        {
+            const vec3_t& p = simplifier.positions[corners[0]];
+            double nx = normal.x / length;
+            double ny = normal.y / length;
+            double nz = normal.z / length;
+            double d = -(nx * p.x + ny * p.y + nz * p.z);
+            for (int i = 0; i < 3; ++i)
+            {
+                quadric_add_plane(simplifier.quadrics[corners[i]], nx, ny, nz,
+                                  d, length * 0.5);
+            }
+        }
+
+        for (int i = 0; i < 3; ++i)
+        {
+            uint32_t a = corners[i];
+            uint32_t b = corners[(i + 1) % 3];
+            ++edge_faces[edge_key(a, b)];
+        }
+    }
+
+    // Open edges: a plane through the edge, across the face
+    for (uint32_t face = 0; face < face_count; ++face)
+    {
+        const uint32_t* corners = &simplifier.corners[face * 3];
+        vec3_t normal = face_cross(simplifier, face, UINT32_MAX, {});
+        for (int i = 0; i < 3; ++i)
+        {
+            uint32_t a = corners[i];
+            uint32_t b = corners[(i + 1) % 3];
+            if (edge_faces[edge_key(a, b)] != 1)
+            {
+                continue;
+            }
+
+            vec3_t edge = simplifier.positions[b] - simplifier.positions[a];
+            vec3_t across = edge.cross_product(normal);
+            double length = across.length();
+            if (length == 0.0)
+            {
+                continue;
+            }
+            const vec3_t& p = simplifier.positions[a];
+            double nx = across.x / length;
+            double ny = across.y / length;
+            double nz = across.z / length;
+            double d = -(nx * p.x + ny * p.y + nz * p.z);
+            double weight = BOUNDARY_WEIGHT * edge.dot_product(edge);
+            quadric_add_plane(simplifier.quadrics[a], nx, ny, nz, d, weight);
+            quadric_add_plane(simplifier.quadrics[b], nx, ny, nz, d, weight);
+        }
+    }
+
+    for (const auto& edge : edge_faces)
+    {
+        push_collapse(simplifier, (uint32_t)(edge.first >> 32),
+                      (uint32_t)(edge.first & 0xFFFFFFFF));
+    }
+
+    while (simplifier.live_faces > target_faces && !simplifier.heap.empty())
+    {
+        collapse_t collapse = simplifier.heap.top();
+        simplifier.heap.pop();
+        if (simplifier.removed[collapse.v0] ||
+            simplifier.removed[collapse.v1] ||
+            simplifier.versions[collapse.v0] != collapse.version0 ||
+            simplifier.versions[collapse.v1] != collapse.version1)
+        {
+            continue; // Outdated
+        }
+        if (!collapse_keeps_faces(simplifier, collapse.v0, collapse.v1,
+                                  collapse.position))
+        {
+            continue;
+        }
+        apply_collapse(simplifier, collapse);
+    }
+
+    // The faces left, in their order, over the vertices they use
+    out_mesh = {};
+    out_mesh.rotation = in_mesh.rotation;
+    out_mesh.scale = in_mesh.scale;
+    out_mesh.translation = in_mesh.translation;
+    std::vector<uint32_t> remap(vertex_count, UINT32_MAX);
+    for (uint32_t face = 0; face < face_count; ++face)
+    {
+        if (!simplifier.alive[face])
+        {
+            continue;
+        }
+        face_t out_face = in_mesh.faces[face];
+        for (int i = 0; i < 3; ++i)
+        {
+            uint32_t v = simplifier.corners[face * 3 + i];
+            if (remap[v] == UINT32_MAX)
+            {
+                remap[v] = (uint32_t)out_mesh.vertices.size();
+                out_mesh.vertices.push_back(simplifier.positions[v]);
+            }
+            out_face.data[i] = (int)remap[v] + 1;
+        }
+        out_mesh.faces.push_back(out_face);
+    }
+    return simplifier.live_faces <= target_faces;
+}
+
+/*******************************************************************************
+ * LOD chain
+*******************************************************************************/
+// Planes, bounds and meshlets, as a loaded mesh has them
+static void prepare_level(mesh_t& level)
+{
+    mesh_compute_face_planes(level);
+    mesh_compute_bounds(level);
+    mesh_build_meshlets(level);
+}
+
+void mesh_build_lods(mesh_t& out_mesh)
+{
+    out_mesh.lods.clear();
+    const mesh_t* previous = &out_mesh;
+    for (int level = 1; level <= LOD_LEVELS; ++level)
+    {
+        uint32_t target = (uint32_t)(out_mesh.faces.size() >> level);
+        if (target < LOD_MIN_FACES)
+        {
+            break;
+        }
+
+        mesh_t simplified;
+        simplify_mesh(*previous, target, simplified);
+        if (simplified.faces.size() >= previous->faces.size())
+        {
+            break; // Nothing left to collapse
+        }
+        prepare_level(simplified);
+        out_mesh.lods.push_back(std::move(simplified));
+        previous = &out_mesh.lods.back();
+    }
+}
+
+const mesh_t& mesh_select_lod(const mesh_t& in_mesh, float pixel_radius)
+{
+    float budget = 3.14159265f * pixel_radius * pixel_radius /
+                   LOD_PIXELS_PER_FACE;
+    if (in_mesh.lods.empty() || (float)in_mesh.faces.size() <= budget)
+    {
+        return in_mesh;
+    }
+    for (const mesh_t& level : in_mesh.lods)
+    {
+        if ((float)level.faces.size() <= budget)
+        {
+            return level;
+        }
+    }
+    return in_mesh.lods.back();
+}
+
+/*******************************************************************************
+ * LOD files
+********************************************************************************
+** "LOD2", vertex and face counts of the full mesh, number of levels, a hash
+** of its vertices and faces, then per level its vertex, face and meshlet
+** counts, vertices, faces and meshlets. The hash catches a model edited in
+** place without changing its counts. The meshlets are saved as built:
+** building them again would reorder faces.
+*******************************************************************************/
+static const char LOD_FILE_MAGIC[4] = { 'L', 'O', 'D', '2' };
+
+// FNV-1a over the positions and the faces of the full mesh
+static uint64_t lod_source_hash(const mesh_t& in_mesh)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    auto add = [&hash](const void* data, size_t size)
+    {
+        const uint8_t* bytes = (const uint8_t*)data;
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+        }
+    };
+    uint32_t vertex_count = mesh_vertex_count(in_mesh);
+    for (uint32_t i = 0; i < vertex_count; ++i)
+    {
+        vec3_t position = mesh_position(in_mesh, i);
+        add(&position, sizeof(position));
+    }
+    add(in_mesh.faces.data(), in_mesh.faces.size() * sizeof(face_t));
+    return hash;
+}
+
+bool mesh_save_lods(const mesh_t& in_mesh, const char* filepath)
+{
+#ifdef WIN32
+    FILE* file_ptr = nullptr;
+    fopen_s(&file_ptr, filepath, "wb");
+#else
+    FILE* file_ptr = fopen(filepath, "wb");
+#endif
+    if (!file_ptr)
+    {
+        return false;
+    }
+
+    uint32_t header[3] = { mesh_vertex_count(in_mesh),
+                           (uint32_t)in_mesh.faces.size(),
+                           (uint32_t)in_mesh.lods.size() };
+    uint64_t hash = lod_source_hash(in_mesh);
+    bool result = fwrite(LOD_FILE_MAGIC, sizeof(LOD_FILE_MAGIC), 1,
+                         file_ptr) == 1 &&
+                  fwrite(header, sizeof(header), 1, file_ptr) == 1 &&
+                  fwrite(&hash, sizeof(hash), 1, file_ptr) == 1;
+    for (const mesh_t& level : in_mesh.lods)
+    {
+        uint32_t counts[3] = { (uint32_t)level.vertices.size(),
+                               (uint32_t)level.faces.size(),
+                               (uint32_t)level.meshlets.size() };
+        result = result &&
+                 fwrite(counts, sizeof(counts), 1, file_ptr) == 1 &&
+                 fwrite(level.vertices.data(), sizeof(vec3_t), counts[0],
+                        file_ptr) == counts[0] &&
+                 fwrite(level.faces.data(), sizeof(face_t), counts[1],
+                        file_ptr) == counts[1] &&
+                 fwrite(level.meshlets.data(), sizeof(meshlet_t), counts[2],
+                        file_ptr) == counts[2];
+    }
+    fclose(file_ptr);
+    return result;
+}
+
+bool mesh_load_lods(mesh_t& out_mesh, const char* filepath)
+{
+#ifdef WIN32
+    FILE* file_ptr = nullptr;
+    fopen_s(&file_ptr, filepath, "rb");
+#else
+    FILE* file_ptr = fopen(filepath, "rb");
+#endif
+    if (!file_ptr)
+    {
+        return false;
+    }
+
+    char magic[4] = {};
+    uint32_t header[3] = {};
+    uint64_t hash = 0;
+    bool result = fread(magic, sizeof(magic), 1, file_ptr) == 1 &&
+                  memcmp(magic, LOD_FILE_MAGIC, sizeof(magic)) == 0 &&
+                  fread(header, sizeof(header), 1, file_ptr) == 1 &&
+                  fread(&hash, sizeof(hash), 1, file_ptr) == 1 &&
+                  header[0] == mesh_vertex_count(out_mesh) &&
+                  header[1] == out_mesh.faces.size() &&
+                  header[2] <= LOD_LEVELS &&
+                  hash == lod_source_hash(out_mesh);
+
+    std::vector<mesh_t> lods(result ? header[2] : 0);
+    for (mesh_t& level : lods)
+    {
+        uint32_t counts[3] = {};
+        result = result && fread(counts, sizeof(counts), 1, file_ptr) == 1 &&
+                 counts[0] <= header[0] && counts[1] <= header[1] &&
+                 counts[2] <= counts[1];
+        if (!result)
+        {
+            break;
+        }
+        level.vertices.resize(counts[0]);
+        level.faces.resize(counts[1]);
+        level.meshlets.resize(counts[2]);
+        result = fread(level.vertices.data(), sizeof(vec3_t), counts[0],
+                       file_ptr) == counts[0] &&
+                 fread(level.faces.data(), sizeof(face_t), counts[1],
+                       file_ptr) == counts[1] &&
+                 fread(level.meshlets.data(), sizeof(meshlet_t), counts[2],
+                       file_ptr) == counts[2];
+        for (const face_t& face : level.faces)
+        {
+            for (int index : face.data)
+            {
+                result = result && index >= 1 && (uint32_t)index <= counts[0];
+            }
+        }
+        for (const meshlet_t& meshlet : level.meshlets)
+        {
+            result = result && meshlet.first_face <= counts[1] &&
+                     meshlet.face_count <= counts[1] - meshlet.first_face;
+        }
+    }
+    fclose(file_ptr);
+    if (!result)
+    {
+        return false;
+    }
+
+    for (mesh_t& level : lods)
+    {
+        level.rotation = out_mesh.rotation;
+        level.scale = out_mesh.scale;
+        level.translation = out_mesh.translation;
+        mesh_compute_face_planes(level);
+        mesh_compute_bounds(level);
+    }
+    out_mesh.lods = std::move(lods);
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <cstdint>
+
+// Simplified levels built after the full mesh, each with about half the faces
+// of the previous one: 50%, 25% and 12.5%
+#define LOD_LEVELS 3
+// Faces are worth drawing while they cover about this many pixels
+#define LOD_PIXELS_PER_FACE 16.0f
+
+/*******************************************************************************
+ * Mesh Simplification
+********************************************************************************
+** Edge collapses ordered by quadric error (Garland & Heckbert): each vertex
+** sums the squared distances to the planes of its faces, an edge collapses to
+** the point minimizing the error of both ends. Open edges add a plane across
+** the edge so borders keep their shape, and collapses that would flip a face
+** are refused. Faces keep their texture coordinates, color and order.
+*******************************************************************************/
+// False when 'target_faces' could not be reached, 'out_mesh' then holds the
+// simplest mesh found
+bool simplify_mesh(const mesh_t& in_mesh, uint32_t target_faces,
+                   mesh_t& out_mesh);
+
+/*******************************************************************************
+ * LOD Chain
+********************************************************************************
+** mesh_t::lods holds the simplified levels, coarser and coarser. Each level
+** has its planes, bounds and meshlets. The chain can be saved next to the
+** model so it is built only once.
+*******************************************************************************/
+void mesh_build_lods(mesh_t& out_mesh);
+// The level to draw for a mesh covering a circle of 'pixel_radius' pixels:
+// the finest one with no more faces than the pixels can show
+const mesh_t& mesh_select_lod(const mesh_t& in_mesh, float pixel_radius);
+
+// Binary file of the levels. Loading fails when the file was built for a mesh
+// with other vertices or faces, found by their counts and a hash.
+bool mesh_save_lods(const mesh_t& in_mesh, const char* filepath);
+bool mesh_load_lods(mesh_t& out_mesh, const char* filepath);
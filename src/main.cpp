@@ -6,11 +6,15 @@
 #include <SDL3/SDL_timer.h>
 
 #include "display.h"
+#include "frame_ring.h"
 #include "vector.h"
 #include "light.h"
 #include "matrix.h"
 #include "mesh.h"
+#include "optimize.h"
+#include "scene.h"
 #include "texture.h"
+#include "tiler.h"
 #include "triangle.h"
 
 #include <vector>
@@ -37,7 +41,11 @@ const float SCALE = 640.0f;
 static vec3_t camera_pos = { 0.0f, 0.0f, -5.0f };
 static light_t light = { 0.0f, 0.0f, 1.0f };
 static mat4_t projection_matrix = mat4_identity();
-static std::vector<triangle_t> triangles;
+// One triangle list per frame in flight, filled while the others are drawn
+static std::vector<triangle_t> frame_triangles[MAX_FRAMES_IN_FLIGHT];
+static tile_grid_t tile_grid;
+static scene_t scene;
+static frame_ring_t frame_ring;
 
 /*******************************************************************************
  * Process Input & Events
@@ -97,12 +105,39 @@ void process_input(SDL_API& sdl, ColorBuffer& color_buffer)
                 {
                     sdl.render_mode = RENDER_MODE::TEXTURED_TRIANGLES_AND_WIREFRAME;
                 }
+                else if (event.key.keysym.sym == SDLK_z)
+                {
+                    sdl.depth_test = !sdl.depth_test;
+                }
+                else if (event.key.keysym.sym == SDLK_w)
+                {
+                    sdl.wrap_mode = sdl.wrap_mode == WRAP_MODE::REPEAT
+                                  ? WRAP_MODE::CLAMP : WRAP_MODE::REPEAT;
+                }
+                else if (event.key.keysym.sym == SDLK_t)
+                {
+                    frame_ring_flush(frame_ring);
+                    set_frame_layout(color_buffer,
+                                     color_buffer.layout == FRAME_LAYOUT::LINEAR
+                                     ? FRAME_LAYOUT::TILED
+                                     : FRAME_LAYOUT::LINEAR);
+                }
+                else if (event.key.keysym.sym == SDLK_p)
+                {
+                    frame_ring_flush(frame_ring);
+                    set_present_mode(color_buffer,
+                                     color_buffer.present_mode ==
+                                         PRESENT_MODE::LOCK_TEXTURE
+                                     ? PRESENT_MODE::UPDATE_TEXTURE
+                                     : PRESENT_MODE::LOCK_TEXTURE);
+                }
             } break;
 
             case SDL_EVENT_WINDOW_RESIZED:
             {
                 int width = event.window.data1;
                 int height = event.window.data2;
+                frame_ring_flush(frame_ring);
                 resize_color_buffer(sdl, color_buffer, width, height);
 
                 // Remake perspective matrix
@@ -144,108 +179,38 @@ void process_input(SDL_API& sdl, ColorBuffer& color_buffer)
 /*******************************************************************************
  * Update Logic
 *******************************************************************************/
-void update(const SDL_API& sdl, uint32_t window_width, uint32_t window_height)
+void update(const SDL_API& sdl, uint32_t window_width, uint32_t window_height,
+            std::vector<triangle_t>& triangles)
 {
-    mesh.rotation.x += 0.02f;
-    //mesh.rotation.y += 0.03f;
-    //mesh.rotation.z += 0.03f;
+    scene_object_t& object = scene.objects[0];
+    object.rotation.x += 0.02f;
+    //object.rotation.y += 0.03f;
+    //object.rotation.z += 0.03f;
 
-    //mesh.scale.x += 0.002f;
-    //mesh.scale.y += 0.001f;
-    //mesh.translation.x += 0.01f;
+    //object.scale.x += 0.002f;
+    //object.scale.y += 0.001f;
+    //object.translation.x += 0.01f;
 
     // Translate the points aways from the camera
-    mesh.translation.z = -camera_pos.z;
-
-    mat4_t scale_matrix = mat4_make_scale(mesh.scale.x, mesh.scale.y, mesh.scale.z);
-    mat4_t rotation_x_matrix = mat4_make_rotation_x(mesh.rotation.x);
-    mat4_t rotation_y_matrix = mat4_make_rotation_y(mesh.rotation.y);
-    mat4_t rotation_z_matrix = mat4_make_rotation_z(mesh.rotation.z);
-    mat4_t translation_matrix = mat4_make_translation(mesh.translation.x, mesh.translation.y, mesh.translation.z);
-    mat4_t world_matrix = mat4_identity();
-    world_matrix = scale_matrix.mul_mat4(world_matrix);
-    world_matrix = rotation_x_matrix.mul_mat4(world_matrix);
-    world_matrix = rotation_y_matrix.mul_mat4(world_matrix);
-    world_matrix = rotation_z_matrix.mul_mat4(world_matrix);
-    world_matrix = translation_matrix.mul_mat4(world_matrix);
-    for (size_t i = 0; i < mesh.faces.size(); ++i)
-    {
-        face_t mesh_face = mesh.faces[i];
-        const vec3_t face_vertices[3] = {
-            mesh.vertices[mesh_face.a - 1],
-            mesh.vertices[mesh_face.b - 1],
-            mesh.vertices[mesh_face.c - 1]
-        };
-
-        vec4_t transformed_vertices[3];
-        for (int j = 0; j < 3; ++j)
-        {
-            vec4_t transformed_vertex = face_vertices[j].to_vec4();
-
-            transformed_vertex = world_matrix.mul_vec4(transformed_vertex);
-            transformed_vertices[j] = transformed_vertex;
-        }
-
-        vec3_t vertex_a = transformed_vertices[0].to_vec3(); /*   A   */
-        vec3_t vertex_b = transformed_vertices[1].to_vec3(); /*  / \  */
-        vec3_t vertex_c = transformed_vertices[2].to_vec3(); /* C---B */
-
-        vec3_t vector_ab = vertex_b - vertex_a;
-        vec3_t vector_ac = vertex_c - vertex_a;
-        vector_ab.normalize();
-        vector_ac.normalize();
-        vec3_t normal = vector_ab.cross_product(vector_ac);
-        normal.normalize();
-
-        // Back-face culling
-        if (sdl.culling)
-        {
-            vec3_t camera_ray = camera_pos - vertex_a;
-
-            float dot_normal_camera = normal.dot_product(camera_ray);
-            if (dot_normal_camera <= 0) { continue; }
-        }
-
-        triangle_t projected_triangle = {};
-        for (int j = 0; j < 3; ++j)
-        {
-            vec4_t projected_point = mat4_mul_vec4_project(projection_matrix, transformed_vertices[j]);
-
-            // Invert the y values to account for y screen coordinates
-            projected_point.y *= -1.0f;
-
-            // Scale into the view
-            projected_point.x *= window_width / 2.0f;
-            projected_point.y *= window_height / 2.0f;
-
-
-            // Translate the points to the middle of the screen
-            projected_point.x += window_width / 2.0f;
-            projected_point.y += window_height / 2.0f;
-
-            projected_triangle.points[j].x = projected_point.x;
-            projected_triangle.points[j].y = projected_point.y;
-            projected_triangle.points[j].z = projected_point.z;
-            projected_triangle.points[j].w = projected_point.w;
-        }
-        // Light shading (flat-shading)
-        float percentage = -normal.dot_product(light.direction);
-
-        projected_triangle.color = light_apply_intensity(mesh_face.color, percentage);
-        projected_triangle.texcoord[0] = mesh_face.a_uv;
-        projected_triangle.texcoord[1] = mesh_face.b_uv;
-        projected_triangle.texcoord[2] = mesh_face.c_uv;
-        triangles.push_back(projected_triangle);
-    }
+    object.translation.z = -camera_pos.z;
+
+    // Objects out of view are skipped, the others are transformed once per
+    // vertex then assembled in parallel batches of faces
+    geometry_view_t view;
+    view.camera_pos = camera_pos;
+    view.light = light;
+    view.culling = sdl.culling;
+    view.width = (float)window_width;
+    view.height = (float)window_height;
+    scene_assemble(scene, view, projection_matrix, triangles);
 }
 
 /*******************************************************************************
  * Render Color Buffer
 *******************************************************************************/
-void render(const SDL_API& sdl, ColorBuffer& color_buffer)
+void render(const SDL_API& sdl, ColorBuffer& color_buffer,
+            const std::vector<triangle_t>& triangles)
 {
-    draw_grid(color_buffer, 20, 0xFFE4E6EB);
-
     /*uint32_t colors[] = {
         0xFFFF0000, //red
         0xFFFF8000, //orange
@@ -261,95 +226,28 @@ void render(const SDL_API& sdl, ColorBuffer& color_buffer)
         0xFFFF0080  //magenta
     };*/
 
-    for (uint32_t i = 0; i < triangles.size(); ++i)
-    {
-        triangle_t triangle = triangles[i];
-        if (sdl.render_mode == RENDER_MODE::FILLED_TRIANGLES ||
-            sdl.render_mode == RENDER_MODE::FILLED_TRIANGLES_AND_WIREFRAME)
-        {
-            draw_filled_triangle(
-                color_buffer,
-                triangle.points[0].x,
-                triangle.points[0].y,
-                triangle.points[0].z,
-                triangle.points[0].w,
-                triangle.points[1].x,
-                triangle.points[1].y,
-                triangle.points[1].z,
-                triangle.points[1].w,
-                triangle.points[2].x,
-                triangle.points[2].y,
-                triangle.points[2].z,
-                triangle.points[2].w,
-                triangle.color
-            );
-        }
-        else if (sdl.render_mode == RENDER_MODE::TEXTURED_TRIANGLES ||
-                 sdl.render_mode == RENDER_MODE::TEXTURED_TRIANGLES_AND_WIREFRAME)
-        {
-            draw_textured_triangle(
-                color_buffer,
-                triangle.points[0].x,
-                triangle.points[0].y,
-                triangle.points[0].z,
-                triangle.points[0].w,
-                triangle.points[1].x,
-                triangle.points[1].y,
-                triangle.points[1].z,
-                triangle.points[1].w,
-                triangle.points[2].x,
-                triangle.points[2].y,
-                triangle.points[2].z,
-                triangle.points[2].w,
-                triangle.texcoord[0].u,
-                triangle.texcoord[0].v,
-                triangle.texcoord[1].u,
-                triangle.texcoord[1].v,
-                triangle.texcoord[2].u,
-                triangle.texcoord[2].v,
-                mesh_texture
-            );
-        }
-
-        // WIREFRAME mode
-        if (sdl.render_mode == RENDER_MODE::WIREFRAME_DOTS ||
-            sdl.render_mode == RENDER_MODE::WIREFRAME_LINES ||
-            sdl.render_mode == RENDER_MODE::FILLED_TRIANGLES_AND_WIREFRAME ||
-            sdl.render_mode == RENDER_MODE::TEXTURED_TRIANGLES_AND_WIREFRAME)
-        {
-            // Draw wireframe
-            draw_line(color_buffer, triangle.points[0].x, triangle.points[0].y,
-                      triangle.points[1].x, triangle.points[1].y, 0xFFFFFFFF);
-            draw_line(color_buffer, triangle.points[1].x, triangle.points[1].y,
-                      triangle.points[2].x, triangle.points[2].y, 0xFFFFFFFF);
-            draw_line(color_buffer, triangle.points[2].x, triangle.points[2].y,
-                      triangle.points[0].x, triangle.points[0].y, 0xFFFFFFFF);
-        }
-        if (sdl.render_mode == RENDER_MODE::WIREFRAME_DOTS)
-        {
-            // Draw vertex dots
-            draw_rect(color_buffer, triangle.points[0].x, triangle.points[0].y,
-                      3, 3, 0xFFFF0000);
-            draw_rect(color_buffer, triangle.points[1].x, triangle.points[1].y,
-                      3, 3, 0xFFFF0000);
-            draw_rect(color_buffer, triangle.points[2].x, triangle.points[2].y,
-                      3, 3, 0xFFFF0000);
-        }
-    }
-    triangles.clear();
+    // Pixel pipeline specialized for this frame's state, picked once
+    pipeline_state_t state = {};
+    state.render_mode = sdl.render_mode;
+    state.depth_test = sdl.depth_test;
+    state.wrap_mode = sdl.wrap_mode;
+
+    // Drawn on the frame thread while the previous frame is presented and the
+    // next one's geometry is processed. With LOCK_TEXTURE, into the slot's
+    // locked texture.
+    frame_ring_render(frame_ring, color_buffer,
+                      [state, &triangles](ColorBuffer& target) {
+        // Deferred: each tile is cleared, and gets its grid, on first use
+        tile_grid_clear(tile_grid, target, 0xFF18191A);
+
+        // Bin the triangles into screen tiles, rasterized by the thread pool
+        render_triangles_tiled(tile_grid, target, triangles, state,
+                               mesh_texture);
+        tile_grid_resolve(tile_grid, target);
+    });
 
     // AA RR GG BB
-    SDL_UpdateTexture(
-        color_buffer.texture,
-        NULL,
-        color_buffer.memory,
-        sizeof(uint32_t) * color_buffer.width
-    );
-    SDL_RenderTexture(sdl.renderer, color_buffer.texture, NULL, NULL);
-    clear_color_buffer(color_buffer, 0xFF18191A);
-    clear_z_buffer(color_buffer);
-
-    SDL_RenderPresent(sdl.renderer);
+    frame_ring_present(frame_ring, sdl);
 }
 
 /*******************************************************************************
@@ -358,11 +256,11 @@ void render(const SDL_API& sdl, ColorBuffer& color_buffer)
 void setup()
 {
 #ifdef WIN32
-    create_mesh_from_obj("../../../assets/cube.obj", mesh);
+    create_mesh_from_obj("../../../assets/cube.obj", mesh, true);
     // Load the texture information from an external PNG file
     load_png_texture_data("../../../assets/cube.png");
 #else
-    create_mesh_from_obj("../../assets/cube.obj", mesh);
+    create_mesh_from_obj("../../assets/cube.obj", mesh, true);
 #endif
     //load_cube_mesh_data();
 
@@ -370,6 +268,25 @@ void setup()
     {
         triangle.color = 0xFFFFFFFF;
     }
+
+    // Faces ordered for vertex reuse and early depth rejection
+    mesh_optimize_faces(mesh);
+
+    // Positions as x, y, z streams, read directly by the batch transforms
+    mesh_store_soa(mesh);
+
+    // A single object for now, placed in update()
+    scene_object_t object;
+    object.rotation = mesh.rotation;
+    object.scale = mesh.scale;
+    object.translation = mesh.translation;
+    scene.meshes.push_back(std::move(mesh));
+    scene.objects.push_back(object);
+
+    // Background of every tile, drawn when the tile is cleared
+    tile_grid.background = [](ColorBuffer& color_buffer, const rect_t& bounds) {
+        draw_grid(color_buffer, 20, 0xFFE4E6EB, bounds);
+    };
 }
 
 /*******************************************************************************
@@ -386,16 +303,22 @@ int main(int argc, char* argv[])
         return 1;
     }
 
+    // Drawn straight into the locked textures, every tile clears itself
     ColorBuffer color_buffer = {};
+    color_buffer.present_mode = DEFAULT_PRESENT_MODE;
     create_color_buffer(sdl, color_buffer);
-    clear_color_buffer(color_buffer, 0xFF18191A);
     clear_z_buffer(color_buffer);
 
+    frame_ring_init(frame_ring, FRAMES_IN_FLIGHT + 1, sdl.renderer);
+
     float fov = (float)M_PI / 3.0f; // 60 deg
     float aspect = (float)color_buffer.height / color_buffer.width;
     float znear = 0.1f;
     float zfar = 100.0f;
     projection_matrix = mat4_make_perspective(fov, aspect, znear, zfar);
+    // Depth from the near to the far plane, whatever the depth format
+    color_buffer.depth_near = znear;
+    color_buffer.depth_far = zfar;
 
     setup();
 
@@ -404,8 +327,12 @@ int main(int argc, char* argv[])
     {
         uint32_t start_frame_ticks = (uint32_t)SDL_GetTicks();
         process_input(sdl, color_buffer);
-        update(sdl, color_buffer.width, color_buffer.height);
-        render(sdl, color_buffer);
+
+        // Geometry of this frame runs while the previous one is drawn
+        std::vector<triangle_t>& triangles =
+            frame_triangles[frame_ring_next_slot(frame_ring)];
+        update(sdl, color_buffer.width, color_buffer.height, triangles);
+        render(sdl, color_buffer, triangles);
         uint32_t elapsed_frame_ticks = (uint32_t)SDL_GetTicks() - start_frame_ticks;
         if ((float)elapsed_frame_ticks <= FRAME_TARGET_TIME)
         {
@@ -415,6 +342,7 @@ int main(int argc, char* argv[])
     }
 
     // Free resources
+    frame_ring_destroy(frame_ring);
     destroy_color_buffer(color_buffer);
     destroy_window(sdl);
     SDL_Quit();
@@ -1,7 +1,33 @@
 #include "matrix.h"
 
+#include <algorithm>
 #include <cmath>
 
+// 8 points per iteration: one AVX register per component when the build
+// enables AVX, else two SSE registers (SSE is part of x86-64)
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MATRIX_LANES 8
+typedef __m256 lanes_t;
+#define LANES_SET   _mm256_set1_ps
+#define LANES_LOAD  _mm256_loadu_ps
+#define LANES_STORE _mm256_storeu_ps
+#define LANES_ADD   _mm256_add_ps
+#define LANES_MUL   _mm256_mul_ps
+#define LANES_DIV   _mm256_div_ps
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define MATRIX_LANES 4
+typedef __m128 lanes_t;
+#define LANES_SET   _mm_set1_ps
+#define LANES_LOAD  _mm_loadu_ps
+#define LANES_STORE _mm_storeu_ps
+#define LANES_ADD   _mm_add_ps
+#define LANES_MUL   _mm_mul_ps
+#define LANES_DIV   _mm_div_ps
+#endif
+#define POINTS_PER_ITERATION 8
+
 mat4_t mat4_identity()
 {
     return {{
@@ -93,6 +119,54 @@ vec4_t mat4_mul_vec4_project(const mat4_t& mat, const vec4_t& vec)
     return result;
 }
 
+float mat4_determinant_3x3(const mat4_t& mat)
+{
+    const float (*m)[4] = mat.m;
+    return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+           m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+           m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+}
+
+mat4_t mat4_inverse_affine(const mat4_t& mat)
+{
+    const float (*m)[4] = mat.m;
+    float inverse_det = 1.0f / mat4_determinant_3x3(mat);
+
+    // Upper 3x3: transposed cofactors over the determinant
+    mat4_t result = mat4_identity();
+    result.m[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * inverse_det;
+    result.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * inverse_det;
+    result.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inverse_det;
+    result.m[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) * inverse_det;
+    result.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inverse_det;
+    result.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * inverse_det;
+    result.m[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * inverse_det;
+    result.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * inverse_det;
+    result.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inverse_det;
+
+    // Translation: -inverse(3x3) * t
+    for (int row = 0; row < 3; ++row)
+    {
+        result.m[row][3] = -(result.m[row][0] * m[0][3] +
+                             result.m[row][1] * m[1][3] +
+                             result.m[row][2] * m[2][3]);
+    }
+    return result;
+}
+
+float mat4_max_axis_scale(const mat4_t& mat)
+{
+    float scale_squared = 0.0f;
+    for (int column = 0; column < 3; ++column)
+    {
+        scale_squared = std::max(scale_squared,
+                                 mat.m[0][column] * mat.m[0][column] +
+                                 mat.m[1][column] * mat.m[1][column] +
+                                 mat.m[2][column] * mat.m[2][column]);
+    }
+    return sqrtf(scale_squared);
+}
+
 vec4_t mat4_t::mul_vec4(const vec4_t& v) const
 {
     return {
@@ -127,4 +201,119 @@ mat4_t mat4_t::mul_mat4(const mat4_t& n) const
           m[3][0] * n.m[0][2] + m[3][1] * n.m[1][2] + m[3][2] * n.m[2][2] + m[3][3] * n.m[3][2],
           m[3][0] * n.m[0][3] + m[3][1] * n.m[1][3] + m[3][2] * n.m[2][3] + m[3][3] * n.m[3][3] },
     }};
-}
\ No newline at end of file
+}
+
+/*******************************************************************************
+ * Batch transforms
+********************************************************************************
+** Each row is summed in the order of mul_vec4(), m[row][3] * 1 being exact,
+** so the SIMD loop, the scalar tail and mul_vec4() agree to the bit. The
+** screen mapping repeats the per-vertex steps of update() the same way.
+*******************************************************************************/
+static inline float transform_row(const mat4_t& mat, int row, float x, float y,
+                                  float z)
+{
+    return mat.m[row][0] * x + mat.m[row][1] * y + mat.m[row][2] * z +
+           mat.m[row][3];
+}
+
+#ifdef MATRIX_LANES
+static inline lanes_t transform_row(const mat4_t& mat, int row, lanes_t x,
+                                    lanes_t y, lanes_t z)
+{
+    lanes_t sum = LANES_MUL(LANES_SET(mat.m[row][0]), x);
+    sum = LANES_ADD(sum, LANES_MUL(LANES_SET(mat.m[row][1]), y));
+    sum = LANES_ADD(sum, LANES_MUL(LANES_SET(mat.m[row][2]), z));
+    return LANES_ADD(sum, LANES_SET(mat.m[row][3]));
+}
+#endif
+
+void mat4_transform_points(const mat4_t& mat, const float* const in[3],
+                           uint32_t count, float* const out[4])
+{
+    int rows = out[3] ? 4 : 3;
+    uint32_t i = 0;
+#ifdef MATRIX_LANES
+    for (; i + POINTS_PER_ITERATION <= count; i += POINTS_PER_ITERATION)
+    {
+        for (uint32_t lane = i; lane < i + POINTS_PER_ITERATION;
+             lane += MATRIX_LANES)
+        {
+            lanes_t x = LANES_LOAD(in[0] + lane);
+            lanes_t y = LANES_LOAD(in[1] + lane);
+            lanes_t z = LANES_LOAD(in[2] + lane);
+            for (int row = 0; row < rows; ++row)
+            {
+                LANES_STORE(out[row] + lane, transform_row(mat, row, x, y, z));
+            }
+        }
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        for (int row = 0; row < rows; ++row)
+        {
+            out[row][i] = transform_row(mat, row, in[0][i], in[1][i],
+                                        in[2][i]);
+        }
+    }
+}
+
+void mat4_project_points(const mat4_t& mat, const float* const in[3],
+                         uint32_t count, float width, float height,
+                         float* const clip[4], float* const screen[3])
+{
+    float half_width = width / 2.0f;
+    float half_height = height / 2.0f;
+    uint32_t i = 0;
+#ifdef MATRIX_LANES
+    const lanes_t lanes_half_width = LANES_SET(half_width);
+    const lanes_t lanes_half_height = LANES_SET(half_height);
+    const lanes_t flip = LANES_SET(-1.0f);
+    for (; i + POINTS_PER_ITERATION <= count; i += POINTS_PER_ITERATION)
+    {
+        for (uint32_t lane = i; lane < i + POINTS_PER_ITERATION;
+             lane += MATRIX_LANES)
+        {
+            lanes_t x = LANES_LOAD(in[0] + lane);
+            lanes_t y = LANES_LOAD(in[1] + lane);
+            lanes_t z = LANES_LOAD(in[2] + lane);
+            lanes_t clip_x = transform_row(mat, 0, x, y, z);
+            lanes_t clip_y = transform_row(mat, 1, x, y, z);
+            lanes_t clip_z = transform_row(mat, 2, x, y, z);
+            lanes_t clip_w = transform_row(mat, 3, x, y, z);
+            LANES_STORE(clip[0] + lane, clip_x);
+            LANES_STORE(clip[1] + lane, clip_y);
+            LANES_STORE(clip[2] + lane, clip_z);
+            LANES_STORE(clip[3] + lane, clip_w);
+
+            lanes_t screen_x = LANES_DIV(clip_x, clip_w);
+            lanes_t screen_y = LANES_MUL(LANES_DIV(clip_y, clip_w), flip);
+            LANES_STORE(screen[0] + lane,
+                        LANES_ADD(LANES_MUL(screen_x, lanes_half_width),
+                                  lanes_half_width));
+            LANES_STORE(screen[1] + lane,
+                        LANES_ADD(LANES_MUL(screen_y, lanes_half_height),
+                                  lanes_half_height));
+            LANES_STORE(screen[2] + lane, LANES_DIV(clip_z, clip_w));
+        }
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        float x = in[0][i];
+        float y = in[1][i];
+        float z = in[2][i];
+        float clip_x = transform_row(mat, 0, x, y, z);
+        float clip_y = transform_row(mat, 1, x, y, z);
+        float clip_z = transform_row(mat, 2, x, y, z);
+        float clip_w = transform_row(mat, 3, x, y, z);
+        clip[0][i] = clip_x;
+        clip[1][i] = clip_y;
+        clip[2][i] = clip_z;
+        clip[3][i] = clip_w;
+        screen[0][i] = clip_x / clip_w * half_width + half_width;
+        screen[1][i] = clip_y / clip_w * -1.0f * half_height + half_height;
+        screen[2][i] = clip_z / clip_w;
+    }
+}
@@ -2,6 +2,8 @@
 
 #include "vector.h"
 
+#include <cstdint>
+
 struct mat4_t
 {
     float m[4][4];
@@ -17,4 +19,23 @@ mat4_t mat4_make_rotation_x(float rx);
 mat4_t mat4_make_rotation_y(float ry);
 mat4_t mat4_make_rotation_z(float rz);
 mat4_t mat4_make_perspective(float fov, float aspect, float znear, float zfar);
-vec4_t mat4_mul_vec4_project(const mat4_t& mat, const vec4_t& vec);
\ No newline at end of file
+vec4_t mat4_mul_vec4_project(const mat4_t& mat, const vec4_t& vec);
+// Determinant of the upper 3x3: negative when 'mat' mirrors
+float  mat4_determinant_3x3(const mat4_t& mat);
+// Inverse of an affine transform (last row 0, 0, 0, 1)
+mat4_t mat4_inverse_affine(const mat4_t& mat);
+// Largest length of the x, y and z axes: how much 'mat' grows a sphere
+float  mat4_max_axis_scale(const mat4_t& mat);
+
+// Batch transforms over separate component streams (SoA): 'in' points to the
+// x, y and z arrays of 'count' points with w = 1. Results match mul_vec4()
+// bit for bit.
+// 'out' receives x, y, z and w, out[3] may be null when w is not needed.
+void mat4_transform_points(const mat4_t& mat, const float* const in[3],
+                           uint32_t count, float* const out[4]);
+// Transform into clip space, then the perspective divide and viewport
+// mapping fused in: 'screen' receives x in [0, width], y in [0, height]
+// pointing down, and z / w. The clip w stays in clip[3].
+void mat4_project_points(const mat4_t& mat, const float* const in[3],
+                         uint32_t count, float width, float height,
+                         float* const clip[4], float* const screen[3]);
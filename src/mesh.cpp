@@ -1,6 +1,11 @@
 #include "mesh.h"
+#include "lod.h"
+#include "obj_parser.h"
 #include <stdio.h>
+#include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <string>
 
 mesh_t mesh;
 
@@ -45,172 +50,355 @@ void load_cube_mesh_data(void) {
         face_t cube_face = cube_faces[i];
         mesh.faces.push_back(cube_face);
     }
+    mesh_compute_face_planes(mesh);
+    mesh_compute_bounds(mesh);
+    mesh_build_meshlets(mesh);
 }
 
-static void parse_face(char* line, mesh_t& out_mesh, const std::vector<tex2_t>& texcoords)
+// https://en.wikipedia.org/wiki/Wavefront_.obj_file#References
+bool create_mesh_from_obj(const char* filepath, mesh_t& out_mesh,
+                          bool build_lods)
 {
-    
-    // Possible Read
-    // - Vertex indices only
-    //      f v1 v2 v3 ...
-    // - Vertex indices and texture coords indices
-    //      f v1/vt1 v2/vt2 v3/vt3 ...
-    // - Vertex indices and normal indices
-    //      f v1//vn1 v2//vn2 v3//vn3 ...
-    // - Vertex indices, texture coords indices and normal indices
-    //      f v1/vt1/vn1 v2/vt2/vn2 v3/vt3/vn3 ...
-    // Only supports 1 case for now
-    // Only supports triangles (3 indices per line)
-    // TODO: Add support for other cases
-    // TODO: Add support for more than 3 vertices
-    // TODO: Add support for index -1, referring to the last vertex
-    char* ptr_start = line + 2;
-    int i = 0;
-    int nbSlashes = 0;
-    while (ptr_start[0] != ' ' && i < 50)
-    {
-        if (ptr_start[0] == '/')
+    // TODO: Check if .obj file else error
+    mapped_file_t file;
+    if (!map_file(filepath, file))
+    {
+        // TODO: Log error
+        return false;
+    }
+    bool result = obj_parse(file.data, file.size, out_mesh);
+    unmap_file(file);
+    if (!result)
+    {
+        return false;
+    }
+
+    mesh_compute_face_planes(out_mesh);
+    mesh_compute_bounds(out_mesh);
+    mesh_build_meshlets(out_mesh);
+    if (build_lods)
+    {
+        std::string lod_path = std::string(filepath) + ".lod";
+        if (!mesh_load_lods(out_mesh, lod_path.c_str()))
         {
-            ++nbSlashes;
+            mesh_build_lods(out_mesh);
+            if (!out_mesh.lods.empty())
+            {
+                mesh_save_lods(out_mesh, lod_path.c_str());
+            }
         }
-        ++ptr_start;
-        ++i;
     }
+    return result;
+}
+void mesh_store_soa(mesh_t& out_mesh)
+{
+    for (std::vector<float>& stream : out_mesh.positions)
+    {
+        stream.resize(out_mesh.vertices.size());
+    }
+    for (size_t i = 0; i < out_mesh.vertices.size(); ++i)
+    {
+        out_mesh.positions[0][i] = out_mesh.vertices[i].x;
+        out_mesh.positions[1][i] = out_mesh.vertices[i].y;
+        out_mesh.positions[2][i] = out_mesh.vertices[i].z;
+    }
+    out_mesh.vertices.clear();
+    out_mesh.vertices.shrink_to_fit();
+}
+
+uint32_t mesh_vertex_count(const mesh_t& in_mesh)
+{
+    return (uint32_t)(in_mesh.vertices.empty() ? in_mesh.positions[0].size()
+                                               : in_mesh.vertices.size());
+}
 
-    face_t face = {};
-    int vertex_indices[3] = {};
-    int texture_indices[3] = {};
-    int normal_indices[3] = {};
-    switch (nbSlashes)
+void mesh_compute_face_planes(mesh_t& out_mesh)
+{
+    out_mesh.face_normals.resize(out_mesh.faces.size());
+    out_mesh.face_distances.resize(out_mesh.faces.size());
+    for (size_t i = 0; i < out_mesh.faces.size(); ++i)
     {
-        case 0:
-        {
-#ifdef WIN32
-            sscanf_s(line, "f %d %d %d", &face.a, &face.b, &face.c);
-#else
-            sscanf(line, "f %d %d %d", &face.a, &face.b, &face.c);
-#endif
-        } break;
-
-        case 1: // Texture coords
-        {
-#ifdef WIN32
-            sscanf_s(line, "f %d/%d %d/%d %d/%d",
-                &vertex_indices[0], &texture_indices[0],
-                &vertex_indices[1], &texture_indices[1],
-                &vertex_indices[2], &texture_indices[2]);
-#else
-            sscanf(line, "f %d/%d %d/%d %d/%d",
-                &vertex_indices[0], &texture_indices[0],
-                &vertex_indices[1], &texture_indices[1],
-                &vertex_indices[2], &texture_indices[2]);
-#endif
-        } break;
-
-        // TODO: Probably broken for v//vn
-        case 2: // Texture coords and vertex normals
-        {
-#ifdef WIN32
-            sscanf_s(line, "f %d/%d/%d %d/%d/%d %d/%d/%d",
-                &vertex_indices[0], &texture_indices[0], &normal_indices[0],
-                &vertex_indices[1], &texture_indices[1], &normal_indices[1],
-                &vertex_indices[2], &texture_indices[2], &normal_indices[2]);
-#else
-            sscanf(line, "f %d/%d/%d %d/%d/%d %d/%d/%d",
-                &vertex_indices[0], &texture_indices[0], &normal_indices[0],
-                &vertex_indices[1], &texture_indices[1], &normal_indices[1],
-                &vertex_indices[2], &texture_indices[2], &normal_indices[2]);
-#endif
-        } break;
-    }
-    face.a = vertex_indices[0] - 1;
-    face.b = vertex_indices[1] - 1;
-    face.c = vertex_indices[2] - 1;
-    face.a_uv = texcoords[texture_indices[0] - 1];
-    face.b_uv = texcoords[texture_indices[1] - 1];
-    face.c_uv = texcoords[texture_indices[2] - 1];
-    out_mesh.faces.push_back(face);
+        const face_t& face = out_mesh.faces[i];
+        vec3_t vertex_a = mesh_position(out_mesh, face.a - 1); /*   A   */
+        vec3_t vertex_b = mesh_position(out_mesh, face.b - 1); /*  / \  */
+        vec3_t vertex_c = mesh_position(out_mesh, face.c - 1); /* C---B */
+
+        vec3_t normal = (vertex_b - vertex_a).cross_product(vertex_c - vertex_a);
+        out_mesh.face_normals[i] = normal;
+        out_mesh.face_distances[i] = normal.dot_product(vertex_a);
+    }
 }
 
-static void parse_texture_coords(char* line, mesh_t& out_mesh, std::vector<tex2_t>& texcoords)
+void mesh_compute_bounds(mesh_t& out_mesh)
 {
-    tex2_t texcoord = {};
-#ifdef WIN32
-    sscanf_s(line, "vt %f %f", &texcoord.u, &texcoord.v);
-#else
-    sscanf(line, "vt %f %f", &vertex.x, &vertex.y);
-#endif
-    texcoords.push_back(texcoord);
+    uint32_t count = mesh_vertex_count(out_mesh);
+    if (count == 0)
+    {
+        out_mesh.bounds_min = out_mesh.bounds_max = { 0.0f, 0.0f, 0.0f };
+        out_mesh.sphere_center = { 0.0f, 0.0f, 0.0f };
+        out_mesh.sphere_radius = 0.0f;
+        return;
+    }
+
+    vec3_t min = mesh_position(out_mesh, 0);
+    vec3_t max = min;
+    for (uint32_t i = 1; i < count; ++i)
+    {
+        vec3_t position = mesh_position(out_mesh, i);
+        min = { std::min(min.x, position.x), std::min(min.y, position.y),
+                std::min(min.z, position.z) };
+        max = { std::max(max.x, position.x), std::max(max.y, position.y),
+                std::max(max.z, position.z) };
+    }
+    out_mesh.bounds_min = min;
+    out_mesh.bounds_max = max;
+
+    // Tighter than half the diagonal: the farthest vertex from the center
+    vec3_t center = (min + max) * 0.5f;
+    float radius_squared = 0.0f;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        vec3_t offset = mesh_position(out_mesh, i) - center;
+        radius_squared = std::max(radius_squared, offset.dot_product(offset));
+    }
+    out_mesh.sphere_center = center;
+    out_mesh.sphere_radius = sqrtf(radius_squared);
 }
 
-static void parse_vertex_index(char* line, mesh_t& out_mesh)
+/*******************************************************************************
+ * Meshlets
+*******************************************************************************/
+static vec3_t unit_face_normal(const mesh_t& in_mesh, uint32_t face)
 {
-    vec3_t vertex = {};
-#ifdef WIN32
-    sscanf_s(line, "v %f %f %f", &vertex.x, &vertex.y, &vertex.z);
-#else
-    sscanf(line, "v %f %f %f", &vertex.x, &vertex.y, &vertex.z);
-#endif
-    out_mesh.vertices.push_back(vertex);
+    vec3_t normal = in_mesh.face_normals[face];
+    float length = normal.length();
+    return length > 0.0f ? normal / length : vec3_t{ 0.0f, 0.0f, 0.0f };
 }
 
-// https://en.wikipedia.org/wiki/Wavefront_.obj_file#References
-bool create_mesh_from_obj(const char* filepath, mesh_t& out_mesh)
+// Bounding sphere and normal cone of the faces of 'meshlet'
+static void compute_meshlet_bounds(const mesh_t& in_mesh, meshlet_t& meshlet)
 {
-    bool result = false;
+    uint32_t last = meshlet.first_face + meshlet.face_count;
+    vec3_t min = mesh_position(in_mesh, in_mesh.faces[meshlet.first_face].a - 1);
+    vec3_t max = min;
+    vec3_t normal_sum = { 0.0f, 0.0f, 0.0f };
+    for (uint32_t i = meshlet.first_face; i < last; ++i)
+    {
+        for (int index : in_mesh.faces[i].data)
+        {
+            vec3_t position = mesh_position(in_mesh, index - 1);
+            min = { std::min(min.x, position.x), std::min(min.y, position.y),
+                    std::min(min.z, position.z) };
+            max = { std::max(max.x, position.x), std::max(max.y, position.y),
+                    std::max(max.z, position.z) };
+        }
+        normal_sum = normal_sum + unit_face_normal(in_mesh, i);
+    }
 
-    // TODO: Check if .obj file else error
-#ifdef WIN32
-    FILE* file_ptr = nullptr;
-    fopen_s(&file_ptr, filepath, "r");
-#else
-    FILE* file_ptr = fopen(filepath, "r");
-#endif
-    if (!file_ptr)
+    meshlet.center = (min + max) * 0.5f;
+    float radius_squared = 0.0f;
+    for (uint32_t i = meshlet.first_face; i < last; ++i)
     {
-        // TODO: Log error
-        return result;
+        for (int index : in_mesh.faces[i].data)
+        {
+            vec3_t offset = mesh_position(in_mesh, index - 1) - meshlet.center;
+            radius_squared = std::max(radius_squared,
+                                      offset.dot_product(offset));
+        }
     }
+    meshlet.radius = sqrtf(radius_squared);
 
-    char line[2024];
-    std::vector<tex2_t> texcoords;
-    while (fgets(line, 1024, file_ptr)) {
-        // Vertex information
-        if (strncmp(line, "v ", 2) == 0) {
-            vec3_t vertex;
-            sscanf(line, "v %f %f %f", &vertex.x, &vertex.y, &vertex.z);
-            out_mesh.vertices.push_back(vertex);
+    // The cone holds every normal when its half angle reaches the widest one.
+    // Degenerate faces have no normal, they are always culled.
+    meshlet.cone_axis = { 0.0f, 0.0f, 0.0f };
+    meshlet.cone_cutoff = 1.0f;
+    float axis_length = normal_sum.length();
+    if (axis_length == 0.0f)
+    {
+        return;
+    }
+    meshlet.cone_axis = normal_sum / axis_length;
+    float min_dot = 1.0f;
+    for (uint32_t i = meshlet.first_face; i < last; ++i)
+    {
+        vec3_t normal = unit_face_normal(in_mesh, i);
+        if (normal.dot_product(normal) > 0.0f)
+        {
+            min_dot = std::min(min_dot, normal.dot_product(meshlet.cone_axis));
         }
-        // Texture coordinate information
-        if (strncmp(line, "vt ", 3) == 0) {
-            tex2_t texcoord;
-            sscanf(line, "vt %f %f", &texcoord.u, &texcoord.v);
-            texcoords.push_back(texcoord);
+    }
+    // Wider than a half sphere: some face always looks at the camera
+    if (min_dot > 0.0f)
+    {
+        meshlet.cone_cutoff = sqrtf(1.0f - min_dot * min_dot);
+    }
+}
+
+void mesh_build_meshlets(mesh_t& out_mesh)
+{
+    uint32_t face_count = (uint32_t)out_mesh.faces.size();
+    uint32_t vertex_count = mesh_vertex_count(out_mesh);
+    out_mesh.meshlets.clear();
+    if (out_mesh.face_normals.size() != face_count)
+    {
+        mesh_compute_face_planes(out_mesh);
+    }
+
+    // Faces around each vertex, packed: faces of vertex v start at
+    // vertex_faces_start[v]
+    std::vector<uint32_t> vertex_faces_start(vertex_count + 1, 0);
+    for (const face_t& face : out_mesh.faces)
+    {
+        for (int index : face.data)
+        {
+            ++vertex_faces_start[index];
+        }
+    }
+    for (uint32_t v = 0; v < vertex_count; ++v)
+    {
+        vertex_faces_start[v + 1] += vertex_faces_start[v];
+    }
+    std::vector<uint32_t> vertex_faces(vertex_faces_start[vertex_count]);
+    std::vector<uint32_t> fill(vertex_faces_start.begin(),
+                               vertex_faces_start.end() - 1);
+    for (uint32_t i = 0; i < face_count; ++i)
+    {
+        for (int index : out_mesh.faces[i].data)
+        {
+            vertex_faces[fill[index - 1]++] = i;
+        }
+    }
+
+    std::vector<uint8_t> assigned(face_count, 0);
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> candidates;
+    order.reserve(face_count);
+    for (uint32_t seed = 0; seed < face_count; ++seed)
+    {
+        if (assigned[seed])
+        {
+            continue;
         }
-        // Face information
-        if (strncmp(line, "f ", 2) == 0) {
-            int vertex_indices[3];
-            int texture_indices[3];
-            int normal_indices[3];
-            sscanf(
-                line, "f %d/%d/%d %d/%d/%d %d/%d/%d",
-                &vertex_indices[0], &texture_indices[0], &normal_indices[0],
-                &vertex_indices[1], &texture_indices[1], &normal_indices[1],
-                &vertex_indices[2], &texture_indices[2], &normal_indices[2]
-            );
-            face_t face = {};
-            face.a = vertex_indices[0],
-            face.b = vertex_indices[1],
-            face.c = vertex_indices[2],
-            face.a_uv = texcoords[texture_indices[0] - 1],
-            face.b_uv = texcoords[texture_indices[1] - 1],
-            face.c_uv = texcoords[texture_indices[2] - 1],
-            face.color = 0xFFFFFFFF;
-            out_mesh.faces.push_back(face);
+
+        meshlet_t meshlet = {};
+        meshlet.first_face = (uint32_t)order.size();
+        vec3_t normal_sum = { 0.0f, 0.0f, 0.0f };
+        candidates.assign(1, seed);
+        while (meshlet.face_count < MESHLET_MAX_FACES && !candidates.empty())
+        {
+            // Next face: the neighbour closest to the average normal so far
+            size_t best = 0;
+            float best_dot = -2.0f;
+            for (size_t c = 0; c < candidates.size(); ++c)
+            {
+                float dot = unit_face_normal(out_mesh, candidates[c])
+                                .dot_product(normal_sum);
+                if (dot > best_dot)
+                {
+                    best = c;
+                    best_dot = dot;
+                }
+            }
+            uint32_t face = candidates[best];
+            candidates[best] = candidates.back();
+            candidates.pop_back();
+            if (assigned[face])
+            {
+                continue;
+            }
+
+            assigned[face] = 1;
+            order.push_back(face);
+            ++meshlet.face_count;
+            normal_sum = normal_sum + unit_face_normal(out_mesh, face);
+            for (int index : out_mesh.faces[face].data)
+            {
+                for (uint32_t f = vertex_faces_start[index - 1];
+                     f < vertex_faces_start[index]; ++f)
+                {
+                    if (!assigned[vertex_faces[f]])
+                    {
+                        candidates.push_back(vertex_faces[f]);
+                    }
+                }
+            }
         }
+        out_mesh.meshlets.push_back(meshlet);
     }
 
-    fclose(file_ptr);
-    result = true;
-    return result;
-}
\ No newline at end of file
+    // Faces and planes in meshlet order
+    std::vector<face_t> faces(face_count);
+    std::vector<vec3_t> normals(face_count);
+    std::vector<float> distances(face_count);
+    for (uint32_t i = 0; i < face_count; ++i)
+    {
+        faces[i] = out_mesh.faces[order[i]];
+        normals[i] = out_mesh.face_normals[order[i]];
+        distances[i] = out_mesh.face_distances[order[i]];
+    }
+    out_mesh.faces.swap(faces);
+    out_mesh.face_normals.swap(normals);
+    out_mesh.face_distances.swap(distances);
+
+    for (meshlet_t& meshlet : out_mesh.meshlets)
+    {
+        compute_meshlet_bounds(out_mesh, meshlet);
+    }
+}
+
+bool meshlet_backfacing(const meshlet_t& meshlet, const vec3_t& camera,
+                        float facing)
+{
+    // The whole bounding sphere behind every face of the cone
+    vec3_t direction = meshlet.center - camera;
+    return facing * direction.dot_product(meshlet.cone_axis) >=
+           meshlet.cone_cutoff * direction.length() + meshlet.radius;
+}
+
+void transform_mesh(const mesh_t& in_mesh, const mat4_t& world_matrix,
+                    const mat4_t& projection_matrix, float width, float height,
+                    transformed_mesh_t& out_transformed)
+{
+    // Shared vertices are transformed once instead of once per face using them
+    uint32_t count = mesh_vertex_count(in_mesh);
+    const float* positions[3] = {
+        in_mesh.positions[0].data(),
+        in_mesh.positions[1].data(),
+        in_mesh.positions[2].data()
+    };
+    if (!in_mesh.vertices.empty())
+    {
+        // AoS mesh: gather the streams first
+        for (int k = 0; k < 3; ++k)
+        {
+            out_transformed.gathered[k].resize(count);
+            positions[k] = out_transformed.gathered[k].data();
+        }
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            out_transformed.gathered[0][i] = in_mesh.vertices[i].x;
+            out_transformed.gathered[1][i] = in_mesh.vertices[i].y;
+            out_transformed.gathered[2][i] = in_mesh.vertices[i].z;
+        }
+    }
+
+    float* world[4] = {};
+    float* clip[4] = {};
+    float* screen[3] = {};
+    for (int k = 0; k < 4; ++k)
+    {
+        out_transformed.clip[k].resize(count);
+        clip[k] = out_transformed.clip[k].data();
+        if (k < 3)
+        {
+            out_transformed.world[k].resize(count);
+            out_transformed.screen[k].resize(count);
+            world[k] = out_transformed.world[k].data();
+            screen[k] = out_transformed.screen[k].data();
+        }
+    }
+
+    mat4_transform_points(world_matrix, positions, count, world);
+    mat4_project_points(projection_matrix, world, count, width, height, clip,
+                        screen);
+}
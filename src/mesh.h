@@ -1,4 +1,5 @@
 #pragma once
+#include "matrix.h"
 #include "vector.h"
 #include "triangle.h"
 
@@ -7,19 +8,117 @@
 #define N_CUBE_VERTICES 8
 #define N_CUBE_FACES (6 * 2) // 6 cube faces, 2 triangles per face
 
+// Faces per meshlet, at most
+#define MESHLET_MAX_FACES 64
+
 extern vec3_t cube_vertices[N_CUBE_VERTICES];
 extern face_t cube_faces[N_CUBE_FACES];
 
+// A cluster of neighbouring faces: faces [first_face, first_face + face_count)
+// of its mesh. Object space bounds.
+struct meshlet_t
+{
+    uint32_t first_face  = 0;
+    uint32_t face_count  = 0;
+    vec3_t   center      = { 0.0f, 0.0f, 0.0f }; // Bounding sphere
+    float    radius      = 0.0f;
+    vec3_t   cone_axis   = { 0.0f, 0.0f, 0.0f }; // Normal cone, unit length
+    float    cone_cutoff = 1.0f; // Sine of the cone half angle, 1: never culled
+};
+
 struct mesh_t
 {
     std::vector<vec3_t> vertices;
+    // Optional SoA storage: x, y and z streams instead of 'vertices', see
+    // mesh_store_soa()
+    std::vector<float>  positions[3];
     std::vector<face_t> faces;
+    // Object space plane of each face, see mesh_compute_face_planes()
+    std::vector<vec3_t> face_normals;
+    std::vector<float>  face_distances;
+    // Object space bounds, see mesh_compute_bounds()
+    vec3_t bounds_min    = { 0.0f, 0.0f, 0.0f };
+    vec3_t bounds_max    = { 0.0f, 0.0f, 0.0f };
+    vec3_t sphere_center = { 0.0f, 0.0f, 0.0f };
+    float  sphere_radius = 0.0f;
+    // Optional, see mesh_build_meshlets()
+    std::vector<meshlet_t> meshlets;
+    // Optional simplified levels, coarser and coarser, see mesh_build_lods()
+    std::vector<mesh_t> lods;
     vec3_t rotation    = { 0.0f, 0.0f, 0.0f };
     vec3_t scale       = { 1.0f, 1.0f, 1.0f };
     vec3_t translation = { 0.0f, 0.0f, 0.0f };
 };
 
-bool create_mesh_from_obj(const char* filepath, mesh_t& out_mesh);
+// Post-transform vertex cache: every vertex of a mesh transformed once per
+// frame, faces then fetch their corners by index. Component streams, as the
+// batch transforms write them.
+struct transformed_mesh_t
+{
+    std::vector<float> world[3];  // World space x, y, z (w = 1)
+    std::vector<float> clip[4];   // Clip space, before the perspective divide
+    std::vector<float> screen[3]; // After the divide and viewport mapping
+    std::vector<float> gathered[3]; // Positions of an AoS mesh, as streams
+};
+
+// With 'build_lods', the LOD chain is loaded from "<filepath>.lod", or built
+// and saved there
+bool create_mesh_from_obj(const char* filepath, mesh_t& out_mesh,
+                          bool build_lods = false);
+// Moves the positions from 'vertices' into 'positions'
+void mesh_store_soa(mesh_t& out_mesh);
+uint32_t mesh_vertex_count(const mesh_t& in_mesh);
+// Plane of every face: dot(face_normals[i], p) = face_distances[i] for the
+// points p of face i. The normals are the raw cross products, not normalized,
+// pointing to the side the face is seen from.
+void mesh_compute_face_planes(mesh_t& out_mesh);
+// Axis aligned box around the vertices, and a sphere centered on the box
+void mesh_compute_bounds(mesh_t& out_mesh);
+// Groups the faces into meshlets of up to MESHLET_MAX_FACES connected faces,
+// grown toward the faces closest to the cluster's average normal to keep the
+// normal cones narrow. The faces and their planes are reordered meshlet by
+// meshlet.
+void mesh_build_meshlets(mesh_t& out_mesh);
+// True when every face of the meshlet faces away from 'camera', in object
+// space. 'facing' is -1 when the world matrix mirrors.
+bool meshlet_backfacing(const meshlet_t& meshlet, const vec3_t& camera,
+                        float facing);
+// Screen mapping as in mat4_project_points()
+void transform_mesh(const mesh_t& in_mesh, const mat4_t& world_matrix,
+                    const mat4_t& projection_matrix, float width, float height,
+                    transformed_mesh_t& out_transformed);
+
+inline vec3_t mesh_position(const mesh_t& in_mesh, uint32_t index)
+{
+    if (!in_mesh.vertices.empty())
+    {
+        return in_mesh.vertices[index];
+    }
+    return { in_mesh.positions[0][index], in_mesh.positions[1][index],
+             in_mesh.positions[2][index] };
+}
+
+inline vec4_t transformed_world(const transformed_mesh_t& transformed,
+                                uint32_t index)
+{
+    return { transformed.world[0][index], transformed.world[1][index],
+             transformed.world[2][index], 1.0f };
+}
+
+inline vec4_t transformed_clip(const transformed_mesh_t& transformed,
+                               uint32_t index)
+{
+    return { transformed.clip[0][index], transformed.clip[1][index],
+             transformed.clip[2][index], transformed.clip[3][index] };
+}
+
+// Screen x, y, z / w and the clip w
+inline vec4_t transformed_screen(const transformed_mesh_t& transformed,
+                                 uint32_t index)
+{
+    return { transformed.screen[0][index], transformed.screen[1][index],
+             transformed.screen[2][index], transformed.clip[3][index] };
+}
 
 extern mesh_t mesh;
 
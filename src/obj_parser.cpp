@@ -0,0 +1,575 @@
+#include "obj_parser.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*******************************************************************************
+ * Mapped Files
+*******************************************************************************/
+#ifdef WIN32
+bool map_file(const char* filepath, mapped_file_t& out_file)
+{
+    out_file = {};
+    HANDLE file = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+    out_file.file = file;
+    if (size.QuadPart == 0)
+    {
+        return true; // Nothing to map
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0,
+                                       nullptr);
+    const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)
+                               : nullptr;
+    if (!data)
+    {
+        if (mapping)
+        {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        out_file = {};
+        return false;
+    }
+    out_file.mapping = mapping;
+    out_file.data = (const char*)data;
+    out_file.size = (size_t)size.QuadPart;
+    return true;
+}
+
+void unmap_file(mapped_file_t& file)
+{
+    if (file.data)
+    {
+        UnmapViewOfFile(file.data);
+    }
+    if (file.mapping)
+    {
+        CloseHandle(file.mapping);
+    }
+    if (file.file)
+    {
+        CloseHandle(file.file);
+    }
+    file = {};
+}
+#else
+bool map_file(const char* filepath, mapped_file_t& out_file)
+{
+    out_file = {};
+    int file = open(filepath, O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+
+    struct stat status = {};
+    bool result = fstat(file, &status) == 0;
+    if (result && status.st_size > 0)
+    {
+        void* data = mmap(nullptr, (size_t)status.st_size, PROT_READ,
+                          MAP_PRIVATE, file, 0);
+        result = data != MAP_FAILED;
+        if (result)
+        {
+            madvise(data, (size_t)status.st_size, MADV_SEQUENTIAL);
+            out_file.data = (const char*)data;
+            out_file.size = (size_t)status.st_size;
+        }
+    }
+    // The mapping keeps the file open
+    close(file);
+    return result;
+}
+
+void unmap_file(mapped_file_t& file)
+{
+    if (file.data)
+    {
+        munmap((void*)file.data, file.size);
+    }
+    file = {};
+}
+#endif
+
+/*******************************************************************************
+ * Scanning
+*******************************************************************************/
+static bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* skip_blanks(const char* ptr, const char* end)
+{
+    while (ptr < end && is_blank(*ptr))
+    {
+        ++ptr;
+    }
+    return ptr;
+}
+
+static const char* next_line(const char* ptr, const char* end)
+{
+    const char* newline = (const char*)memchr(ptr, '\n', end - ptr);
+    return newline ? newline + 1 : end;
+}
+
+// Keyword at 'ptr' followed by a blank
+static bool has_keyword(const char* ptr, const char* end, const char* keyword,
+                        size_t length)
+{
+    return (size_t)(end - ptr) > length &&
+           memcmp(ptr, keyword, length) == 0 && is_blank(ptr[length]);
+}
+
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Decimal numbers with up to 15 significant digits and a small exponent, the
+// bulk of OBJ files: the digits and the power of ten are exact doubles, so
+// one multiplication or division rounds the exact value once (Clinger). The
+// double then rounds right to a float, unless it landed exactly halfway
+// between two floats. False when the number is out of this case, it then goes
+// through std::from_chars.
+static bool parse_float_fast(const char* ptr, const char* end,
+                             float& out_value, const char*& out_end)
+{
+    static const double POWERS_OF_TEN[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    bool negative = ptr < end && *ptr == '-';
+    ptr += negative ? 1 : 0;
+    uint64_t mantissa = 0;
+    int digits = 0;    // Significant digits in the mantissa
+    int exponent = 0;  // Power of ten applied to the mantissa
+    bool any_digit = false;
+    for (; ptr < end && is_digit(*ptr); ++ptr, any_digit = true)
+    {
+        mantissa = mantissa * 10 + (*ptr - '0');
+        digits += mantissa ? 1 : 0;
+    }
+    if (ptr < end && *ptr == '.')
+    {
+        for (++ptr; ptr < end && is_digit(*ptr); ++ptr, any_digit = true)
+        {
+            mantissa = mantissa * 10 + (*ptr - '0');
+            digits += mantissa ? 1 : 0;
+            --exponent;
+        }
+    }
+    if (!any_digit || digits > 15)
+    {
+        return false;
+    }
+    if (ptr < end && (*ptr == 'e' || *ptr == 'E'))
+    {
+        const char* cursor = ptr + 1;
+        bool negative_exponent = cursor < end && *cursor == '-';
+        cursor += cursor < end && (*cursor == '-' || *cursor == '+') ? 1 : 0;
+        int value = 0;
+        bool exponent_digit = false;
+        for (; cursor < end && is_digit(*cursor) && value < 1000; ++cursor)
+        {
+            value = value * 10 + (*cursor - '0');
+            exponent_digit = true;
+        }
+        if (exponent_digit)
+        {
+            exponent += negative_exponent ? -value : value;
+            ptr = cursor;
+        }
+    }
+    if (ptr < end && (is_digit(*ptr) || *ptr == 'e' || *ptr == 'E'))
+    {
+        return false; // Exponent too long
+    }
+    if (exponent < -22 || exponent > 22)
+    {
+        return false;
+    }
+
+    double value = exponent < 0 ? (double)mantissa / POWERS_OF_TEN[-exponent]
+                                : (double)mantissa * POWERS_OF_TEN[exponent];
+
+    // Normal floats only. Of the 52 mantissa bits, the low 29 are dropped:
+    // halfway is a one followed by zeros.
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    int biased_exponent = (int)(bits >> 52);
+    if (mantissa != 0 && (biased_exponent < 1023 - 126 ||
+                          biased_exponent > 1023 + 127 ||
+                          (bits & 0x1FFFFFFF) == 0x10000000))
+    {
+        return false;
+    }
+    float result = (float)value;
+    out_value = negative ? -result : result;
+    out_end = ptr;
+    return true;
+}
+
+static const char* parse_float(const char* ptr, const char* end,
+                               float& out_value)
+{
+    ptr = skip_blanks(ptr, end);
+    if (ptr < end && *ptr == '+')
+    {
+        ++ptr; // from_chars takes no plus sign
+    }
+    const char* number_end = nullptr;
+    if (parse_float_fast(ptr, end, out_value, number_end))
+    {
+        return number_end;
+    }
+    std::from_chars_result result = std::from_chars(ptr, end, out_value);
+    return result.ec == std::errc() ? result.ptr : nullptr;
+}
+
+static const char* parse_int(const char* ptr, const char* end, int& out_value)
+{
+    bool negative = ptr < end && *ptr == '-';
+    ptr += negative ? 1 : 0;
+    const char* first = ptr;
+    int64_t value = 0;
+    while (ptr < end && is_digit(*ptr) && value <= INT32_MAX)
+    {
+        value = value * 10 + (*ptr - '0');
+        ++ptr;
+    }
+    if (ptr == first || value > INT32_MAX)
+    {
+        return nullptr;
+    }
+    out_value = (int)(negative ? -value : value);
+    return ptr;
+}
+
+/*******************************************************************************
+ * OBJ Parser
+*******************************************************************************/
+// A face of a chunk. Positive indices in the file are kept, negative ones are
+// made relative to the chunk: its first element is 1, earlier ones 0 or less.
+// 'relative' has bits 0-2 for the vertices, 3-5 for the texture coordinates.
+// A texture coordinate is absent when 0 and not relative.
+struct obj_face_t
+{
+    int     vertices[3];
+    int     texcoords[3];
+    uint8_t relative;
+};
+
+// A corner as read, 'relative' has bit 0 for the vertex, 1 for the texture
+// coordinate
+struct obj_corner_t
+{
+    int     vertex;
+    int     texcoord;
+    uint8_t relative;
+};
+
+// What a chunk of lines adds, before indices are known across chunks
+struct obj_chunk_t
+{
+    std::vector<vec3_t>     vertices;
+    std::vector<tex2_t>     texcoords;
+    std::vector<obj_face_t> faces;
+    // Elements needed before the chunk for every index to exist
+    int64_t                 vertices_needed  = 0;
+    int64_t                 texcoords_needed = 0;
+    bool                    result           = true;
+};
+
+// Index of one of the 'count' elements seen so far in the chunk. Updates the
+// elements needed before the chunk, false on index 0.
+static bool chunk_index(int& index, size_t count, int64_t& needed,
+                        bool& out_relative)
+{
+    out_relative = index < 0;
+    if (index < 0)
+    {
+        index += (int)count + 1;
+        needed = std::max<int64_t>(needed, 1 - (int64_t)index);
+    }
+    else
+    {
+        needed = std::max<int64_t>(needed, (int64_t)index - (int64_t)count);
+    }
+    return index != 0 || out_relative;
+}
+
+// Parses the lines in [text, end), which starts a line
+static bool parse_chunk(const char* text, const char* end,
+                        obj_chunk_t& out_chunk)
+{
+    // Quick count to size the arrays once
+    size_t vertex_lines = 0;
+    size_t texcoord_lines = 0;
+    size_t face_lines = 0;
+    for (const char* ptr = text; ptr < end; ptr = next_line(ptr, end))
+    {
+        vertex_lines += has_keyword(ptr, end, "v", 1) ? 1 : 0;
+        texcoord_lines += has_keyword(ptr, end, "vt", 2) ? 1 : 0;
+        face_lines += has_keyword(ptr, end, "f", 1) ? 1 : 0;
+    }
+    out_chunk.vertices.reserve(vertex_lines);
+    out_chunk.texcoords.reserve(texcoord_lines);
+    out_chunk.faces.reserve(face_lines);
+
+    obj_corner_t first = {};
+    obj_corner_t previous = {};
+    for (const char* ptr = text; ptr < end; ptr = next_line(ptr, end))
+    {
+        ptr = skip_blanks(ptr, end);
+        if (has_keyword(ptr, end, "v", 1))
+        {
+            vec3_t vertex = {};
+            const char* cursor = ptr + 1;
+            for (float& component : vertex.data)
+            {
+                if (!(cursor = parse_float(cursor, end, component)))
+                {
+                    return false;
+                }
+            }
+            out_chunk.vertices.push_back(vertex);
+        }
+        else if (has_keyword(ptr, end, "vt", 2))
+        {
+            tex2_t texcoord = {};
+            const char* cursor = parse_float(ptr + 2, end, texcoord.u);
+            if (!cursor)
+            {
+                return false;
+            }
+            // v and w are optional, w is dropped. Nothing else but a comment.
+            float w = 0.0f;
+            float* optional[2] = { &texcoord.v, &w };
+            for (float* component : optional)
+            {
+                cursor = skip_blanks(cursor, end);
+                if (cursor == end || *cursor == '\n' || *cursor == '#')
+                {
+                    break;
+                }
+                if (!(cursor = parse_float(cursor, end, *component)))
+                {
+                    return false;
+                }
+            }
+            cursor = skip_blanks(cursor, end);
+            if (cursor < end && *cursor != '\n' && *cursor != '#')
+            {
+                return false;
+            }
+            out_chunk.texcoords.push_back(texcoord);
+        }
+        else if (has_keyword(ptr, end, "f", 1))
+        {
+            // v, v/vt, v//vn or v/vt/vn corners
+            int corner_count = 0;
+            const char* cursor = skip_blanks(ptr + 1, end);
+            while (cursor < end && *cursor != '\n' && *cursor != '#')
+            {
+                int vertex = 0;
+                int texcoord = 0;
+                int normal = 0;
+                bool has_texcoord = false;
+                if (!(cursor = parse_int(cursor, end, vertex)))
+                {
+                    return false;
+                }
+                if (cursor < end && *cursor == '/')
+                {
+                    ++cursor;
+                    has_texcoord = cursor < end && *cursor != '/';
+                    if (has_texcoord &&
+                        !(cursor = parse_int(cursor, end, texcoord)))
+                    {
+                        return false;
+                    }
+                    if (cursor < end && *cursor == '/' &&
+                        !(cursor = parse_int(cursor + 1, end, normal)))
+                    {
+                        return false;
+                    }
+                }
+
+                obj_corner_t corner = {};
+                bool relative = false;
+                if (!chunk_index(vertex, out_chunk.vertices.size(),
+                                 out_chunk.vertices_needed, relative))
+                {
+                    return false;
+                }
+                corner.vertex = vertex;
+                corner.relative = relative ? 1 : 0;
+                if (has_texcoord)
+                {
+                    if (!chunk_index(texcoord, out_chunk.texcoords.size(),
+                                     out_chunk.texcoords_needed, relative))
+                    {
+                        return false;
+                    }
+                    corner.texcoord = texcoord;
+                    corner.relative |= relative ? 2 : 0;
+                }
+
+                // Fan around the first corner
+                if (corner_count >= 2)
+                {
+                    const obj_corner_t* fan[3] = { &first, &previous, &corner };
+                    obj_face_t face = {};
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        face.vertices[j] = fan[j]->vertex;
+                        face.texcoords[j] = fan[j]->texcoord;
+                        face.relative |= (uint8_t)(
+                            (fan[j]->relative & 1) << j |
+                            (fan[j]->relative >> 1) << (j + 3));
+                    }
+                    out_chunk.faces.push_back(face);
+                }
+                (corner_count == 0 ? first : previous) = corner;
+                ++corner_count;
+                cursor = skip_blanks(cursor, end);
+            }
+            if (corner_count < 3)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static uint32_t default_chunk_count(size_t size)
+{
+    size_t chunks = size / OBJ_CHUNK_SIZE;
+    return (uint32_t)std::clamp<size_t>(chunks, 1, thread_count() * 4);
+}
+
+bool obj_parse(const char* text, size_t size, mesh_t& out_mesh,
+               uint32_t chunk_count)
+{
+    const char* end = text + size;
+    if (chunk_count == 0)
+    {
+        chunk_count = default_chunk_count(size);
+    }
+
+    // Chunks start on a line, right after the newline ending the previous one
+    std::vector<const char*> starts(chunk_count + 1, end);
+    starts[0] = text;
+    for (uint32_t chunk = 1; chunk < chunk_count; ++chunk)
+    {
+        size_t offset = (size_t)((uint64_t)size * chunk / chunk_count);
+        const char* start = std::max(text + offset, starts[chunk - 1] + 1);
+        starts[chunk] = start >= end ? end : next_line(start - 1, end);
+    }
+
+    std::vector<obj_chunk_t> chunks(chunk_count);
+    parallel_for(chunk_count, [&](uint32_t chunk) {
+        chunks[chunk].result = parse_chunk(starts[chunk], starts[chunk + 1],
+                                           chunks[chunk]);
+    });
+
+    // Where each chunk goes, and whether its indices exist
+    std::vector<size_t> vertex_bases(chunk_count + 1, 0);
+    std::vector<size_t> texcoord_bases(chunk_count + 1, 0);
+    std::vector<size_t> face_bases(chunk_count + 1, 0);
+    for (uint32_t chunk = 0; chunk < chunk_count; ++chunk)
+    {
+        const obj_chunk_t& parsed = chunks[chunk];
+        if (!parsed.result ||
+            parsed.vertices_needed > (int64_t)vertex_bases[chunk] ||
+            parsed.texcoords_needed > (int64_t)texcoord_bases[chunk])
+        {
+            return false;
+        }
+        vertex_bases[chunk + 1] = vertex_bases[chunk] + parsed.vertices.size();
+        texcoord_bases[chunk + 1] = texcoord_bases[chunk] +
+                                    parsed.texcoords.size();
+        face_bases[chunk + 1] = face_bases[chunk] + parsed.faces.size();
+    }
+
+    size_t base_vertex = out_mesh.vertices.size();
+    size_t base_face = out_mesh.faces.size();
+    out_mesh.vertices.resize(base_vertex + vertex_bases[chunk_count]);
+    out_mesh.faces.resize(base_face + face_bases[chunk_count]);
+    std::vector<tex2_t> texcoords(texcoord_bases[chunk_count]);
+    parallel_for(chunk_count, [&](uint32_t chunk) {
+        const obj_chunk_t& parsed = chunks[chunk];
+        std::copy(parsed.vertices.begin(), parsed.vertices.end(),
+                  out_mesh.vertices.begin() + base_vertex +
+                      vertex_bases[chunk]);
+        std::copy(parsed.texcoords.begin(), parsed.texcoords.end(),
+                  texcoords.begin() + texcoord_bases[chunk]);
+    });
+
+    // Indices across chunks, then texture coordinates by index
+    parallel_for(chunk_count, [&](uint32_t chunk) {
+        const obj_chunk_t& parsed = chunks[chunk];
+        face_t* faces = out_mesh.faces.data() + base_face + face_bases[chunk];
+        for (const obj_face_t& parsed_face : parsed.faces)
+        {
+            face_t face = {};
+            tex2_t* uvs[3] = { &face.a_uv, &face.b_uv, &face.c_uv };
+            for (int j = 0; j < 3; ++j)
+            {
+                int64_t vertex = parsed_face.vertices[j];
+                if (parsed_face.relative >> j & 1)
+                {
+                    vertex += (int64_t)vertex_bases[chunk];
+                }
+                face.data[j] = (int)(base_vertex + vertex);
+
+                int64_t texcoord = parsed_face.texcoords[j];
+                if (parsed_face.relative >> (j + 3) & 1)
+                {
+                    texcoord += (int64_t)texcoord_bases[chunk];
+                }
+                else if (texcoord == 0)
+                {
+                    continue; // No texture coordinate
+                }
+                *uvs[j] = texcoords[texcoord - 1];
+            }
+            face.color = 0xFFFFFFFF;
+            *faces++ = face;
+        }
+    });
+    return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Bytes of text per chunk parsed in parallel, at least
+#define OBJ_CHUNK_SIZE (256 * 1024)
+
+/*******************************************************************************
+ * Mapped Files
+*******************************************************************************/
+// A read-only view of a whole file. An empty file maps to data == nullptr.
+struct mapped_file_t
+{
+    const char* data = nullptr;
+    size_t      size = 0;
+#ifdef WIN32
+    void*       file    = nullptr;
+    void*       mapping = nullptr;
+#endif
+};
+
+bool map_file(const char* filepath, mapped_file_t& out_file);
+void unmap_file(mapped_file_t& file);
+
+/*******************************************************************************
+ * OBJ Parser
+********************************************************************************
+** No copies or per-line calls into libc: numbers are read in place, by hand,
+** with std::from_chars for the floats the fast path cannot round exactly.
+**
+** Reads 'v x y z', 'vt u v' and 'f' lines, with v, v/vt, v//vn or v/vt/vn
+** corners and negative (relative) indices. Polygons are split in fans of
+** triangles. Faces without texture coordinates get (0, 0). Other lines are
+** skipped.
+**
+** The text is cut in chunks at line boundaries, parsed in parallel. Each
+** chunk counts its lines to size its arrays, then fills them, keeping the
+** negative indices relative to the chunk. Prefix sums of the chunk sizes then
+** place every chunk and fix its indices: the mesh is the same whatever the
+** number of chunks.
+*******************************************************************************/
+// Appends to 'out_mesh'. False when a line is malformed or a face uses a
+// vertex or texture coordinate not defined before it, 'out_mesh' is then
+// left as it was. 'chunk_count' 0 picks one chunk per OBJ_CHUNK_SIZE bytes,
+// up to a few per thread.
+bool obj_parse(const char* text, size_t size, mesh_t& out_mesh,
+               uint32_t chunk_count = 0);
@@ -0,0 +1,161 @@
+#include "occlusion.h"
+#include "display.h"
+#include "raster.h"
+
+#include <algorithm>
+#include <cmath>
+
+/*******************************************************************************
+ * Clear
+*******************************************************************************/
+void occlusion_clear(occlusion_buffer_t& buffer, float screen_width,
+                     float screen_height, const mat4_t& projection_matrix)
+{
+    buffer.scale_x = (float)buffer.width / screen_width;
+    buffer.scale_y = (float)buffer.height / screen_height;
+    buffer.projection_matrix = projection_matrix;
+    buffer.depth.assign(buffer.width * buffer.height, 1.0f);
+}
+
+/*******************************************************************************
+ * Depth only rasterization
+*******************************************************************************/
+static void draw_depth(occlusion_buffer_t& buffer,
+                       const raster_triangle_t& triangle)
+{
+    // Farthest depth within a pixel of the sample: 1/w changes by at most its
+    // steps from one pixel to the next
+    const plane_t& reciprocal_w = triangle.reciprocal_w;
+    float slack = fabsf(reciprocal_w.step_x) + fabsf(reciprocal_w.step_y);
+
+    int64_t row_edges[3] = { triangle.edges[0].origin, triangle.edges[1].origin,
+                             triangle.edges[2].origin };
+    float row_reciprocal_w = reciprocal_w.origin - slack;
+    for (int y = triangle.min_y; y <= triangle.max_y; ++y)
+    {
+        int64_t e0 = row_edges[0];
+        int64_t e1 = row_edges[1];
+        int64_t e2 = row_edges[2];
+        float value = row_reciprocal_w;
+        float* depth = buffer.depth.data() + buffer.width * y;
+        for (int x = triangle.min_x; x <= triangle.max_x; ++x)
+        {
+            // Inside when no edge value is negative
+            if ((e0 | e1 | e2) >= 0)
+            {
+                depth[x] = std::min(depth[x], 1.0f - value);
+            }
+            e0 += triangle.edges[0].step_x;
+            e1 += triangle.edges[1].step_x;
+            e2 += triangle.edges[2].step_x;
+            value += reciprocal_w.step_x;
+        }
+
+        for (int i = 0; i < 3; ++i)
+        {
+            row_edges[i] += triangle.edges[i].step_y;
+        }
+        row_reciprocal_w += reciprocal_w.step_y;
+    }
+}
+
+void occlusion_draw_triangles(occlusion_buffer_t& buffer,
+                              const std::vector<triangle_t>& triangles)
+{
+    // Only the size of the target matters to the setup
+    ColorBuffer target = {};
+    target.width = buffer.width;
+    target.height = buffer.height;
+
+    for (const triangle_t& triangle : triangles)
+    {
+        vec4_t points[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            points[i] = triangle.points[i];
+            points[i].x *= buffer.scale_x;
+            points[i].y *= buffer.scale_y;
+        }
+
+        raster_triangle_t setup;
+        if (raster_setup_triangle(setup, target, points, triangle.texcoord))
+        {
+            draw_depth(buffer, setup);
+        }
+    }
+}
+
+/*******************************************************************************
+ * Bounds against the occluders
+*******************************************************************************/
+// The corners of a box transformed by 'clip_matrix' into clip space
+static bool test_corners(const occlusion_buffer_t& buffer,
+                         const mat4_t& clip_matrix, const vec3_t& min,
+                         const vec3_t& max)
+{
+    float min_x = (float)buffer.width;
+    float min_y = (float)buffer.height;
+    float max_x = 0.0f;
+    float max_y = 0.0f;
+    float nearest_w = INFINITY;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        vec4_t point = {
+            corner & 1 ? max.x : min.x,
+            corner & 2 ? max.y : min.y,
+            corner & 4 ? max.z : min.z,
+            1.0f
+        };
+        point = clip_matrix.mul_vec4(point);
+        if (point.z < 0.0f)
+        {
+            return false; // Reaches past the near plane, cannot be rejected
+        }
+
+        // Same mapping as the vertex stage, in occlusion pixels
+        float x = (point.x / point.w) * (buffer.width / 2.0f) +
+                  buffer.width / 2.0f;
+        float y = -(point.y / point.w) * (buffer.height / 2.0f) +
+                  buffer.height / 2.0f;
+        min_x = std::min(min_x, x);
+        min_y = std::min(min_y, y);
+        max_x = std::max(max_x, x);
+        max_y = std::max(max_y, y);
+        nearest_w = std::min(nearest_w, point.w);
+    }
+
+    // Grown by a pixel for the sampling of the occluders
+    int first_x = std::max((int)floorf(min_x) - 1, 0);
+    int first_y = std::max((int)floorf(min_y) - 1, 0);
+    int last_x = std::min((int)ceilf(max_x) + 1, (int)buffer.width - 1);
+    int last_y = std::min((int)ceilf(max_y) + 1, (int)buffer.height - 1);
+    float nearest = 1.0f - 1.0f / nearest_w;
+    for (int y = first_y; y <= last_y; ++y)
+    {
+        const float* depth = buffer.depth.data() + buffer.width * y;
+        for (int x = first_x; x <= last_x; ++x)
+        {
+            if (!(depth[x] < nearest))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool occlusion_test_box(const occlusion_buffer_t& buffer,
+                        const mat4_t& world_matrix, const vec3_t& min,
+                        const vec3_t& max)
+{
+    return test_corners(buffer, buffer.projection_matrix.mul_mat4(world_matrix),
+                        min, max);
+}
+
+bool occlusion_test_sphere(const occlusion_buffer_t& buffer,
+                           const vec3_t& center, float radius)
+{
+    vec3_t extent = { radius, radius, radius };
+    return test_corners(buffer, buffer.projection_matrix, center - extent,
+                        center + extent);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "matrix.h"
+#include "triangle.h"
+#include "vector.h"
+
+#include <cstdint>
+#include <vector>
+
+#define OCCLUSION_WIDTH  256
+#define OCCLUSION_HEIGHT 128
+
+/*******************************************************************************
+ * Structures
+*******************************************************************************/
+// Low resolution depth of the occluders, stored as 1 - 1/w. Never clamped, so
+// the order holds for any w > 0.
+struct occlusion_buffer_t
+{
+    uint32_t           width  = OCCLUSION_WIDTH;
+    uint32_t           height = OCCLUSION_HEIGHT;
+    float              scale_x = 0.0f; // Screen to occlusion pixels
+    float              scale_y = 0.0f;
+    mat4_t             projection_matrix = mat4_identity();
+    std::vector<float> depth;
+};
+
+/*******************************************************************************
+ * Occlusion Culling
+********************************************************************************
+** Large occluders are drawn first into a small depth buffer, depth only: the
+** edge functions come from raster_setup_triangle() and every pixel keeps the
+** farthest depth the triangle reaches around its sample. Bounds are then
+** projected, and rejected when the nearest point of the bounds is behind
+** every occluder pixel of their screen rectangle, grown by one pixel.
+**
+** Occluder coverage is sampled at pixel centers: geometry only visible
+** through cracks thinner than an occlusion pixel may be culled.
+*******************************************************************************/
+// Empties the buffer for a view of 'screen_width' x 'screen_height' pixels
+void occlusion_clear(occlusion_buffer_t& buffer, float screen_width,
+                     float screen_height, const mat4_t& projection_matrix);
+// Screen space triangles, as the geometry stage produces them
+void occlusion_draw_triangles(occlusion_buffer_t& buffer,
+                              const std::vector<triangle_t>& triangles);
+
+// True when the object space box placed with 'world_matrix' is hidden
+bool occlusion_test_box(const occlusion_buffer_t& buffer,
+                        const mat4_t& world_matrix, const vec3_t& min,
+                        const vec3_t& max);
+// True when the world space sphere is hidden
+bool occlusion_test_sphere(const occlusion_buffer_t& buffer,
+                           const vec3_t& center, float radius);
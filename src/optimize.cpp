@@ -0,0 +1,401 @@
+#include "optimize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/*******************************************************************************
+ * Vertex cache
+********************************************************************************
+** Tom Forsyth, "Linear-Speed Vertex Cache Optimisation". A vertex scores by
+** its position in the cache and by how many faces still use it, a face by the
+** sum of its corners. The best face among those of the cached vertices comes
+** next, the next face in order when none is left.
+*******************************************************************************/
+static float vertex_score(int cache_position, uint32_t remaining)
+{
+    if (remaining == 0)
+    {
+        return -1.0f; // Nothing left to draw with it
+    }
+
+    float score = 0.0f;
+    if (cache_position >= 0)
+    {
+        if (cache_position < 3)
+        {
+            // Used by the last face: same score, whatever the corner
+            score = 0.75f;
+        }
+        else
+        {
+            float scale = 1.0f / (VERTEX_CACHE_SIZE - 3);
+            score = powf(1.0f - (cache_position - 3) * scale, 1.5f);
+        }
+    }
+    return score + 2.0f / sqrtf((float)remaining);
+}
+
+// Reorders faces [first, last)
+static void order_for_vertex_cache(std::vector<face_t>& faces, uint32_t first,
+                                   uint32_t last)
+{
+    uint32_t face_count = last - first;
+
+    // Local vertex numbers
+    std::vector<uint32_t> vertices;
+    vertices.reserve(face_count * 3);
+    for (uint32_t face = first; face < last; ++face)
+    {
+        for (int index : faces[face].data)
+        {
+            vertices.push_back((uint32_t)(index - 1));
+        }
+    }
+    std::sort(vertices.begin(), vertices.end());
+    vertices.erase(std::unique(vertices.begin(), vertices.end()),
+                   vertices.end());
+    uint32_t vertex_count = (uint32_t)vertices.size();
+
+    std::vector<uint32_t> corners(face_count * 3);
+    std::vector<uint32_t> remaining(vertex_count, 0);
+    for (uint32_t face = 0; face < face_count; ++face)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            uint32_t index = (uint32_t)(faces[first + face].data[i] - 1);
+            uint32_t v = (uint32_t)(std::lower_bound(vertices.begin(),
+                                                     vertices.end(), index) -
+                                    vertices.begin());
+            corners[face * 3 + i] = v;
+            ++remaining[v];
+        }
+    }
+
+    // Faces of each vertex, packed
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (uint32_t v = 0; v < vertex_count; ++v)
+    {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+    std::vector<uint32_t> vertex_faces(face_count * 3);
+    std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+    for (uint32_t face = 0; face < face_count; ++face)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            vertex_faces[filled[corners[face * 3 + i]]++] = face;
+        }
+    }
+
+    std::vector<int> cache_positions(vertex_count, -1);
+    std::vector<float> vertex_scores(vertex_count);
+    for (uint32_t v = 0; v < vertex_count; ++v)
+    {
+        vertex_scores[v] = vertex_score(-1, remaining[v]);
+    }
+    std::vector<float> face_scores(face_count);
+    std::vector<uint8_t> emitted(face_count, 0);
+    uint32_t best = 0;
+    for (uint32_t face = 0; face < face_count; ++face)
+    {
+        const uint32_t* face_corners = &corners[face * 3];
+        face_scores[face] = vertex_scores[face_corners[0]] +
+                            vertex_scores[face_corners[1]] +
+                            vertex_scores[face_corners[2]];
+        if (face_scores[face] > face_scores[best])
+        {
+            best = face;
+        }
+    }
+
+    std::vector<face_t> ordered;
+    ordered.reserve(face_count);
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> next_cache;
+    uint32_t cursor = 0;
+    while (true)
+    {
+        emitted[best] = 1;
+        ordered.push_back(faces[first + best]);
+        if (ordered.size() == face_count)
+        {
+            break;
+        }
+
+        // The corners move to the front, the oldest entries fall out
+        const uint32_t* best_corners = &corners[best * 3];
+        next_cache.assign(best_corners, best_corners + 3);
+        for (int i = 0; i < 3; ++i)
+        {
+            --remaining[best_corners[i]];
+        }
+        for (uint32_t v : cache)
+        {
+            if (v != best_corners[0] && v != best_corners[1] &&
+                v != best_corners[2])
+            {
+                next_cache.push_back(v);
+            }
+        }
+        for (size_t i = 0; i < next_cache.size(); ++i)
+        {
+            cache_positions[next_cache[i]] = i < VERTEX_CACHE_SIZE ? (int)i
+                                                                   : -1;
+        }
+
+        // New scores around every vertex that moved, the best face among them
+        float best_score = -1.0f;
+        for (uint32_t v : next_cache)
+        {
+            vertex_scores[v] = vertex_score(cache_positions[v], remaining[v]);
+        }
+        for (uint32_t v : next_cache)
+        {
+            for (uint32_t i = offsets[v]; i < offsets[v + 1]; ++i)
+            {
+                uint32_t face = vertex_faces[i];
+                if (emitted[face])
+                {
+                    continue;
+                }
+                const uint32_t* face_corners = &corners[face * 3];
+                face_scores[face] = vertex_scores[face_corners[0]] +
+                                    vertex_scores[face_corners[1]] +
+                                    vertex_scores[face_corners[2]];
+                if (face_scores[face] > best_score)
+                {
+                    best_score = face_scores[face];
+                    best = face;
+                }
+            }
+        }
+        if (next_cache.size() > VERTEX_CACHE_SIZE)
+        {
+            next_cache.resize(VERTEX_CACHE_SIZE);
+        }
+        std::swap(cache, next_cache);
+
+        if (best_score < 0.0f)
+        {
+            // Nothing left around the cache: the next face in order
+            while (emitted[cursor])
+            {
+                ++cursor;
+            }
+            best = cursor;
+        }
+    }
+    std::copy(ordered.begin(), ordered.end(), faces.begin() + first);
+}
+
+/*******************************************************************************
+ * Overdraw
+********************************************************************************
+** Sander, Nehab & Barczak, "Fast Triangle Reordering for Vertex Locality and
+** Reduced Overdraw": clusters further out along their own normal, measured
+** from the center of the mesh, are drawn first.
+*******************************************************************************/
+struct face_cluster_t
+{
+    uint32_t first_face;
+    uint32_t face_count;
+    float    key;
+    uint32_t meshlet; // Or UINT32_MAX
+};
+
+static vec3_t face_centroid(const mesh_t& in_mesh, const face_t& face)
+{
+    return (mesh_position(in_mesh, face.a - 1) +
+            mesh_position(in_mesh, face.b - 1) +
+            mesh_position(in_mesh, face.c - 1)) / 3.0f;
+}
+
+static void order_for_overdraw(mesh_t& out_mesh,
+                               std::vector<face_cluster_t>& clusters)
+{
+    // Area weighted center of the surface, the raw normals being twice the
+    // face areas
+    vec3_t center = { 0.0f, 0.0f, 0.0f };
+    float area = 0.0f;
+    for (size_t i = 0; i < out_mesh.faces.size(); ++i)
+    {
+        float face_area = out_mesh.face_normals[i].length();
+        center = center + face_centroid(out_mesh, out_mesh.faces[i]) *
+                              face_area;
+        area += face_area;
+    }
+    if (area > 0.0f)
+    {
+        center = center / area;
+    }
+
+    for (face_cluster_t& cluster : clusters)
+    {
+        vec3_t cluster_center = { 0.0f, 0.0f, 0.0f };
+        vec3_t normal = { 0.0f, 0.0f, 0.0f };
+        float cluster_area = 0.0f;
+        for (uint32_t i = cluster.first_face;
+             i < cluster.first_face + cluster.face_count; ++i)
+        {
+            float face_area = out_mesh.face_normals[i].length();
+            cluster_center = cluster_center +
+                face_centroid(out_mesh, out_mesh.faces[i]) * face_area;
+            cluster_area += face_area;
+            normal = normal + out_mesh.face_normals[i];
+        }
+        cluster.key = -INFINITY; // Degenerate clusters last
+        float normal_length = normal.length();
+        if (cluster_area > 0.0f && normal_length > 0.0f)
+        {
+            cluster.key = (cluster_center / cluster_area - center)
+                              .dot_product(normal / normal_length);
+        }
+    }
+    std::stable_sort(clusters.begin(), clusters.end(),
+                     [](const face_cluster_t& a, const face_cluster_t& b) {
+                         return a.key > b.key;
+                     });
+
+    std::vector<face_t> faces;
+    faces.reserve(out_mesh.faces.size());
+    for (const face_cluster_t& cluster : clusters)
+    {
+        if (cluster.meshlet != UINT32_MAX)
+        {
+            out_mesh.meshlets[cluster.meshlet].first_face =
+                (uint32_t)faces.size();
+        }
+        faces.insert(faces.end(),
+                     out_mesh.faces.begin() + cluster.first_face,
+                     out_mesh.faces.begin() + cluster.first_face +
+                         cluster.face_count);
+    }
+    out_mesh.faces = std::move(faces);
+
+    // Meshlets in face order
+    std::sort(out_mesh.meshlets.begin(), out_mesh.meshlets.end(),
+              [](const meshlet_t& a, const meshlet_t& b) {
+                  return a.first_face < b.first_face;
+              });
+}
+
+/*******************************************************************************
+ * Vertex order
+*******************************************************************************/
+static void order_vertices(mesh_t& out_mesh)
+{
+    uint32_t vertex_count = mesh_vertex_count(out_mesh);
+    std::vector<uint32_t> remap(vertex_count, UINT32_MAX);
+    std::vector<uint32_t> order;
+    order.reserve(vertex_count);
+    for (face_t& face : out_mesh.faces)
+    {
+        for (int& index : face.data)
+        {
+            uint32_t v = (uint32_t)(index - 1);
+            if (remap[v] == UINT32_MAX)
+            {
+                remap[v] = (uint32_t)order.size();
+                order.push_back(v);
+            }
+            index = (int)remap[v] + 1;
+        }
+    }
+    // Unused vertices stay, at the end
+    for (uint32_t v = 0; v < vertex_count; ++v)
+    {
+        if (remap[v] == UINT32_MAX)
+        {
+            order.push_back(v);
+        }
+    }
+
+    if (!out_mesh.vertices.empty())
+    {
+        std::vector<vec3_t> vertices(vertex_count);
+        for (uint32_t i = 0; i < vertex_count; ++i)
+        {
+            vertices[i] = out_mesh.vertices[order[i]];
+        }
+        out_mesh.vertices = std::move(vertices);
+        return;
+    }
+    for (std::vector<float>& stream : out_mesh.positions)
+    {
+        std::vector<float> positions(vertex_count);
+        for (uint32_t i = 0; i < vertex_count; ++i)
+        {
+            positions[i] = stream[order[i]];
+        }
+        stream = std::move(positions);
+    }
+}
+
+/*******************************************************************************
+ * Face Order
+*******************************************************************************/
+static void optimize_level(mesh_t& out_mesh)
+{
+    std::vector<face_cluster_t> clusters;
+    for (uint32_t i = 0; i < out_mesh.meshlets.size(); ++i)
+    {
+        const meshlet_t& meshlet = out_mesh.meshlets[i];
+        clusters.push_back({ meshlet.first_face, meshlet.face_count, 0.0f, i });
+    }
+    for (const face_cluster_t& cluster : clusters)
+    {
+        order_for_vertex_cache(out_mesh.faces, cluster.first_face,
+                               cluster.first_face + cluster.face_count);
+    }
+    if (clusters.empty())
+    {
+        // The whole mesh at once, then cut in runs along the new order
+        uint32_t face_count = (uint32_t)out_mesh.faces.size();
+        order_for_vertex_cache(out_mesh.faces, 0, face_count);
+        for (uint32_t first = 0; first < face_count; first += MESHLET_MAX_FACES)
+        {
+            uint32_t count = std::min<uint32_t>(MESHLET_MAX_FACES,
+                                                face_count - first);
+            clusters.push_back({ first, count, 0.0f, UINT32_MAX });
+        }
+    }
+    mesh_compute_face_planes(out_mesh);
+    order_for_overdraw(out_mesh, clusters);
+    order_vertices(out_mesh);
+    mesh_compute_face_planes(out_mesh);
+}
+
+void mesh_optimize_faces(mesh_t& out_mesh)
+{
+    optimize_level(out_mesh);
+    for (mesh_t& level : out_mesh.lods)
+    {
+        optimize_level(level);
+    }
+}
+
+float mesh_cache_miss_ratio(const mesh_t& in_mesh, uint32_t cache_size)
+{
+    if (in_mesh.faces.empty())
+    {
+        return 0.0f;
+    }
+
+    // FIFO: a vertex entered at 'time' is still cached until cache_size more
+    // vertices came in
+    std::vector<uint64_t> entered(mesh_vertex_count(in_mesh), UINT64_MAX);
+    uint64_t misses = 0;
+    for (const face_t& face : in_mesh.faces)
+    {
+        for (int index : face.data)
+        {
+            uint64_t& time = entered[index - 1];
+            if (time == UINT64_MAX || misses - time >= cache_size)
+            {
+                time = misses++;
+            }
+        }
+    }
+    return (float)misses / (float)in_mesh.faces.size();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <cstdint>
+
+// Entries of the simulated post-transform cache the faces are ordered for
+#define VERTEX_CACHE_SIZE 32
+
+/*******************************************************************************
+ * Face Order
+********************************************************************************
+** An optional pass after loading, reordering faces and vertices without
+** changing what is drawn:
+** 1. Vertex cache: inside each meshlet, faces are picked one by one by the
+**    Forsyth score, favouring vertices used recently and vertices with few
+**    faces left, so consecutive faces share their corners.
+** 2. Overdraw: meshlets are sorted so the ones on the outside of the mesh,
+**    facing out, come first. They tend to hide the others, whose pixels then
+**    fail the depth test early.
+** 3. Vertices are renumbered in the order the faces first use them, so the
+**    fetches walk the vertex streams forward.
+** Without meshlets, the whole mesh is ordered for the vertex cache, then cut
+** in runs of MESHLET_MAX_FACES faces sorted for overdraw. The LOD levels are
+** reordered too. Only faces drawn at the same depth may come
+** out in another order.
+*******************************************************************************/
+void mesh_optimize_faces(mesh_t& out_mesh);
+
+// Vertices transformed per face with a FIFO cache of 'cache_size' entries.
+// 3 without any reuse, about 0.5 at best on large regular meshes.
+float mesh_cache_miss_ratio(const mesh_t& in_mesh, uint32_t cache_size);
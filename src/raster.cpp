@@ -0,0 +1,499 @@
+#include "raster.h"
+#include "raster_pipeline.h"
+#include "swap.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+/*******************************************************************************
+ * Edge setup
+********************************************************************************
+** E(p) = (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x)
+**
+** With the triangle wound so that its area is positive, a pixel is inside when
+** the three edge functions are positive. Pixels lying exactly on an edge are
+** only kept for top and left edges (top-left fill rule), so two triangles
+** sharing an edge never both write the same pixel.
+*******************************************************************************/
+static edge_t make_edge(int ax, int ay, int bx, int by, int origin_x,
+                        int origin_y)
+{
+    int64_t dx = bx - ax;
+    int64_t dy = by - ay;
+
+    edge_t edge = {};
+    edge.step_x = -dy;
+    edge.step_y = dx;
+    edge.origin = dx * (origin_y - ay) - dy * (origin_x - ax);
+
+    bool is_top_left = (dy < 0) || (dy == 0 && dx > 0);
+    if (!is_top_left)
+    {
+        edge.origin -= 1;
+    }
+    return edge;
+}
+
+static plane_t make_plane(const edge_t edges[3], const int64_t unbiased[3],
+                          float inv_area, float f0, float f1, float f2)
+{
+    // Edge 0 is opposite vertex 0, edge 1 opposite vertex 1, ...
+    plane_t plane = {};
+    plane.step_x = (f0 * edges[0].step_x + f1 * edges[1].step_x +
+                    f2 * edges[2].step_x) * inv_area;
+    plane.step_y = (f0 * edges[0].step_y + f1 * edges[1].step_y +
+                    f2 * edges[2].step_y) * inv_area;
+    plane.origin = (f0 * unbiased[0] + f1 * unbiased[1] +
+                    f2 * unbiased[2]) * inv_area;
+    return plane;
+}
+
+bool raster_setup_triangle(raster_triangle_t& out_triangle,
+                           const ColorBuffer& color_buffer,
+                           const vec4_t points[3], const tex2_t texcoords[3])
+{
+    int x[3] = { (int)points[0].x, (int)points[1].x, (int)points[2].x };
+    int y[3] = { (int)points[0].y, (int)points[1].y, (int)points[2].y };
+    float w[3] = { points[0].w, points[1].w, points[2].w };
+    tex2_t uv[3] = { texcoords[0], texcoords[1], texcoords[2] };
+
+    int64_t area = (int64_t)(x[1] - x[0]) * (y[2] - y[0]) -
+                   (int64_t)(y[1] - y[0]) * (x[2] - x[0]);
+    if (area == 0)
+    {
+        return false; // Degenerate, covers no pixel
+    }
+    if (area < 0)
+    {
+        // Flip the winding so 'inside' always means positive edge values
+        int_swap(x[1], x[2]);
+        int_swap(y[1], y[2]);
+        float_swap(w[1], w[2]);
+        float_swap(uv[1].u, uv[2].u);
+        float_swap(uv[1].v, uv[2].v);
+        area = -area;
+    }
+
+    // Bounding box, clamped once to the scissor so the pixel loops never
+    // have to check bounds
+    rect_t scissor = scissor_rect(color_buffer);
+    int min_x = std::min(x[0], std::min(x[1], x[2]));
+    int min_y = std::min(y[0], std::min(y[1], y[2]));
+    int max_x = std::max(x[0], std::max(x[1], x[2]));
+    int max_y = std::max(y[0], std::max(y[1], y[2]));
+    min_x = std::max(min_x, scissor.min_x);
+    min_y = std::max(min_y, scissor.min_y);
+    max_x = std::min(max_x, scissor.max_x);
+    max_y = std::min(max_y, scissor.max_y);
+    if (min_x > max_x || min_y > max_y)
+    {
+        return false; // Entirely outside the scissor
+    }
+
+    out_triangle.min_x = min_x;
+    out_triangle.min_y = min_y;
+    out_triangle.max_x = max_x;
+    out_triangle.max_y = max_y;
+
+    out_triangle.edges[0] = make_edge(x[1], y[1], x[2], y[2], min_x, min_y);
+    out_triangle.edges[1] = make_edge(x[2], y[2], x[0], y[0], min_x, min_y);
+    out_triangle.edges[2] = make_edge(x[0], y[0], x[1], y[1], min_x, min_y);
+
+    // Interpolation must use the edge values without the fill-rule bias
+    int64_t unbiased[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        const edge_t& edge = out_triangle.edges[i];
+        unbiased[i] = edge.step_y * (min_y - y[(i + 1) % 3]) +
+                      edge.step_x * (min_x - x[(i + 1) % 3]);
+    }
+
+    float inv_area = 1.0f / (float)area;
+    float inv_w[3] = { 1.0f / w[0], 1.0f / w[1], 1.0f / w[2] };
+    out_triangle.reciprocal_w = make_plane(out_triangle.edges, unbiased,
+                                           inv_area,
+                                           inv_w[0], inv_w[1], inv_w[2]);
+    out_triangle.u_over_w = make_plane(out_triangle.edges, unbiased, inv_area,
+                                       uv[0].u * inv_w[0], uv[1].u * inv_w[1],
+                                       uv[2].u * inv_w[2]);
+    out_triangle.v_over_w = make_plane(out_triangle.edges, unbiased, inv_area,
+                                       uv[0].v * inv_w[0], uv[1].v * inv_w[1],
+                                       uv[2].v * inv_w[2]);
+
+    // Depth is affine in 1/w, so linear in screen space too, nearest at a
+    // vertex
+    float inv_near = 1.0f / color_buffer.depth_near;
+    float scale = 1.0f / (inv_near - 1.0f / color_buffer.depth_far);
+    float depth[3] = { (inv_near - inv_w[0]) * scale,
+                       (inv_near - inv_w[1]) * scale,
+                       (inv_near - inv_w[2]) * scale };
+    out_triangle.depth = make_plane(out_triangle.edges, unbiased, inv_area,
+                                    depth[0], depth[1], depth[2]);
+    out_triangle.min_depth = std::min(depth[0], std::min(depth[1], depth[2]));
+    return true;
+}
+
+/*******************************************************************************
+ * Scalar kernels
+*******************************************************************************/
+// True when 'depth' is nearer than pixel i of the span, which then stores it
+template <DEPTH_FORMAT FORMAT>
+static inline bool scalar_depth_test(const span_t& span, int i, float depth)
+{
+    typedef depth_traits_t<FORMAT> traits;
+    typename traits::value_t* stored = (typename traits::value_t*)span.depth;
+
+    if constexpr (FORMAT == DEPTH_FORMAT::FLOAT32)
+    {
+        if (!(depth < stored[i]))
+        {
+            return false;
+        }
+        stored[i] = depth;
+    }
+    else
+    {
+        float clamped = std::min(std::max(depth, 0.0f), 1.0f);
+        uint32_t value = (uint32_t)(clamped * (float)traits::max + 0.5f);
+        if (!(value < (stored[i] & traits::max)))
+        {
+            return false;
+        }
+        // Spare bits above the depth are kept
+        stored[i] = (typename traits::value_t)((stored[i] & ~traits::max) |
+                                               value);
+    }
+    return true;
+}
+
+struct scalar_kernels_t
+{
+    template <bool DEPTH_TEST, DEPTH_FORMAT FORMAT>
+    static void filled(const span_t& span, uint32_t color)
+    {
+        for (int i = 0; i < span.count; ++i)
+        {
+            if constexpr (DEPTH_TEST)
+            {
+                // Smaller is closer
+                float depth = span.z + (float)(span.first + i) * span.z_step;
+                if (!scalar_depth_test<FORMAT>(span, i, depth))
+                {
+                    continue;
+                }
+            }
+            span.color[i] = color;
+        }
+    }
+
+    template <bool DEPTH_TEST, DEPTH_FORMAT FORMAT, WRAP_MODE WRAP>
+    static void textured(const span_t& span, const sampler_t& sampler)
+    {
+        for (int i = 0; i < span.count; ++i)
+        {
+            float reciprocal_w = span.reciprocal_w +
+                                 (float)(span.first + i) * span.reciprocal_w_step;
+            if constexpr (DEPTH_TEST)
+            {
+                float depth = span.z + (float)(span.first + i) * span.z_step;
+                if (!scalar_depth_test<FORMAT>(span, i, depth))
+                {
+                    continue;
+                }
+            }
+
+            // Divide back by 1/w to undo the perspective
+            float w = 1.0f / reciprocal_w;
+            float u = (span.u_over_w + (float)(span.first + i) * span.u_over_w_step) * w;
+            float v = (span.v_over_w + (float)(span.first + i) * span.v_over_w_step) * w;
+            int tex_x = (int)(u * (float)sampler.width);
+            int tex_y = (int)(v * (float)sampler.height);
+            if constexpr (WRAP == WRAP_MODE::REPEAT)
+            {
+                tex_x = abs(tex_x) % sampler.width;
+                tex_y = abs(tex_y) % sampler.height;
+            }
+            else
+            {
+                tex_x = std::clamp(tex_x, 0, sampler.width - 1);
+                tex_y = std::clamp(tex_y, 0, sampler.height - 1);
+            }
+
+            span.color[i] = sampler.texels[(sampler.width * tex_y) + tex_x];
+        }
+    }
+};
+
+/*******************************************************************************
+ * Pipeline dispatch
+*******************************************************************************/
+static RASTER_ISA         current_isa = RASTER_ISA::SCALAR;
+static raster_pipelines_t pipelines   = {};
+
+static bool isa_supported(RASTER_ISA isa)
+{
+    switch (isa)
+    {
+        case RASTER_ISA::SCALAR: return true;
+#ifdef RASTER_AVX2
+        case RASTER_ISA::AVX2:   return SDL_HasAVX2();
+#endif
+        default:                 return false;
+    }
+}
+
+bool raster_set_isa(RASTER_ISA isa)
+{
+    if (!isa_supported(isa))
+    {
+        return false;
+    }
+
+    switch (isa)
+    {
+#ifdef RASTER_AVX2
+        case RASTER_ISA::AVX2:
+        {
+            raster_pipelines_avx2(pipelines);
+        } break;
+#endif
+        default:
+        {
+            make_pipelines<scalar_kernels_t>(pipelines);
+        } break;
+    }
+    current_isa = isa;
+    return true;
+}
+
+RASTER_ISA raster_get_isa(void)
+{
+    return current_isa;
+}
+
+// Pick the widest kernels the CPU runs, once at startup
+static const bool isa_selected = raster_set_isa(RASTER_ISA::AVX2) ||
+                                 raster_set_isa(RASTER_ISA::SCALAR);
+
+raster_pipeline_fn raster_select_pipeline(const pipeline_state_t& state,
+                                          DEPTH_FORMAT depth_format)
+{
+    return pipelines.pipelines[(int)state.render_mode][state.depth_test]
+                              [(int)depth_format][(int)state.wrap_mode];
+}
+
+/*******************************************************************************
+ * Hierarchical Z
+********************************************************************************
+** Before any pixel work, the blocks under the triangle whose farthest stored
+** depth is already nearer than the triangle's nearest point are rejected, and
+** the area to rasterize shrinks to the blocks left. After drawing, blocks the
+** triangle covered completely get their farthest depth recomputed.
+*******************************************************************************/
+// Margin so interpolation rounding can never make a rejected pixel visible
+#define HIZ_EPSILON 1e-5f
+
+static bool triangle_region(const raster_triangle_t& triangle,
+                            const rect_t& bounds, rect_t& out_region)
+{
+    out_region.min_x = std::max(triangle.min_x, bounds.min_x);
+    out_region.min_y = std::max(triangle.min_y, bounds.min_y);
+    out_region.max_x = std::min(triangle.max_x, bounds.max_x);
+    out_region.max_y = std::min(triangle.max_y, bounds.max_y);
+    return out_region.min_x <= out_region.max_x &&
+           out_region.min_y <= out_region.max_y;
+}
+
+static bool hiz_cull(const ColorBuffer& color_buffer,
+                     const raster_triangle_t& triangle, rect_t& region)
+{
+    if (!hiz_buffer)
+    {
+        return true;
+    }
+
+    uint32_t blocks_per_row = hiz_width(color_buffer);
+    int min_block_x = INT_MAX;
+    int min_block_y = INT_MAX;
+    int max_block_x = INT_MIN;
+    int max_block_y = INT_MIN;
+    for (int block_y = region.min_y / HIZ_BLOCK_SIZE;
+         block_y <= region.max_y / HIZ_BLOCK_SIZE; ++block_y)
+    {
+        for (int block_x = region.min_x / HIZ_BLOCK_SIZE;
+             block_x <= region.max_x / HIZ_BLOCK_SIZE; ++block_x)
+        {
+            float farthest = hiz_buffer[blocks_per_row * block_y + block_x];
+            if (triangle.min_depth - HIZ_EPSILON < farthest)
+            {
+                min_block_x = std::min(min_block_x, block_x);
+                min_block_y = std::min(min_block_y, block_y);
+                max_block_x = std::max(max_block_x, block_x);
+                max_block_y = std::max(max_block_y, block_y);
+            }
+        }
+    }
+    if (min_block_x > max_block_x)
+    {
+        return false; // Hidden everywhere
+    }
+
+    region.min_x = std::max(region.min_x, min_block_x * HIZ_BLOCK_SIZE);
+    region.min_y = std::max(region.min_y, min_block_y * HIZ_BLOCK_SIZE);
+    region.max_x = std::min(region.max_x,
+                            (max_block_x + 1) * HIZ_BLOCK_SIZE - 1);
+    region.max_y = std::min(region.max_y,
+                            (max_block_y + 1) * HIZ_BLOCK_SIZE - 1);
+    return true;
+}
+
+static bool covers_pixel(const raster_triangle_t& triangle, int x, int y)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        const edge_t& edge = triangle.edges[i];
+        if (edge.origin + edge.step_x * (x - triangle.min_x) +
+            edge.step_y * (y - triangle.min_y) < 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Farthest depth stored in a rectangle of z_buffer, as a float
+template <DEPTH_FORMAT FORMAT>
+static float block_farthest(const ColorBuffer& color_buffer, int x0, int y0,
+                            int x1, int y1)
+{
+    typedef depth_traits_t<FORMAT> traits;
+    typename traits::value_t farthest = 0;
+    for (int y = y0; y <= y1; ++y)
+    {
+        // Rows of a hierarchical z block are contiguous in either layout, as
+        // HIZ_BLOCK_SIZE == FRAME_BLOCK_SIZE
+        const typename traits::value_t* depth =
+            (const typename traits::value_t*)z_buffer +
+            pixel_index(color_buffer, x0, y);
+        for (int x = 0; x <= x1 - x0; ++x)
+        {
+            if constexpr (FORMAT == DEPTH_FORMAT::FLOAT32)
+            {
+                farthest = std::max(farthest, depth[x]);
+            }
+            else
+            {
+                // Without the spare bits
+                farthest = std::max(farthest, (typename traits::value_t)(
+                                                  depth[x] & traits::max));
+            }
+        }
+    }
+
+    if constexpr (FORMAT == DEPTH_FORMAT::FLOAT32)
+    {
+        return farthest;
+    }
+    else
+    {
+        return (float)farthest / (float)traits::max;
+    }
+}
+
+void raster_hiz_update(const ColorBuffer& color_buffer,
+                       const raster_triangle_t& triangle,
+                       const rect_t& region)
+{
+    if (!hiz_buffer)
+    {
+        return;
+    }
+
+    uint32_t blocks_per_row = hiz_width(color_buffer);
+    for (int block_y = region.min_y / HIZ_BLOCK_SIZE;
+         block_y <= region.max_y / HIZ_BLOCK_SIZE; ++block_y)
+    {
+        for (int block_x = region.min_x / HIZ_BLOCK_SIZE;
+             block_x <= region.max_x / HIZ_BLOCK_SIZE; ++block_x)
+        {
+            // Block pixels that exist on screen, all drawn in this call
+            int x0 = block_x * HIZ_BLOCK_SIZE;
+            int y0 = block_y * HIZ_BLOCK_SIZE;
+            int x1 = std::min(x0 + HIZ_BLOCK_SIZE, (int)color_buffer.width) - 1;
+            int y1 = std::min(y0 + HIZ_BLOCK_SIZE, (int)color_buffer.height) - 1;
+            if (x0 < region.min_x || y0 < region.min_y ||
+                x1 > region.max_x || y1 > region.max_y)
+            {
+                continue;
+            }
+
+            // The triangle is convex: covering the corners covers the block
+            if (!covers_pixel(triangle, x0, y0) ||
+                !covers_pixel(triangle, x1, y0) ||
+                !covers_pixel(triangle, x0, y1) ||
+                !covers_pixel(triangle, x1, y1))
+            {
+                continue;
+            }
+
+            float farthest = 0.0f;
+            switch (color_buffer.depth_format)
+            {
+                case DEPTH_FORMAT::FLOAT32:
+                {
+                    farthest = block_farthest<DEPTH_FORMAT::FLOAT32>(
+                        color_buffer, x0, y0, x1, y1);
+                } break;
+                case DEPTH_FORMAT::UNORM24:
+                {
+                    farthest = block_farthest<DEPTH_FORMAT::UNORM24>(
+                        color_buffer, x0, y0, x1, y1);
+                } break;
+                case DEPTH_FORMAT::UNORM16:
+                {
+                    farthest = block_farthest<DEPTH_FORMAT::UNORM16>(
+                        color_buffer, x0, y0, x1, y1);
+                } break;
+            }
+            hiz_buffer[blocks_per_row * block_y + block_x] = farthest;
+        }
+    }
+}
+
+bool raster_region(const ColorBuffer& color_buffer,
+                   const raster_triangle_t& triangle, const rect_t& bounds,
+                   bool depth_test, rect_t& out_region)
+{
+    if (!triangle_region(triangle, bounds, out_region))
+    {
+        return false;
+    }
+    return !depth_test || hiz_cull(color_buffer, triangle, out_region);
+}
+
+/*******************************************************************************
+ * Flat shaded triangle
+*******************************************************************************/
+void raster_filled_triangle(ColorBuffer& color_buffer,
+                            const raster_triangle_t& triangle, uint32_t color,
+                            const rect_t& bounds)
+{
+    pipelines.filled[(int)color_buffer.depth_format](color_buffer, triangle,
+                                                     color, bounds);
+}
+
+/*******************************************************************************
+ * Perspective correct textured triangle
+*******************************************************************************/
+void raster_textured_triangle(ColorBuffer& color_buffer,
+                              const raster_triangle_t& triangle,
+                              const uint32_t* texture, const rect_t& bounds)
+{
+    sampler_t sampler = {};
+    sampler.texels = texture;
+    sampler.width = (int)texture_width;
+    sampler.height = (int)texture_height;
+    pipelines.textured[(int)color_buffer.depth_format](color_buffer, triangle,
+                                                       sampler, bounds);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "display.h"
+#include "raster_kernels.h"
+#include "vector.h"
+#include "texture.h"
+#include "triangle.h"
+
+#include <cstdint>
+
+/*******************************************************************************
+ * Structures
+*******************************************************************************/
+// Instruction set used by the pixel kernels, picked at startup from the CPU
+enum class RASTER_ISA
+{
+    SCALAR,
+    AVX2
+};
+
+// Edge function E(x, y) = step_x * x + step_y * y + c, stored as its value at
+// the bounding box origin so stepping to the next row only adds a constant.
+// A pixel is inside the edge when E >= 0 (fill-rule bias already applied).
+struct edge_t
+{
+    int64_t step_x = 0;
+    int64_t step_y = 0;
+    int64_t origin = 0;
+};
+
+// Attribute varying linearly in screen space (1/w, u/w, v/w, depth)
+struct plane_t
+{
+    float step_x = 0.0f;
+    float step_y = 0.0f;
+    float origin = 0.0f;
+};
+
+// Everything the pixel loops need, computed once per triangle
+struct raster_triangle_t
+{
+    edge_t  edges[3];
+    plane_t reciprocal_w;
+    plane_t u_over_w;
+    plane_t v_over_w;
+    plane_t depth;            // As stored, see DEPTH_FORMAT
+    float   min_depth = 0.0f; // Nearest depth reached by the triangle
+    int     min_x = 0;
+    int     min_y = 0;
+    int     max_x = -1;
+    int     max_y = -1;
+};
+
+// Everything a pixel pipeline is specialized on. Each combination is compiled
+// into its own loop, so none of it is tested per triangle or per pixel.
+struct pipeline_state_t
+{
+    RENDER_MODE render_mode = RENDER_MODE::FILLED_TRIANGLES;
+    bool        depth_test  = true;
+    WRAP_MODE   wrap_mode   = WRAP_MODE::REPEAT;
+};
+
+// Triangles drawn by one pipeline call
+struct raster_batch_t
+{
+    const triangle_t*        triangles = nullptr;
+    const raster_triangle_t* setups    = nullptr; // Read by filled modes only
+    const uint8_t*           covered   = nullptr; // setups[i] hits a pixel
+    const uint32_t*          indices   = nullptr; // Null: 0 .. count - 1
+    uint32_t                 count     = 0;
+    sampler_t                sampler;
+    rect_t                   bounds;              // Only pixels written
+};
+
+typedef void (*raster_pipeline_fn)(ColorBuffer& color_buffer,
+                                   const raster_batch_t& batch);
+
+/*******************************************************************************
+ * Rasterizer Functions
+*******************************************************************************/
+bool       raster_set_isa(RASTER_ISA isa); // false if the CPU lacks it
+RASTER_ISA raster_get_isa(void);
+
+// Pipeline for 'state' and z_buffer values in 'depth_format', on the current
+// instruction set. Pick it once per frame, it stays valid until the next
+// raster_set_isa().
+raster_pipeline_fn raster_select_pipeline(const pipeline_state_t& state,
+                                          DEPTH_FORMAT depth_format);
+
+bool raster_setup_triangle(raster_triangle_t& out_triangle,
+                           const ColorBuffer& color_buffer,
+                           const vec4_t points[3], const tex2_t texcoords[3]);
+// Only pixels inside 'bounds' are touched, so several threads can draw the
+// same triangle into disjoint parts of the color buffer
+void raster_filled_triangle(ColorBuffer& color_buffer,
+                            const raster_triangle_t& triangle, uint32_t color,
+                            const rect_t& bounds);
+void raster_textured_triangle(ColorBuffer& color_buffer,
+                              const raster_triangle_t& triangle,
+                              const uint32_t* texture, const rect_t& bounds);
@@ -0,0 +1,227 @@
+#include "raster_pipeline.h"
+
+// Built with AVX2 enabled (see src/CMakeLists.txt), only called after the
+// rasterizer checked the CPU supports it.
+#ifdef RASTER_AVX2
+#include <cstring>
+#include <immintrin.h>
+
+/*******************************************************************************
+ * Helpers
+*******************************************************************************/
+// Lanes still inside the span when 'remaining' pixels are left
+static inline __m256i active_lanes(int remaining)
+{
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(remaining), lane);
+}
+
+// start + index * step, same operation order as the scalar kernels so both
+// paths produce bit identical depth values
+static inline __m256 interpolate(float start, float step, __m256 index)
+{
+    return _mm256_add_ps(_mm256_set1_ps(start),
+                         _mm256_mul_ps(index, _mm256_set1_ps(step)));
+}
+
+// abs(value) % size for 0 < size, using float division (exact in the range of
+// texel coordinates we care about) and clamped so the gather stays in bounds
+static inline __m256i wrap_repeat(__m256i value, int size)
+{
+    const __m256i size_v = _mm256_set1_epi32(size);
+    const __m256i zero = _mm256_setzero_si256();
+    value = _mm256_abs_epi32(value);
+    __m256 quotient = _mm256_mul_ps(_mm256_cvtepi32_ps(value),
+                                    _mm256_set1_ps(1.0f / (float)size));
+    __m256i result = _mm256_sub_epi32(
+        value, _mm256_mullo_epi32(_mm256_cvttps_epi32(quotient), size_v));
+    // Quotient can be off by one either way
+    result = _mm256_add_epi32(result, _mm256_and_si256(
+        _mm256_cmpgt_epi32(zero, result), size_v));
+    result = _mm256_sub_epi32(result, _mm256_andnot_si256(
+        _mm256_cmpgt_epi32(size_v, result), size_v));
+    result = _mm256_max_epi32(result, zero);
+    return _mm256_min_epi32(result, _mm256_sub_epi32(size_v,
+                                                     _mm256_set1_epi32(1)));
+}
+
+// value clamped to [0, size - 1]
+static inline __m256i wrap_clamp(__m256i value, int size)
+{
+    value = _mm256_max_epi32(value, _mm256_setzero_si256());
+    return _mm256_min_epi32(value, _mm256_set1_epi32(size - 1));
+}
+
+template <WRAP_MODE WRAP>
+static inline __m256i wrap(__m256i value, int size)
+{
+    if constexpr (WRAP == WRAP_MODE::REPEAT)
+    {
+        return wrap_repeat(value, size);
+    }
+    else
+    {
+        return wrap_clamp(value, size);
+    }
+}
+
+// round(clamp(depth, 0, 1) * max), same operations as the scalar kernels
+static inline __m256i encode_unorm(__m256 depth, uint32_t max)
+{
+    __m256 clamped = _mm256_min_ps(_mm256_max_ps(depth, _mm256_setzero_ps()),
+                                   _mm256_set1_ps(1.0f));
+    return _mm256_cvttps_epi32(_mm256_add_ps(
+        _mm256_mul_ps(clamped, _mm256_set1_ps((float)max)),
+        _mm256_set1_ps(0.5f)));
+}
+
+// Lanes passing the depth test, also writing their depth
+template <DEPTH_FORMAT FORMAT>
+static inline __m256i depth_test(const span_t& span, int i, __m256i active,
+                                 __m256 index)
+{
+    // Smaller is closer
+    __m256 depth = interpolate(span.z, span.z_step, index);
+
+    if constexpr (FORMAT == DEPTH_FORMAT::FLOAT32)
+    {
+        float* stored_depth = (float*)span.depth + i;
+        __m256 stored = _mm256_maskload_ps(stored_depth, active);
+        __m256i pass = _mm256_and_si256(active, _mm256_castps_si256(
+            _mm256_cmp_ps(depth, stored, _CMP_LT_OQ)));
+        _mm256_maskstore_ps(stored_depth, pass, depth);
+        return pass;
+    }
+    else if constexpr (FORMAT == DEPTH_FORMAT::UNORM24)
+    {
+        const __m256i depth_bits = _mm256_set1_epi32(
+            (int)depth_traits_t<FORMAT>::max);
+        int* stored_depth = (int*)span.depth + i;
+        __m256i value = encode_unorm(depth, depth_traits_t<FORMAT>::max);
+        __m256i stored = _mm256_maskload_epi32(stored_depth, active);
+        __m256i pass = _mm256_and_si256(active, _mm256_cmpgt_epi32(
+            _mm256_and_si256(stored, depth_bits), value));
+
+        // Spare bits above the depth are kept
+        __m256i packed = _mm256_or_si256(
+            _mm256_andnot_si256(depth_bits, stored), value);
+        _mm256_maskstore_epi32(stored_depth, pass, packed);
+        return pass;
+    }
+    else
+    {
+        // No masked 16-bit loads: whole groups go straight to memory, the
+        // last partial one through a copy
+        uint16_t* stored_depth = (uint16_t*)span.depth + i;
+        int count = span.count - i < 8 ? span.count - i : 8;
+        __m128i stored16 = _mm_setzero_si128();
+        if (count == 8)
+        {
+            stored16 = _mm_loadu_si128((const __m128i*)stored_depth);
+        }
+        else
+        {
+            memcpy(&stored16, stored_depth, count * sizeof(uint16_t));
+        }
+
+        __m256i value = encode_unorm(depth, depth_traits_t<FORMAT>::max);
+        __m256i stored = _mm256_cvtepu16_epi32(stored16);
+        __m256i pass = _mm256_and_si256(active,
+                                        _mm256_cmpgt_epi32(stored, value));
+
+        // Lanes failing the test write back what they read
+        __m256i merged = _mm256_blendv_epi8(stored, value, pass);
+        __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(merged),
+                                          _mm256_extracti128_si256(merged, 1));
+        if (count == 8)
+        {
+            _mm_storeu_si128((__m128i*)stored_depth, packed);
+        }
+        else
+        {
+            memcpy(stored_depth, &packed, count * sizeof(uint16_t));
+        }
+        return pass;
+    }
+}
+
+struct avx2_kernels_t
+{
+    /***************************************************************************
+     * Flat shaded span, 8 pixels per step
+    ***************************************************************************/
+    template <bool DEPTH_TEST, DEPTH_FORMAT FORMAT>
+    static void filled(const span_t& span, uint32_t color)
+    {
+        const __m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i fill = _mm256_set1_epi32((int)color);
+
+        for (int i = 0; i < span.count; i += 8)
+        {
+            __m256i pass = active_lanes(span.count - i);
+            if constexpr (DEPTH_TEST)
+            {
+                __m256 index = _mm256_add_ps(_mm256_set1_ps((float)(span.first + i)), lane);
+                pass = depth_test<FORMAT>(span, i, pass, index);
+            }
+            _mm256_maskstore_epi32((int*)(span.color + i), pass, fill);
+        }
+    }
+
+    /***************************************************************************
+     * Perspective correct textured span, 8 pixels per step
+    ***************************************************************************/
+    template <bool DEPTH_TEST, DEPTH_FORMAT FORMAT, WRAP_MODE WRAP>
+    static void textured(const span_t& span, const sampler_t& sampler)
+    {
+        const __m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 width = _mm256_set1_ps((float)sampler.width);
+        const __m256 height = _mm256_set1_ps((float)sampler.height);
+        const __m256i pitch = _mm256_set1_epi32(sampler.width);
+
+        for (int i = 0; i < span.count; i += 8)
+        {
+            __m256i pass = active_lanes(span.count - i);
+            __m256 index = _mm256_add_ps(_mm256_set1_ps((float)(span.first + i)), lane);
+            __m256 reciprocal_w = interpolate(span.reciprocal_w,
+                                              span.reciprocal_w_step, index);
+            if constexpr (DEPTH_TEST)
+            {
+                pass = depth_test<FORMAT>(span, i, pass, index);
+                if (_mm256_testz_si256(pass, pass))
+                {
+                    continue; // Whole group hidden, skip the texture fetch
+                }
+            }
+
+            // Divide back by 1/w to undo the perspective
+            __m256 w = _mm256_div_ps(one, reciprocal_w);
+            __m256 u = _mm256_mul_ps(interpolate(span.u_over_w,
+                                                 span.u_over_w_step, index), w);
+            __m256 v = _mm256_mul_ps(interpolate(span.v_over_w,
+                                                 span.v_over_w_step, index), w);
+            __m256i tex_x = wrap<WRAP>(
+                _mm256_cvttps_epi32(_mm256_mul_ps(u, width)), sampler.width);
+            __m256i tex_y = wrap<WRAP>(
+                _mm256_cvttps_epi32(_mm256_mul_ps(v, height)), sampler.height);
+
+            __m256i texel_index = _mm256_add_epi32(
+                _mm256_mullo_epi32(tex_y, pitch), tex_x);
+            __m256i texels = _mm256_mask_i32gather_epi32(
+                _mm256_setzero_si256(), (const int*)sampler.texels,
+                texel_index, pass, 4);
+
+            _mm256_maskstore_epi32((int*)(span.color + i), pass, texels);
+        }
+    }
+};
+
+/*******************************************************************************
+ * Pipeline table
+*******************************************************************************/
+void raster_pipelines_avx2(raster_pipelines_t& out_pipelines)
+{
+    make_pipelines<avx2_kernels_t>(out_pipelines);
+}
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+
+// Data handed to the pixel kernels by the scalar and SIMD rasterizer paths
+#include "display.h"
+
+#include <cstdint>
+
+/*******************************************************************************
+ * Structures
+*******************************************************************************/
+// A horizontal run of covered pixels, contiguous in memory. Every attribute is
+// given 'first' pixels left of the run and stepped by a constant per pixel to
+// the right, so pieces of one row interpolate exactly like the whole row.
+struct span_t
+{
+    uint32_t* color             = nullptr;
+    void*     depth             = nullptr; // In the pipeline's DEPTH_FORMAT
+    int       first             = 0;
+    int       count             = 0;
+    float     reciprocal_w      = 0.0f;
+    float     reciprocal_w_step = 0.0f;
+    float     u_over_w          = 0.0f;
+    float     u_over_w_step     = 0.0f;
+    float     v_over_w          = 0.0f;
+    float     v_over_w_step     = 0.0f;
+    float     z                 = 0.0f; // Depth to store, see DEPTH_FORMAT
+    float     z_step            = 0.0f;
+};
+
+struct sampler_t
+{
+    const uint32_t* texels = nullptr;
+    int             width  = 0;
+    int             height = 0;
+};
+
+// Storage of one z_buffer value. The unorm formats hold round(depth * max).
+template <DEPTH_FORMAT FORMAT>
+struct depth_traits_t;
+
+template <>
+struct depth_traits_t<DEPTH_FORMAT::FLOAT32>
+{
+    typedef float value_t;
+};
+
+template <>
+struct depth_traits_t<DEPTH_FORMAT::UNORM24>
+{
+    typedef uint32_t value_t;
+    static constexpr uint32_t max = 0x00FFFFFF; // Also masks the depth bits
+};
+
+template <>
+struct depth_traits_t<DEPTH_FORMAT::UNORM16>
+{
+    typedef uint16_t value_t;
+    static constexpr uint32_t max = 0xFFFF;
+};
@@ -0,0 +1,346 @@
+#pragma once
+
+// Pixel pipelines, compiled once per instruction set: raster.cpp includes this
+// with the scalar kernels, raster_avx2.cpp with the AVX2 ones.
+// Everything defined here is static and no inline STL code is used, so the
+// AVX2 build of a function can never be linked in place of the scalar one.
+#include "raster.h"
+
+/*******************************************************************************
+ * Structures
+*******************************************************************************/
+typedef void (*raster_filled_fn)(ColorBuffer& color_buffer,
+                                 const raster_triangle_t& triangle,
+                                 uint32_t color, const rect_t& bounds);
+typedef void (*raster_textured_fn)(ColorBuffer& color_buffer,
+                                   const raster_triangle_t& triangle,
+                                   const sampler_t& sampler,
+                                   const rect_t& bounds);
+
+// Every pipeline built for one instruction set
+struct raster_pipelines_t
+{
+    // [render mode][depth test][depth format][wrap mode]
+    raster_pipeline_fn pipelines[NUM_RENDER_MODES][2][NUM_DEPTH_FORMATS]
+                                [NUM_WRAP_MODES];
+    // Single triangles, depth tested and repeating the texture
+    raster_filled_fn   filled[NUM_DEPTH_FORMATS];
+    raster_textured_fn textured[NUM_DEPTH_FORMATS];
+};
+
+/*******************************************************************************
+ * Shared non-inline helpers (raster.cpp)
+*******************************************************************************/
+// Part of 'bounds' the triangle may cover, shrunk to the hierarchical z
+// blocks it is not hidden in when 'depth_test' is set. False if none is left.
+bool raster_region(const ColorBuffer& color_buffer,
+                   const raster_triangle_t& triangle, const rect_t& bounds,
+                   bool depth_test, rect_t& out_region);
+void raster_hiz_update(const ColorBuffer& color_buffer,
+                       const raster_triangle_t& triangle,
+                       const rect_t& region);
+
+#ifdef RASTER_AVX2
+void raster_pipelines_avx2(raster_pipelines_t& out_pipelines);
+#endif
+
+/*******************************************************************************
+ * Row walking
+********************************************************************************
+** For each row the three edge functions are linear in x, so the covered pixels
+** form one contiguous run that can be solved for directly instead of testing
+** every pixel of the bounding box.
+*******************************************************************************/
+static inline bool edge_row_extent(int64_t value, int64_t step, int64_t& first,
+                                   int64_t& last)
+{
+    // Smallest/biggest k in [first, last] with value + step * k >= 0
+    if (step > 0)
+    {
+        if (value < 0)
+        {
+            int64_t k = (-value + step - 1) / step;
+            first = k > first ? k : first;
+        }
+    }
+    else if (step < 0)
+    {
+        if (value < 0)
+        {
+            return false;
+        }
+        int64_t k = value / -step;
+        last = k < last ? k : last;
+    }
+    else if (value < 0)
+    {
+        return false;
+    }
+    return first <= last;
+}
+
+template <DEPTH_FORMAT FORMAT, typename SpanFunction>
+static inline void walk_rows(ColorBuffer& color_buffer,
+                             const raster_triangle_t& triangle,
+                             const rect_t& region, SpanFunction draw_span)
+{
+    // 'region' lies inside the triangle's bounding box
+    int start_y = region.min_y;
+    int end_y = region.max_y;
+    int64_t start_x = region.min_x - triangle.min_x;
+    int64_t end_x = region.max_x - triangle.min_x;
+
+    int64_t row_edges[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        row_edges[i] = triangle.edges[i].origin +
+                       triangle.edges[i].step_y * (start_y - triangle.min_y);
+    }
+
+    for (int y = start_y; y <= end_y; ++y)
+    {
+        int64_t first = start_x;
+        int64_t last = end_x;
+        bool covered =
+            edge_row_extent(row_edges[0], triangle.edges[0].step_x, first,
+                            last) &&
+            edge_row_extent(row_edges[1], triangle.edges[1].step_x, first,
+                            last) &&
+            edge_row_extent(row_edges[2], triangle.edges[2].step_x, first,
+                            last);
+
+        if (covered)
+        {
+            float dy = (float)(y - triangle.min_y);
+            float dx = (float)first;
+            int x = triangle.min_x + (int)first;
+            int end = triangle.min_x + (int)last;
+
+            span_t span = {};
+            span.reciprocal_w = triangle.reciprocal_w.origin +
+                                triangle.reciprocal_w.step_y * dy +
+                                triangle.reciprocal_w.step_x * dx;
+            span.reciprocal_w_step = triangle.reciprocal_w.step_x;
+            span.u_over_w = triangle.u_over_w.origin +
+                            triangle.u_over_w.step_y * dy +
+                            triangle.u_over_w.step_x * dx;
+            span.u_over_w_step = triangle.u_over_w.step_x;
+            span.v_over_w = triangle.v_over_w.origin +
+                            triangle.v_over_w.step_y * dy +
+                            triangle.v_over_w.step_x * dx;
+            span.v_over_w_step = triangle.v_over_w.step_x;
+            span.z = triangle.depth.origin + triangle.depth.step_y * dy +
+                     triangle.depth.step_x * dx;
+            span.z_step = triangle.depth.step_x;
+
+            // A TILED row is contiguous up to the next block edge only
+            int piece = color_buffer.layout == FRAME_LAYOUT::TILED
+                      ? FRAME_BLOCK_SIZE : (int)color_buffer.width;
+            while (x <= end)
+            {
+                int piece_end = x - x % piece + piece - 1;
+                uint32_t offset = pixel_index(color_buffer, x, y);
+                span.color = color_buffer.memory + offset;
+                span.depth =
+                    (typename depth_traits_t<FORMAT>::value_t*)z_buffer +
+                    offset;
+                span.count = (piece_end < end ? piece_end : end) - x + 1;
+                draw_span(span);
+                span.first += span.count;
+                x += span.count;
+            }
+        }
+
+        row_edges[0] += triangle.edges[0].step_y;
+        row_edges[1] += triangle.edges[1].step_y;
+        row_edges[2] += triangle.edges[2].step_y;
+    }
+}
+
+/*******************************************************************************
+ * Single triangles
+********************************************************************************
+** KERNELS provides the span loops for one instruction set:
+**     template <bool DEPTH_TEST, DEPTH_FORMAT FORMAT>
+**     static void filled(const span_t& span, uint32_t color);
+**     template <bool DEPTH_TEST, DEPTH_FORMAT FORMAT, WRAP_MODE WRAP>
+**     static void textured(const span_t& span, const sampler_t& sampler);
+** Without the depth test, pixels are always written and the z-buffer and
+** hierarchical z are left untouched.
+*******************************************************************************/
+template <typename KERNELS, bool DEPTH_TEST, DEPTH_FORMAT FORMAT>
+static void pipeline_filled(ColorBuffer& color_buffer,
+                            const raster_triangle_t& triangle, uint32_t color,
+                            const rect_t& bounds)
+{
+    rect_t region;
+    if (!raster_region(color_buffer, triangle, bounds, DEPTH_TEST, region))
+    {
+        return;
+    }
+
+    walk_rows<FORMAT>(color_buffer, triangle, region,
+                      [color](const span_t& span) {
+        KERNELS::template filled<DEPTH_TEST, FORMAT>(span, color);
+    });
+    if constexpr (DEPTH_TEST)
+    {
+        raster_hiz_update(color_buffer, triangle, region);
+    }
+}
+
+template <typename KERNELS, bool DEPTH_TEST, DEPTH_FORMAT FORMAT,
+          WRAP_MODE WRAP>
+static void pipeline_textured(ColorBuffer& color_buffer,
+                              const raster_triangle_t& triangle,
+                              const sampler_t& sampler, const rect_t& bounds)
+{
+    rect_t region;
+    if (!raster_region(color_buffer, triangle, bounds, DEPTH_TEST, region))
+    {
+        return;
+    }
+
+    walk_rows<FORMAT>(color_buffer, triangle, region,
+                      [&sampler](const span_t& span) {
+        KERNELS::template textured<DEPTH_TEST, FORMAT, WRAP>(span, sampler);
+    });
+    if constexpr (DEPTH_TEST)
+    {
+        raster_hiz_update(color_buffer, triangle, region);
+    }
+}
+
+/*******************************************************************************
+ * Triangle lists
+*******************************************************************************/
+template <RENDER_MODE MODE>
+struct render_mode_traits_t
+{
+    static constexpr bool flat =
+        MODE == RENDER_MODE::FILLED_TRIANGLES ||
+        MODE == RENDER_MODE::FILLED_TRIANGLES_AND_WIREFRAME;
+    static constexpr bool textured =
+        MODE == RENDER_MODE::TEXTURED_TRIANGLES ||
+        MODE == RENDER_MODE::TEXTURED_TRIANGLES_AND_WIREFRAME;
+    static constexpr bool lines =
+        MODE == RENDER_MODE::WIREFRAME_DOTS ||
+        MODE == RENDER_MODE::WIREFRAME_LINES ||
+        MODE == RENDER_MODE::FILLED_TRIANGLES_AND_WIREFRAME ||
+        MODE == RENDER_MODE::TEXTURED_TRIANGLES_AND_WIREFRAME;
+    static constexpr bool dots = MODE == RENDER_MODE::WIREFRAME_DOTS;
+};
+
+template <typename KERNELS, RENDER_MODE MODE, bool DEPTH_TEST,
+          DEPTH_FORMAT FORMAT, WRAP_MODE WRAP>
+static void pipeline_triangles(ColorBuffer& color_buffer,
+                               const raster_batch_t& batch)
+{
+    typedef render_mode_traits_t<MODE> mode;
+
+    for (uint32_t i = 0; i < batch.count; ++i)
+    {
+        uint32_t index = batch.indices ? batch.indices[i] : i;
+        const triangle_t& triangle = batch.triangles[index];
+
+        if constexpr (mode::flat)
+        {
+            if (batch.covered[index])
+            {
+                pipeline_filled<KERNELS, DEPTH_TEST, FORMAT>(
+                    color_buffer, batch.setups[index], triangle.color,
+                    batch.bounds);
+            }
+        }
+        if constexpr (mode::textured)
+        {
+            if (batch.covered[index])
+            {
+                pipeline_textured<KERNELS, DEPTH_TEST, FORMAT, WRAP>(
+                    color_buffer, batch.setups[index], batch.sampler,
+                    batch.bounds);
+            }
+        }
+
+        const vec4_t* points = triangle.points;
+        if constexpr (mode::lines)
+        {
+            draw_line(color_buffer, (int)points[0].x, (int)points[0].y,
+                      (int)points[1].x, (int)points[1].y, 0xFFFFFFFF,
+                      batch.bounds);
+            draw_line(color_buffer, (int)points[1].x, (int)points[1].y,
+                      (int)points[2].x, (int)points[2].y, 0xFFFFFFFF,
+                      batch.bounds);
+            draw_line(color_buffer, (int)points[2].x, (int)points[2].y,
+                      (int)points[0].x, (int)points[0].y, 0xFFFFFFFF,
+                      batch.bounds);
+        }
+        if constexpr (mode::dots)
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                draw_rect(color_buffer, (int)points[j].x, (int)points[j].y,
+                          3, 3, 0xFFFF0000, batch.bounds);
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * Pipeline table
+*******************************************************************************/
+template <typename KERNELS, RENDER_MODE MODE, bool DEPTH_TEST,
+          DEPTH_FORMAT FORMAT>
+static void make_wrap_pipelines(raster_pipelines_t& out_pipelines,
+                                DEPTH_FORMAT slot)
+{
+    raster_pipeline_fn* wraps =
+        out_pipelines.pipelines[(int)MODE][DEPTH_TEST][(int)slot];
+    wraps[(int)WRAP_MODE::REPEAT] = pipeline_triangles<KERNELS, MODE,
+        DEPTH_TEST, FORMAT, WRAP_MODE::REPEAT>;
+    wraps[(int)WRAP_MODE::CLAMP] = pipeline_triangles<KERNELS, MODE,
+        DEPTH_TEST, FORMAT, WRAP_MODE::CLAMP>;
+}
+
+template <typename KERNELS, RENDER_MODE MODE>
+static void make_mode_pipelines(raster_pipelines_t& out_pipelines)
+{
+    // Without the depth test the format is never read, share one build
+    for (int slot = 0; slot < NUM_DEPTH_FORMATS; ++slot)
+    {
+        make_wrap_pipelines<KERNELS, MODE, false, DEPTH_FORMAT::FLOAT32>(
+            out_pipelines, (DEPTH_FORMAT)slot);
+    }
+    make_wrap_pipelines<KERNELS, MODE, true, DEPTH_FORMAT::FLOAT32>(
+        out_pipelines, DEPTH_FORMAT::FLOAT32);
+    make_wrap_pipelines<KERNELS, MODE, true, DEPTH_FORMAT::UNORM24>(
+        out_pipelines, DEPTH_FORMAT::UNORM24);
+    make_wrap_pipelines<KERNELS, MODE, true, DEPTH_FORMAT::UNORM16>(
+        out_pipelines, DEPTH_FORMAT::UNORM16);
+}
+
+template <typename KERNELS, DEPTH_FORMAT FORMAT>
+static void make_triangle_pipelines(raster_pipelines_t& out_pipelines)
+{
+    out_pipelines.filled[(int)FORMAT] = pipeline_filled<KERNELS, true, FORMAT>;
+    out_pipelines.textured[(int)FORMAT] =
+        pipeline_textured<KERNELS, true, FORMAT, WRAP_MODE::REPEAT>;
+}
+
+template <typename KERNELS>
+static void make_pipelines(raster_pipelines_t& out_pipelines)
+{
+    make_mode_pipelines<KERNELS, RENDER_MODE::WIREFRAME_DOTS>(out_pipelines);
+    make_mode_pipelines<KERNELS, RENDER_MODE::WIREFRAME_LINES>(out_pipelines);
+    make_mode_pipelines<KERNELS, RENDER_MODE::FILLED_TRIANGLES>(out_pipelines);
+    make_mode_pipelines<KERNELS,
+        RENDER_MODE::FILLED_TRIANGLES_AND_WIREFRAME>(out_pipelines);
+    make_mode_pipelines<KERNELS,
+        RENDER_MODE::TEXTURED_TRIANGLES>(out_pipelines);
+    make_mode_pipelines<KERNELS,
+        RENDER_MODE::TEXTURED_TRIANGLES_AND_WIREFRAME>(out_pipelines);
+
+    make_triangle_pipelines<KERNELS, DEPTH_FORMAT::FLOAT32>(out_pipelines);
+    make_triangle_pipelines<KERNELS, DEPTH_FORMAT::UNORM24>(out_pipelines);
+    make_triangle_pipelines<KERNELS, DEPTH_FORMAT::UNORM16>(out_pipelines);
+}
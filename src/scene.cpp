@@ -0,0 +1,136 @@
+#include "scene.h"
+
+#include <cfloat>
+
+/*******************************************************************************
+ * Scene
+*******************************************************************************/
+mat4_t scene_object_world_matrix(const scene_object_t& object)
+{
+    mat4_t world_matrix = mat4_make_scale(object.scale.x, object.scale.y,
+                                          object.scale.z);
+    world_matrix = mat4_make_rotation_x(object.rotation.x).mul_mat4(
+        world_matrix);
+    world_matrix = mat4_make_rotation_y(object.rotation.y).mul_mat4(
+        world_matrix);
+    world_matrix = mat4_make_rotation_z(object.rotation.z).mul_mat4(
+        world_matrix);
+    return mat4_make_translation(object.translation.x, object.translation.y,
+                                 object.translation.z).mul_mat4(world_matrix);
+}
+
+// Radius in pixels of the object's bounding sphere, as seen from its center.
+// Objects reaching the camera plane get FLT_MAX, their finest level.
+static float object_pixel_radius(const mesh_t& object_mesh,
+                                 const mat4_t& world_matrix,
+                                 const mat4_t& projection_matrix, float height)
+{
+    vec3_t center = object_mesh.sphere_center;
+    vec4_t world_center = world_matrix.mul_vec4({ center.x, center.y, center.z,
+                                                  1.0f });
+    float w = projection_matrix.mul_vec4(world_center).w;
+    float radius = object_mesh.sphere_radius *
+                   mat4_max_axis_scale(world_matrix);
+    if (w <= radius)
+    {
+        return FLT_MAX;
+    }
+    return radius * projection_matrix.m[1][1] * height * 0.5f / w;
+}
+
+// Transforms and assembles one object. OUTSIDE when it was skipped, out of the
+// frustum or hidden.
+static FRUSTUM_TEST assemble_object(scene_t& scene,
+                                    const scene_object_t& object,
+                                    const geometry_view_t& view,
+                                    const frustum_t& frustum,
+                                    const mat4_t& projection_matrix,
+                                    const occlusion_buffer_t* occlusion,
+                                    std::vector<triangle_t>& out_triangles)
+{
+    const mesh_t& object_mesh = scene.meshes[object.mesh];
+    mat4_t world_matrix = scene_object_world_matrix(object);
+
+    // The level first: its vertices may leave the bounds of the full mesh, so
+    // culling tests the bounds of what is drawn
+    const mesh_t& level = scene.lod_selection
+        ? mesh_select_lod(object_mesh, object_pixel_radius(
+              object_mesh, world_matrix, projection_matrix, view.height))
+        : object_mesh;
+
+    FRUSTUM_TEST test = frustum_test_mesh(frustum, level, world_matrix);
+    if (test == FRUSTUM_TEST::OUTSIDE)
+    {
+        return test;
+    }
+    if (occlusion && !object.occluder &&
+        occlusion_test_box(*occlusion, world_matrix, level.bounds_min,
+                           level.bounds_max))
+    {
+        ++scene.objects_occluded;
+        return FRUSTUM_TEST::OUTSIDE;
+    }
+
+    // Vertex stage: every vertex once, then the faces assemble by index
+    transform_mesh(level, world_matrix, projection_matrix, view.width,
+                   view.height, scene.transformed);
+
+    geometry_view_t object_view = view;
+    object_view.world_matrix = world_matrix;
+    object_view.clipping = test == FRUSTUM_TEST::INTERSECTING;
+    object_view.frustum_culling = object_view.clipping;
+    object_view.frustum = frustum;
+    object_view.occlusion = occlusion;
+    assemble_triangles(scene.bins, level, scene.transformed, object_view,
+                       out_triangles);
+    return test;
+}
+
+void scene_assemble(scene_t& scene, const geometry_view_t& view,
+                    const mat4_t& projection_matrix,
+                    std::vector<triangle_t>& out_triangles)
+{
+    out_triangles.clear();
+    scene.objects_drawn = 0;
+    scene.objects_clipped = 0;
+    scene.objects_occluded = 0;
+    frustum_t frustum = make_frustum(projection_matrix);
+
+    // Occluders first, into the occlusion buffer
+    const occlusion_buffer_t* occlusion = nullptr;
+    if (scene.occlusion_culling)
+    {
+        scene.occluder_triangles.clear();
+        for (const scene_object_t& object : scene.objects)
+        {
+            if (object.occluder)
+            {
+                assemble_object(scene, object, view, frustum,
+                                projection_matrix, nullptr,
+                                scene.occluder_triangles);
+            }
+        }
+        if (!scene.occluder_triangles.empty())
+        {
+            occlusion_clear(scene.occlusion, view.width, view.height,
+                            projection_matrix);
+            occlusion_draw_triangles(scene.occlusion,
+                                     scene.occluder_triangles);
+            occlusion = &scene.occlusion;
+        }
+    }
+
+    for (const scene_object_t& object : scene.objects)
+    {
+        FRUSTUM_TEST test = assemble_object(scene, object, view, frustum,
+                                            projection_matrix, occlusion,
+                                            out_triangles);
+        if (test == FRUSTUM_TEST::OUTSIDE)
+        {
+            continue;
+        }
+
+        ++scene.objects_drawn;
+        scene.objects_clipped += test == FRUSTUM_TEST::INTERSECTING ? 1 : 0;
+    }
+}
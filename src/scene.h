@@ -0,0 +1,67 @@
+#pragma once
+
+#include "frustum.h"
+#include "geometry.h"
+#include "lod.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "occlusion.h"
+#include "triangle.h"
+#include "vector.h"
+
+#include <cstdint>
+#include <vector>
+
+/*******************************************************************************
+ * Structures
+*******************************************************************************/
+// An instance of one of the scene meshes
+struct scene_object_t
+{
+    uint32_t mesh        = 0; // Index into scene_t::meshes
+    vec3_t   rotation    = { 0.0f, 0.0f, 0.0f };
+    vec3_t   scale       = { 1.0f, 1.0f, 1.0f };
+    vec3_t   translation = { 0.0f, 0.0f, 0.0f };
+    bool     occluder    = false; // Drawn into the occlusion buffer first
+};
+
+struct scene_t
+{
+    std::vector<mesh_t>         meshes;
+    std::vector<scene_object_t> objects;
+
+    // Reused by each object in turn, and between frames
+    transformed_mesh_t          transformed;
+    geometry_bins_t             bins;
+    std::vector<triangle_t>     occluder_triangles;
+    occlusion_buffer_t          occlusion;
+    bool                        occlusion_culling = true;
+    bool                        lod_selection     = true;
+
+    // Last scene_assemble()
+    uint32_t                    objects_drawn   = 0; // Not outside
+    uint32_t                    objects_clipped = 0; // Intersecting
+    uint32_t                    objects_occluded = 0;
+};
+
+/*******************************************************************************
+ * Scene
+********************************************************************************
+** scene_assemble() replaces 'out_triangles' with the triangles of every
+** object, in object order. Objects outside the frustum are skipped before
+** their vertices are transformed, objects inside are not clipped.
+**
+** With occlusion culling, the occluder objects are assembled first and drawn
+** into the occlusion buffer. Other objects hidden behind them are skipped,
+** and so are the hidden meshlets of every object.
+** With LOD selection, an object is drawn with the level of its mesh that
+** suits its size on screen, see mesh_select_lod(). Culling uses the bounds of
+** that level.
+** 'view' gives the camera, light and viewport, its world matrix and clipping
+** are set per object.
+*******************************************************************************/
+// Scale, rotations around x, y then z, then translation
+mat4_t scene_object_world_matrix(const scene_object_t& object);
+void   scene_assemble(scene_t& scene, const geometry_view_t& view,
+                      const mat4_t& projection_matrix,
+                      std::vector<triangle_t>& out_triangles);
@@ -0,0 +1,151 @@
+#include "thread_pool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*******************************************************************************
+ * Structures
+*******************************************************************************/
+struct batch_t
+{
+    const std::function<void(uint32_t)>* job = nullptr;
+    uint32_t              count     = 0;
+    std::atomic<uint32_t> next      = 0;
+    std::atomic<uint32_t> completed = 0;
+};
+
+struct thread_pool_t
+{
+    std::vector<std::thread>             workers;
+    std::deque<std::shared_ptr<batch_t>> batches;
+    std::mutex                           mutex;
+    std::condition_variable              wake;
+    std::condition_variable              done;
+    bool                                 quit = false;
+
+    thread_pool_t();
+    ~thread_pool_t();
+};
+
+/*******************************************************************************
+ * Run jobs from a batch until none are left
+*******************************************************************************/
+static void run_batch(thread_pool_t& pool, batch_t& batch)
+{
+    uint32_t index = 0;
+    while ((index = batch.next.fetch_add(1)) < batch.count)
+    {
+        (*batch.job)(index);
+        if (batch.completed.fetch_add(1) + 1 == batch.count)
+        {
+            // Lock so the waiting caller cannot miss the notification
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            pool.done.notify_all();
+        }
+    }
+}
+
+static void worker_main(thread_pool_t& pool)
+{
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    while (true)
+    {
+        pool.wake.wait(lock, [&pool]() {
+            return pool.quit || !pool.batches.empty();
+        });
+        if (pool.quit)
+        {
+            return;
+        }
+
+        // Oldest batch first, so callers finish in the order they started
+        std::shared_ptr<batch_t> batch = pool.batches.front();
+        if (batch->next >= batch->count)
+        {
+            pool.batches.pop_front(); // Every job handed out already
+            continue;
+        }
+
+        lock.unlock();
+        run_batch(pool, *batch);
+        lock.lock();
+    }
+}
+
+thread_pool_t::thread_pool_t()
+{
+    uint32_t hardware_threads = std::thread::hardware_concurrency();
+    for (uint32_t i = 1; i < hardware_threads; ++i)
+    {
+        workers.emplace_back(worker_main, std::ref(*this));
+    }
+}
+
+thread_pool_t::~thread_pool_t()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+static thread_pool_t& get_pool()
+{
+    static thread_pool_t pool;
+    return pool;
+}
+
+/*******************************************************************************
+ * Parallel For
+*******************************************************************************/
+void parallel_for(uint32_t count, const std::function<void(uint32_t)>& job)
+{
+    thread_pool_t& pool = get_pool();
+    if (count <= 1 || pool.workers.empty())
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            job(i);
+        }
+        return;
+    }
+
+    std::shared_ptr<batch_t> batch = std::make_shared<batch_t>();
+    batch->job = &job;
+    batch->count = count;
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.batches.push_back(batch);
+    }
+    pool.wake.notify_all();
+
+    run_batch(pool, *batch);
+
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.done.wait(lock, [&batch]() {
+        return batch->completed == batch->count;
+    });
+    for (auto it = pool.batches.begin(); it != pool.batches.end(); ++it)
+    {
+        if (*it == batch)
+        {
+            pool.batches.erase(it);
+            break;
+        }
+    }
+}
+
+uint32_t thread_count(void)
+{
+    return (uint32_t)get_pool().workers.size() + 1;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+/*******************************************************************************
+ * Thread Pool Functions
+********************************************************************************
+** A single pool of worker threads (one per extra hardware thread) is started
+** on first use. parallel_for() may be called from any thread, including from
+** inside a job; the calling thread works on its own batch while it waits.
+*******************************************************************************/
+// Runs job(index) for every index in [0, count) and returns once all are done
+void     parallel_for(uint32_t count, const std::function<void(uint32_t)>& job);
+uint32_t thread_count(void); // Workers + the calling thread
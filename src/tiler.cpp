@@ -0,0 +1,312 @@
+#include "tiler.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+
+// Triangles set up per job in the setup stage
+#define SETUP_BATCH_SIZE 1024
+
+// tile_grid_t::clear_pending bits
+#define CLEAR_COLOR 1
+#define CLEAR_DEPTH 2
+
+/*******************************************************************************
+ * Render mode helpers
+*******************************************************************************/
+static bool has_fill(RENDER_MODE render_mode)
+{
+    return render_mode == RENDER_MODE::FILLED_TRIANGLES ||
+           render_mode == RENDER_MODE::FILLED_TRIANGLES_AND_WIREFRAME ||
+           render_mode == RENDER_MODE::TEXTURED_TRIANGLES ||
+           render_mode == RENDER_MODE::TEXTURED_TRIANGLES_AND_WIREFRAME;
+}
+
+static bool has_wireframe(RENDER_MODE render_mode)
+{
+    return render_mode == RENDER_MODE::WIREFRAME_DOTS ||
+           render_mode == RENDER_MODE::WIREFRAME_LINES ||
+           render_mode == RENDER_MODE::FILLED_TRIANGLES_AND_WIREFRAME ||
+           render_mode == RENDER_MODE::TEXTURED_TRIANGLES_AND_WIREFRAME;
+}
+
+static sampler_t texture_sampler(const uint32_t* texture)
+{
+    sampler_t sampler = {};
+    sampler.texels = texture;
+    sampler.width = (int)texture_width;
+    sampler.height = (int)texture_height;
+    return sampler;
+}
+
+/*******************************************************************************
+ * Serial rendering
+*******************************************************************************/
+void render_triangles(ColorBuffer& color_buffer,
+                      const std::vector<triangle_t>& triangles,
+                      const pipeline_state_t& state, const uint32_t* texture)
+{
+    uint32_t triangle_count = (uint32_t)triangles.size();
+    std::vector<raster_triangle_t> setups(triangle_count);
+    std::vector<uint8_t> covered(triangle_count, 0);
+    if (has_fill(state.render_mode))
+    {
+        for (uint32_t i = 0; i < triangle_count; ++i)
+        {
+            covered[i] = raster_setup_triangle(setups[i], color_buffer,
+                                               triangles[i].points,
+                                               triangles[i].texcoord);
+        }
+    }
+
+    raster_batch_t batch = {};
+    batch.triangles = triangles.data();
+    batch.setups = setups.data();
+    batch.covered = covered.data();
+    batch.count = triangle_count;
+    batch.sampler = texture_sampler(texture);
+    batch.bounds = scissor_rect(color_buffer);
+    raster_select_pipeline(state, color_buffer.depth_format)(color_buffer,
+                                                              batch);
+}
+
+/*******************************************************************************
+ * Deferred clears
+*******************************************************************************/
+static void resize_grid(tile_grid_t& grid, const ColorBuffer& color_buffer)
+{
+    grid.columns = (color_buffer.width + TILE_SIZE - 1) / TILE_SIZE;
+    grid.rows = (color_buffer.height + TILE_SIZE - 1) / TILE_SIZE;
+    grid.bins.resize(grid.columns * grid.rows);
+    grid.clear_pending.resize(grid.columns * grid.rows, 0);
+}
+
+static bool intersect_rects(const rect_t& a, const rect_t& b, rect_t& out_rect)
+{
+    out_rect.min_x = std::max(a.min_x, b.min_x);
+    out_rect.min_y = std::max(a.min_y, b.min_y);
+    out_rect.max_x = std::min(a.max_x, b.max_x);
+    out_rect.max_y = std::min(a.max_y, b.max_y);
+    return out_rect.min_x <= out_rect.max_x && out_rect.min_y <= out_rect.max_y;
+}
+
+// Tile area inside the color buffer
+static rect_t tile_rect(const tile_grid_t& grid,
+                        const ColorBuffer& color_buffer, uint32_t tile)
+{
+    rect_t rect = {};
+    rect.min_x = (int)((tile % grid.columns) * TILE_SIZE);
+    rect.min_y = (int)((tile / grid.columns) * TILE_SIZE);
+    rect.max_x = std::min(rect.min_x + TILE_SIZE, (int)color_buffer.width) - 1;
+    rect.max_y = std::min(rect.min_y + TILE_SIZE, (int)color_buffer.height) - 1;
+    return rect;
+}
+
+static void clear_tile(tile_grid_t& grid, ColorBuffer& color_buffer,
+                       uint32_t tile, uint8_t clear)
+{
+    clear &= grid.clear_pending[tile];
+    if (!clear)
+    {
+        return;
+    }
+
+    rect_t rect = tile_rect(grid, color_buffer, tile);
+
+    // Contiguous runs: pixel rows, or in the TILED layout rows of whole blocks,
+    // as TILE_SIZE is a multiple of FRAME_BLOCK_SIZE
+    bool tiled = color_buffer.layout == FRAME_LAYOUT::TILED;
+    int rows_per_run = tiled ? FRAME_BLOCK_SIZE : 1;
+    uint32_t run_length = rect.max_x - rect.min_x + 1;
+    if (tiled)
+    {
+        run_length = (rect.max_x / FRAME_BLOCK_SIZE -
+                      rect.min_x / FRAME_BLOCK_SIZE + 1) *
+                     FRAME_BLOCK_SIZE * FRAME_BLOCK_SIZE;
+    }
+    for (int y = rect.min_y; y <= rect.max_y; y += rows_per_run)
+    {
+        uint32_t first = pixel_index(color_buffer, rect.min_x, y);
+        if (clear & CLEAR_COLOR)
+        {
+            std::fill(color_buffer.memory + first,
+                      color_buffer.memory + first + run_length,
+                      grid.clear_color);
+        }
+        if (clear & CLEAR_DEPTH)
+        {
+            clear_depth(color_buffer, first, run_length);
+        }
+    }
+
+    // TILE_SIZE is a multiple of HIZ_BLOCK_SIZE, tiles own whole blocks
+    if ((clear & CLEAR_DEPTH) && hiz_buffer)
+    {
+        uint32_t blocks_per_row = hiz_width(color_buffer);
+        for (int y = rect.min_y / HIZ_BLOCK_SIZE;
+             y <= rect.max_y / HIZ_BLOCK_SIZE; ++y)
+        {
+            std::fill(hiz_buffer + blocks_per_row * y +
+                          rect.min_x / HIZ_BLOCK_SIZE,
+                      hiz_buffer + blocks_per_row * y +
+                          rect.max_x / HIZ_BLOCK_SIZE + 1, 1.0f);
+        }
+    }
+
+    rect_t bounds;
+    if ((clear & CLEAR_COLOR) && grid.background &&
+        intersect_rects(rect, scissor_rect(color_buffer), bounds))
+    {
+        grid.background(color_buffer, bounds);
+    }
+    grid.clear_pending[tile] &= (uint8_t)~clear;
+}
+
+void tile_grid_clear(tile_grid_t& grid, const ColorBuffer& color_buffer,
+                     uint32_t color)
+{
+    resize_grid(grid, color_buffer);
+    std::fill(grid.clear_pending.begin(), grid.clear_pending.end(),
+              (uint8_t)(CLEAR_COLOR | CLEAR_DEPTH));
+    grid.clear_color = color;
+}
+
+void tile_grid_resolve(tile_grid_t& grid, ColorBuffer& color_buffer)
+{
+    parallel_for(grid.columns * grid.rows, [&](uint32_t tile) {
+        clear_tile(grid, color_buffer, tile, CLEAR_COLOR);
+    });
+}
+
+/*******************************************************************************
+ * Screen area a triangle may write to in the current render mode
+*******************************************************************************/
+static bool triangle_bounds(const ColorBuffer& color_buffer,
+                            const triangle_t& triangle,
+                            const raster_triangle_t* setup,
+                            RENDER_MODE render_mode, rect_t& out_bounds)
+{
+    bool has_area = false;
+    if (setup)
+    {
+        out_bounds.min_x = setup->min_x;
+        out_bounds.min_y = setup->min_y;
+        out_bounds.max_x = setup->max_x;
+        out_bounds.max_y = setup->max_y;
+        has_area = true;
+    }
+
+    if (has_wireframe(render_mode))
+    {
+        // Lines stay inside their end points, dots reach 2 pixels further
+        int extent = render_mode == RENDER_MODE::WIREFRAME_DOTS ? 2 : 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            int x = (int)triangle.points[i].x;
+            int y = (int)triangle.points[i].y;
+            if (!has_area)
+            {
+                out_bounds = { x, y, x + extent, y + extent };
+                has_area = true;
+            }
+            out_bounds.min_x = std::min(out_bounds.min_x, x);
+            out_bounds.min_y = std::min(out_bounds.min_y, y);
+            out_bounds.max_x = std::max(out_bounds.max_x, x + extent);
+            out_bounds.max_y = std::max(out_bounds.max_y, y + extent);
+        }
+    }
+
+    return has_area && intersect_rects(out_bounds, scissor_rect(color_buffer),
+                                       out_bounds);
+}
+
+/*******************************************************************************
+ * Tiled rendering
+********************************************************************************
+** 1. Setup:  edge functions of every triangle, in parallel batches
+** 2. Binning: each triangle index is appended to every tile its bounds overlap,
+**             in submission order
+** 3. Raster: tiles are drawn in parallel. A tile only writes its own part of
+**            the color buffer and z-buffer, so no locking is needed.
+*******************************************************************************/
+void render_triangles_tiled(tile_grid_t& grid, ColorBuffer& color_buffer,
+                            const std::vector<triangle_t>& triangles,
+                            const pipeline_state_t& state,
+                            const uint32_t* texture)
+{
+    RENDER_MODE render_mode = state.render_mode;
+    raster_pipeline_fn pipeline = raster_select_pipeline(
+        state, color_buffer.depth_format);
+    sampler_t sampler = texture_sampler(texture);
+
+    resize_grid(grid, color_buffer);
+    for (std::vector<uint32_t>& bin : grid.bins)
+    {
+        bin.clear();
+    }
+
+    rect_t scissor = scissor_rect(color_buffer);
+    uint32_t triangle_count = (uint32_t)triangles.size();
+    grid.setups.resize(triangle_count);
+    grid.covered.assign(triangle_count, 0);
+
+    if (has_fill(render_mode))
+    {
+        uint32_t batches = (triangle_count + SETUP_BATCH_SIZE - 1) /
+                           SETUP_BATCH_SIZE;
+        parallel_for(batches, [&](uint32_t batch) {
+            uint32_t first = batch * SETUP_BATCH_SIZE;
+            uint32_t last = std::min(first + SETUP_BATCH_SIZE, triangle_count);
+            for (uint32_t i = first; i < last; ++i)
+            {
+                grid.covered[i] = raster_setup_triangle(
+                    grid.setups[i], color_buffer, triangles[i].points,
+                    triangles[i].texcoord);
+            }
+        });
+    }
+
+    for (uint32_t i = 0; i < triangle_count; ++i)
+    {
+        rect_t bounds;
+        const raster_triangle_t* setup = grid.covered[i] ? &grid.setups[i]
+                                                         : nullptr;
+        if (!triangle_bounds(color_buffer, triangles[i], setup, render_mode,
+                             bounds))
+        {
+            continue;
+        }
+
+        for (int row = bounds.min_y / TILE_SIZE;
+             row <= bounds.max_y / TILE_SIZE; ++row)
+        {
+            for (int column = bounds.min_x / TILE_SIZE;
+                 column <= bounds.max_x / TILE_SIZE; ++column)
+            {
+                grid.bins[row * grid.columns + column].push_back(i);
+            }
+        }
+    }
+
+    parallel_for(grid.columns * grid.rows, [&](uint32_t tile) {
+        const std::vector<uint32_t>& bin = grid.bins[tile];
+        if (bin.empty())
+        {
+            return;
+        }
+        clear_tile(grid, color_buffer, tile, CLEAR_COLOR | CLEAR_DEPTH);
+
+        // Tile area inside the scissor
+        rect_t bounds;
+        intersect_rects(tile_rect(grid, color_buffer, tile), scissor, bounds);
+
+        raster_batch_t batch = {};
+        batch.triangles = triangles.data();
+        batch.setups = grid.setups.data();
+        batch.covered = grid.covered.data();
+        batch.indices = bin.data();
+        batch.count = (uint32_t)bin.size();
+        batch.sampler = sampler;
+        batch.bounds = bounds;
+        pipeline(color_buffer, batch);
+    });
+}
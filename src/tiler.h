@@ -0,0 +1,59 @@
+#pragma once
+
+#include "display.h"
+#include "raster.h"
+#include "triangle.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#define TILE_SIZE 64
+
+/*******************************************************************************
+ * Structures
+*******************************************************************************/
+// Sort-middle binning state, kept between frames to reuse its allocations
+struct tile_grid_t
+{
+    uint32_t                           columns = 0;
+    uint32_t                           rows    = 0;
+    std::vector<std::vector<uint32_t>> bins;    // Triangle indices per tile
+    std::vector<raster_triangle_t>     setups;  // One per triangle
+    std::vector<uint8_t>               covered; // Setup hit at least a pixel
+
+    // Deferred clear (see tile_grid_clear), per tile
+    std::vector<uint8_t>               clear_pending;
+    uint32_t                           clear_color = 0;
+    // Drawn into a tile right after its color is cleared, clipped to 'bounds'
+    std::function<void(ColorBuffer& color_buffer, const rect_t& bounds)>
+                                       background;
+};
+
+/*******************************************************************************
+ * Deferred Clears
+********************************************************************************
+** Instead of filling the whole color buffer and z-buffer up front, a clear
+** only flags every tile. render_triangles_tiled() clears a tile right before
+** it first draws into it, in parallel and while the tile is hot in the cache.
+** tile_grid_resolve() then clears the color of the tiles nothing was drawn
+** in. Their depth stays untouched: no triangle read it this frame.
+*******************************************************************************/
+void tile_grid_clear(tile_grid_t& grid, const ColorBuffer& color_buffer,
+                     uint32_t color);
+void tile_grid_resolve(tile_grid_t& grid, ColorBuffer& color_buffer);
+
+/*******************************************************************************
+ * Triangle List Rendering
+*******************************************************************************/
+// Draws the triangles one after the other on the calling thread
+void render_triangles(ColorBuffer& color_buffer,
+                      const std::vector<triangle_t>& triangles,
+                      const pipeline_state_t& state, const uint32_t* texture);
+
+// Bins the triangles into TILE_SIZE tiles and rasterizes the tiles on the
+// thread pool. Each tile keeps the submission order, so the image is the same
+// as render_triangles() produces.
+void render_triangles_tiled(tile_grid_t& grid, ColorBuffer& color_buffer,
+                            const std::vector<triangle_t>& triangles,
+                            const pipeline_state_t& state, const uint32_t* texture);
@@ -0,0 +1,75 @@
+#include "gtest/gtest.h"
+#include "clipping.h"
+
+#include <cmath>
+
+const float CLIP_EPSILON = 0.0001f;
+
+TEST(Clipping, inside_triangle_is_unchanged)
+{
+    const vec4_t vertices[3] = {
+        { -0.5f, -0.5f, 0.5f, 1.0f },
+        {  0.5f, -0.5f, 0.5f, 1.0f },
+        {  0.0f,  0.5f, 0.5f, 1.0f }
+    };
+    const tex2_t texcoords[3] = { { 0, 0 }, { 1, 0 }, { 0, 1 } };
+    polygon_t polygon = polygon_from_triangle(vertices, texcoords);
+    clip_polygon(polygon);
+
+    ASSERT_EQ(polygon.num_vertices, 3);
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_EQ(polygon.vertices[i].x, vertices[i].x);
+        EXPECT_EQ(polygon.vertices[i].y, vertices[i].y);
+        EXPECT_EQ(polygon.texcoords[i].u, texcoords[i].u);
+    }
+}
+
+TEST(Clipping, outside_triangle_is_rejected)
+{
+    // Entirely behind the near plane (z < 0)
+    const vec4_t vertices[3] = {
+        { -0.5f, -0.5f, -0.1f, 0.5f },
+        {  0.5f, -0.5f, -0.2f, 0.5f },
+        {  0.0f,  0.5f, -0.3f, 0.5f }
+    };
+    const tex2_t texcoords[3] = {};
+    polygon_t polygon = polygon_from_triangle(vertices, texcoords);
+    clip_polygon(polygon);
+
+    EXPECT_EQ(polygon.num_vertices, 0);
+}
+
+TEST(Clipping, near_plane_interpolates_attributes)
+{
+    // One vertex behind the near plane: the triangle becomes a quad
+    const vec4_t vertices[3] = {
+        { 0.0f, 0.0f, -1.0f, 1.0f },
+        { 1.0f, 0.0f,  1.0f, 3.0f },
+        { 0.0f, 1.0f,  1.0f, 3.0f }
+    };
+    const tex2_t texcoords[3] = { { 0, 0 }, { 1, 0 }, { 0, 1 } };
+    polygon_t polygon = polygon_from_triangle(vertices, texcoords);
+    clip_polygon(polygon);
+
+    ASSERT_EQ(polygon.num_vertices, 4);
+    for (int i = 0; i < polygon.num_vertices; ++i)
+    {
+        EXPECT_GE(polygon.vertices[i].z, -CLIP_EPSILON);
+    }
+
+    // New vertices sit halfway along the clipped edges, w and uv included
+    bool found_u = false;
+    bool found_v = false;
+    for (int i = 0; i < polygon.num_vertices; ++i)
+    {
+        if (fabs(polygon.vertices[i].z) <= CLIP_EPSILON)
+        {
+            EXPECT_NEAR(polygon.vertices[i].w, 2.0f, CLIP_EPSILON);
+            found_u |= fabs(polygon.texcoords[i].u - 0.5f) <= CLIP_EPSILON;
+            found_v |= fabs(polygon.texcoords[i].v - 0.5f) <= CLIP_EPSILON;
+        }
+    }
+    EXPECT_TRUE(found_u);
+    EXPECT_TRUE(found_v);
+}
@@ -1,6 +1,9 @@
 #include "gtest/gtest.h"
 #include "display.h"
 
+#include <cstdlib>
+#include <vector>
+
 TEST(Display, initialize_window)
 {
     SDL_API sdl = initialize_window();
@@ -244,4 +247,317 @@ TEST(Display, draw_rect)
             }
         }
     }
-}
\ No newline at end of file
+}
+TEST(Display, draw_line)
+{
+    ColorBuffer color_buffer = {};
+    uint32_t pitch = 10;
+    color_buffer.width = pitch;
+    color_buffer.height = pitch;
+    uint32_t size = color_buffer.width * color_buffer.height;
+    color_buffer.memory = (uint32_t*)calloc(size, sizeof(uint32_t));
+
+    // Half a pixel up every other step, rounded to nearest
+    draw_line(color_buffer, 1, 1, 5, 3, 0xFFFFFFFF);
+    const int expected[][2] = { { 1, 1 }, { 2, 2 }, { 3, 2 }, { 4, 3 },
+                                { 5, 3 } };
+    uint32_t drawn = 0;
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        drawn += color_buffer.memory[i] == 0xFFFFFFFF;
+    }
+    EXPECT_EQ(drawn, 5u);
+    for (const int* point : expected)
+    {
+        EXPECT_EQ(color_buffer.memory[point[1] * pitch + point[0]],
+                  0xFFFFFFFF) << "X: " << point[0] << ", Y: " << point[1];
+    }
+
+    // Clipped lines keep the pixels of the whole line inside the bounds
+    color_buffer.width = 200;
+    color_buffer.height = 200;
+    size = color_buffer.width * color_buffer.height;
+    free(color_buffer.memory);
+    color_buffer.memory = (uint32_t*)malloc(sizeof(uint32_t) * size);
+    std::vector<uint32_t> whole(size);
+
+    const rect_t bounds = { 70, 60, 130, 150 };
+    srand(7);
+    for (int line = 0; line < 500; ++line)
+    {
+        int x0 = rand() % 200;
+        int y0 = rand() % 200;
+        int x1 = rand() % 200;
+        int y1 = rand() % 200;
+        if (line % 10 == 0)
+        {
+            y1 = y0; // Horizontal and vertical fast paths
+        }
+        else if (line % 10 == 1)
+        {
+            x1 = x0;
+        }
+
+        clear_color_buffer(color_buffer, 0);
+        draw_line(color_buffer, x0, y0, x1, y1, 0xFFFFFFFF,
+                  color_buffer_rect(color_buffer));
+        whole.assign(color_buffer.memory, color_buffer.memory + size);
+
+        clear_color_buffer(color_buffer, 0);
+        draw_line(color_buffer, x0, y0, x1, y1, 0xFFFFFFFF, bounds);
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            int x = (int)(i % color_buffer.width);
+            int y = (int)(i / color_buffer.width);
+            bool inside = x >= bounds.min_x && x <= bounds.max_x &&
+                          y >= bounds.min_y && y <= bounds.max_y;
+            ASSERT_EQ(color_buffer.memory[i], inside ? whole[i] : 0u)
+                << "Line " << line << ", X: " << x << ", Y: " << y;
+        }
+    }
+
+    free(color_buffer.memory);
+}
+
+TEST(Display, draw_filled_triangle)
+{
+    ColorBuffer color_buffer = {};
+    uint32_t pitch = 10;
+    color_buffer.width = pitch;
+    color_buffer.height = pitch;
+    uint32_t size = color_buffer.width * color_buffer.height;
+
+    color_buffer.memory = (uint32_t*)calloc(size, sizeof(uint32_t));
+    z_buffer = malloc(sizeof(float) * size);
+
+    // Square split in two triangles sharing the (0,0)-(8,8) diagonal
+    clear_z_buffer(color_buffer);
+    draw_filled_triangle(color_buffer, 0, 0, 0.0f, 1.0f, 8, 0, 0.0f, 1.0f,
+                         8, 8, 0.0f, 1.0f, 0xFF0000FF);
+    draw_filled_triangle(color_buffer, 0, 0, 0.0f, 1.0f, 8, 8, 0.0f, 1.0f,
+                         0, 8, 0.0f, 1.0f, 0xFFFF0000);
+    uint32_t first = 0;
+    uint32_t second = 0;
+    for (uint32_t i = 0; i < pitch; ++i)
+    {
+        for (uint32_t j = 0; j < pitch; ++j)
+        {
+            uint32_t pixel = color_buffer.memory[i * pitch + j];
+            if (i < 8 && j < 8)
+            {
+                // Top-left rule: every pixel covered exactly once, no gaps
+                EXPECT_NE(pixel, 0x00000000u) << "I: " << i << ", J: " << j;
+            }
+            else
+            {
+                EXPECT_EQ(pixel, 0x00000000u) << "I: " << i << ", J: " << j;
+            }
+            first += pixel == 0xFF0000FF;
+            second += pixel == 0xFFFF0000;
+        }
+    }
+    EXPECT_EQ(first + second, 64u);
+    EXPECT_EQ(first, 36u);  // Diagonal belongs to the first triangle
+    EXPECT_EQ(second, 28u);
+
+    // Farther triangle (bigger w) must not overwrite the closer one
+    draw_filled_triangle(color_buffer, 0, 0, 0.0f, 2.0f, 8, 0, 0.0f, 2.0f,
+                         0, 8, 0.0f, 2.0f, 0xFF00FF00);
+    EXPECT_EQ(color_buffer.memory[1 * pitch + 1], 0xFF0000FFu);
+
+    // Partially off-screen triangles are clipped to the buffer
+    draw_filled_triangle(color_buffer, -20, -20, 0.0f, 0.5f, 30, -20, 0.0f,
+                         0.5f, -20, 30, 0.0f, 0.5f, 0xFFFFFFFF);
+    EXPECT_EQ(color_buffer.memory[0], 0xFFFFFFFFu);
+    EXPECT_EQ(color_buffer.memory[pitch * pitch - 1], 0x00000000u);
+
+    free(color_buffer.memory);
+    free(z_buffer);
+    z_buffer = nullptr;
+}
+
+TEST(Display, scissor)
+{
+    ColorBuffer color_buffer = {};
+    uint32_t pitch = 10;
+    color_buffer.width = pitch;
+    color_buffer.height = pitch;
+    uint32_t size = color_buffer.width * color_buffer.height;
+
+    color_buffer.memory = (uint32_t*)calloc(size, sizeof(uint32_t));
+    z_buffer = malloc(sizeof(float) * size);
+    clear_z_buffer(color_buffer);
+
+    // Scissor partly outside the buffer is clamped to it
+    set_scissor(color_buffer, 2, 3, 100, 4);
+    rect_t scissor = scissor_rect(color_buffer);
+    EXPECT_EQ(scissor.min_x, 2);
+    EXPECT_EQ(scissor.min_y, 3);
+    EXPECT_EQ(scissor.max_x, 9);
+    EXPECT_EQ(scissor.max_y, 6);
+
+    // Shapes covering the whole buffer only land inside the scissor
+    draw_filled_triangle(color_buffer, -5, -5, 0.0f, 1.0f, 30, -5, 0.0f, 1.0f,
+                         -5, 30, 0.0f, 1.0f, 0xFFFFFFFF);
+    draw_rect(color_buffer, -1, -1, 20, 20, 0xFFFFFFFF);
+    draw_line(color_buffer, 0, 0, 9, 9, 0xFFFFFFFF);
+    draw_pixel(color_buffer, 0, 0, 0xFFFFFFFF);
+    for (uint32_t i = 0; i < pitch; ++i)
+    {
+        for (uint32_t j = 0; j < pitch; ++j)
+        {
+            bool inside = i >= 3 && i <= 6 && j >= 2;
+            EXPECT_EQ(color_buffer.memory[i * pitch + j],
+                      inside ? 0xFFFFFFFF : 0x00000000)
+                << "I: " << i << ", J: " << j;
+        }
+    }
+
+    reset_scissor(color_buffer);
+    draw_pixel(color_buffer, 0, 0, 0xFFFFFFFF);
+    EXPECT_EQ(color_buffer.memory[0], 0xFFFFFFFF);
+
+    free(color_buffer.memory);
+    free(z_buffer);
+    z_buffer = nullptr;
+}
+
+TEST(Display, tiled_layout)
+{
+    // Partial blocks on the right and bottom
+    ColorBuffer linear = {};
+    linear.width = 37;
+    linear.height = 21;
+    ColorBuffer tiled = linear;
+    set_frame_layout(linear, FRAME_LAYOUT::LINEAR);
+    void* linear_depth = z_buffer;
+    z_buffer = nullptr;
+    set_frame_layout(tiled, FRAME_LAYOUT::TILED);
+    EXPECT_EQ(color_buffer_size(tiled), 40u * 24u);
+
+    srand(11);
+    for (int shape = 0; shape < 200; ++shape)
+    {
+        int x0 = rand() % 50 - 6;
+        int y0 = rand() % 30 - 4;
+        int x1 = rand() % 50 - 6;
+        int y1 = rand() % 30 - 4;
+        uint32_t color = 0xFF000000 | (uint32_t)rand();
+        for (ColorBuffer* color_buffer : { &linear, &tiled })
+        {
+            switch (shape % 4)
+            {
+                case 0: draw_line(*color_buffer, x0, y0, x1, y1, color); break;
+                case 1: draw_rect(*color_buffer, x0, y0, x1 % 9 + 6, y1 % 9 + 4,
+                                  color); break;
+                case 2: draw_pixel(*color_buffer, x0, y0, color); break;
+                case 3: draw_grid(*color_buffer, shape % 7 + 1, color); break;
+            }
+        }
+    }
+
+    const uint32_t* expected = linear_pixels(linear);
+    const uint32_t* detiled = linear_pixels(tiled);
+    EXPECT_EQ(expected, linear.memory);
+    for (uint32_t i = 0; i < linear.width * linear.height; ++i)
+    {
+        ASSERT_EQ(expected[i], detiled[i]) << "Pixel " << i;
+    }
+    EXPECT_EQ(tiled.memory[pixel_index(tiled, 9, 1)], detiled[37 + 9]);
+
+    free(linear.memory);
+    free(linear_depth);
+    free(tiled.memory);
+    free(tiled.staging);
+    free(z_buffer);
+    z_buffer = nullptr;
+}
+
+TEST(Display, row_pitch)
+{
+    // Rows padded like a locked texture's
+    ColorBuffer packed = {};
+    packed.width = 37;
+    packed.height = 21;
+    ColorBuffer padded = packed;
+    padded.pitch = 45;
+    EXPECT_EQ(color_buffer_size(padded), 45u * 21u);
+    packed.memory = (uint32_t*)calloc(color_buffer_size(packed),
+                                      sizeof(uint32_t));
+    padded.memory = (uint32_t*)calloc(color_buffer_size(padded),
+                                      sizeof(uint32_t));
+
+    srand(13);
+    for (int shape = 0; shape < 200; ++shape)
+    {
+        int x0 = rand() % 50 - 6;
+        int y0 = rand() % 30 - 4;
+        int x1 = rand() % 50 - 6;
+        int y1 = rand() % 30 - 4;
+        uint32_t color = 0xFF000000 | (uint32_t)rand();
+        for (ColorBuffer* color_buffer : { &packed, &padded })
+        {
+            switch (shape % 3)
+            {
+                case 0: draw_line(*color_buffer, x0, y0, x1, y1, color); break;
+                case 1: draw_rect(*color_buffer, x0, y0, x1 % 9 + 6, y1 % 9 + 4,
+                                  color); break;
+                case 2: draw_pixel(*color_buffer, x0, y0, color); break;
+            }
+        }
+    }
+
+    for (uint32_t y = 0; y < padded.height; ++y)
+    {
+        for (uint32_t x = 0; x < padded.pitch; ++x)
+        {
+            // Nothing lands in the padding
+            uint32_t expected = x < packed.width
+                              ? packed.memory[packed.width * y + x] : 0u;
+            ASSERT_EQ(padded.memory[padded.pitch * y + x], expected)
+                << "X: " << x << ", Y: " << y;
+        }
+    }
+
+    free(packed.memory);
+    free(padded.memory);
+}
+
+TEST(Display, lock_texture_present)
+{
+    SDL_API sdl = {};
+    SDL_Init(SDL_INIT_VIDEO);
+    sdl.window = SDL_CreateWindow("test-CPU-Renderer", 100, 100, 0x0);
+    sdl.renderer = SDL_CreateRenderer(sdl.window, 0, 0);
+
+    ColorBuffer color_buffer = {};
+    color_buffer.present_mode = PRESENT_MODE::LOCK_TEXTURE;
+    create_color_buffer(sdl, color_buffer);
+    if (color_buffer.present_mode == PRESENT_MODE::LOCK_TEXTURE)
+    {
+        // No memory of its own, the texture's while a frame is drawn
+        EXPECT_EQ(color_buffer.memory, nullptr);
+        EXPECT_GE(row_pitch(color_buffer), color_buffer.width);
+        ASSERT_TRUE(begin_frame(color_buffer));
+        ASSERT_NE(color_buffer.memory, nullptr);
+        clear_z_buffer(color_buffer);
+        draw_rect(color_buffer, 0, 0, 100, 100, 0xFF18191A);
+        present_frame(sdl, color_buffer);
+        EXPECT_EQ(color_buffer.memory, nullptr);
+    }
+
+    // Detiled into the texture
+    set_frame_layout(color_buffer, FRAME_LAYOUT::TILED);
+    EXPECT_NE(color_buffer.memory, nullptr);
+    ASSERT_TRUE(begin_frame(color_buffer));
+    present_frame(sdl, color_buffer);
+
+    set_present_mode(color_buffer, PRESENT_MODE::UPDATE_TEXTURE);
+    EXPECT_NE(color_buffer.memory, nullptr);
+    EXPECT_EQ(color_buffer.pitch, 0u);
+    destroy_color_buffer(color_buffer);
+
+    SDL_DestroyRenderer(sdl.renderer);
+    SDL_DestroyWindow(sdl.window);
+    SDL_Quit();
+}
@@ -0,0 +1,226 @@
+#include "gtest/gtest.h"
+#include "display.h"
+#include "frame_ring.h"
+
+#include <thread>
+#include <vector>
+
+TEST(FrameRing, draws_off_thread_one_frame_behind)
+{
+    SDL_API sdl = {};
+    SDL_Init(SDL_INIT_VIDEO);
+    sdl.window = SDL_CreateWindow("test-CPU-Renderer", 100, 100, 0x0);
+    sdl.renderer = SDL_CreateRenderer(sdl.window, 0, 0);
+
+    ColorBuffer color_buffer = {};
+    create_color_buffer(sdl, color_buffer);
+
+    frame_ring_t ring;
+    frame_ring_init(ring, 2);
+    std::vector<uint32_t*> memories;
+    std::thread::id caller = std::this_thread::get_id();
+    for (uint32_t frame = 0; frame < 5; ++frame)
+    {
+        bool off_thread = false;
+        ASSERT_TRUE(frame_ring_render(ring, color_buffer,
+                                      [&](ColorBuffer& target) {
+            off_thread = std::this_thread::get_id() != caller;
+            memories.push_back(target.memory);
+            EXPECT_EQ(target.width, color_buffer.width);
+            draw_rect(target, 0, 0, target.width, target.height,
+                      0xFF000000 | frame);
+        }));
+        frame_ring_present(ring, sdl);
+        EXPECT_EQ(ring.presented, (uint64_t)frame); // The previous frame
+
+        frame_ring_wait(ring);
+        EXPECT_TRUE(off_thread);
+        EXPECT_EQ(memories[frame][0], 0xFF000000 | frame);
+    }
+
+    // Two color buffers, used in turn
+    EXPECT_NE(memories[0], memories[1]);
+    EXPECT_EQ(memories[0], memories[2]);
+
+    frame_ring_flush(ring);
+    EXPECT_EQ(ring.presented, ring.submitted);
+    frame_ring_destroy(ring);
+    destroy_color_buffer(color_buffer);
+
+    SDL_DestroyRenderer(sdl.renderer);
+    SDL_DestroyWindow(sdl.window);
+    SDL_Quit();
+}
+
+TEST(FrameRing, locked_textures_per_slot)
+{
+    SDL_API sdl = {};
+    SDL_Init(SDL_INIT_VIDEO);
+    sdl.window = SDL_CreateWindow("test-CPU-Renderer", 100, 100, 0x0);
+    sdl.renderer = SDL_CreateRenderer(sdl.window, 0, 0);
+
+    ColorBuffer color_buffer = {};
+    color_buffer.present_mode = PRESENT_MODE::LOCK_TEXTURE;
+    create_color_buffer(sdl, color_buffer);
+    ASSERT_TRUE(draws_into_texture(color_buffer));
+
+    // Each slot draws off thread into its own locked texture, nothing copied
+    frame_ring_t ring;
+    frame_ring_init(ring, 2, sdl.renderer);
+    std::vector<SDL_Texture*> textures;
+    std::thread::id caller = std::this_thread::get_id();
+    for (uint32_t frame = 0; frame < 4; ++frame)
+    {
+        bool off_thread = false;
+        ASSERT_TRUE(frame_ring_render(ring, color_buffer,
+                                      [&](ColorBuffer& target) {
+            off_thread = std::this_thread::get_id() != caller;
+            EXPECT_TRUE(target.locked);
+            EXPECT_NE(target.memory, nullptr);
+            textures.push_back(target.texture);
+            draw_rect(target, 0, 0, target.width, target.height,
+                      0xFF000000 | frame);
+        }));
+        frame_ring_present(ring, sdl);
+        frame_ring_wait(ring);
+        EXPECT_TRUE(off_thread);
+    }
+
+    EXPECT_NE(textures[0], textures[1]);
+    EXPECT_EQ(textures[0], textures[2]);
+    EXPECT_NE(textures[0], color_buffer.texture);
+
+    // Flushing unlocks the frames not presented
+    frame_ring_flush(ring);
+    EXPECT_FALSE(ring.slots[1].target.locked);
+    frame_ring_destroy(ring);
+    destroy_color_buffer(color_buffer);
+
+    SDL_DestroyRenderer(sdl.renderer);
+    SDL_DestroyWindow(sdl.window);
+    SDL_Quit();
+}
+
+TEST(FrameRing, single_buffer_draws_in_place)
+{
+    SDL_API sdl = {};
+    SDL_Init(SDL_INIT_VIDEO);
+    sdl.window = SDL_CreateWindow("test-CPU-Renderer", 100, 100, 0x0);
+    sdl.renderer = SDL_CreateRenderer(sdl.window, 0, 0);
+
+    ColorBuffer color_buffer = {};
+    create_color_buffer(sdl, color_buffer);
+
+    frame_ring_t ring;
+    frame_ring_init(ring, 1);
+    std::thread::id caller = std::this_thread::get_id();
+    bool on_caller = false;
+    ASSERT_TRUE(frame_ring_render(ring, color_buffer,
+                                  [&](ColorBuffer& target) {
+        on_caller = std::this_thread::get_id() == caller;
+        EXPECT_EQ(target.memory, color_buffer.memory);
+    }));
+    EXPECT_TRUE(on_caller);
+
+    // Full until presented, right away
+    EXPECT_FALSE(frame_ring_render(ring, color_buffer, nullptr));
+    frame_ring_present(ring, sdl);
+    EXPECT_EQ(ring.presented, 1u);
+
+    frame_ring_destroy(ring);
+    destroy_color_buffer(color_buffer);
+
+    SDL_DestroyRenderer(sdl.renderer);
+    SDL_DestroyWindow(sdl.window);
+    SDL_Quit();
+}
+
+TEST(FrameRing, queue_depth_is_bounded)
+{
+    SDL_API sdl = {};
+    SDL_Init(SDL_INIT_VIDEO);
+    sdl.window = SDL_CreateWindow("test-CPU-Renderer", 100, 100, 0x0);
+    sdl.renderer = SDL_CreateRenderer(sdl.window, 0, 0);
+
+    ColorBuffer color_buffer = {};
+    create_color_buffer(sdl, color_buffer);
+
+    // Per slot input, refilled while the other frames are queued
+    frame_ring_t ring;
+    frame_ring_init(ring, 3);
+    std::vector<uint32_t> inputs[MAX_FRAMES_IN_FLIGHT];
+    std::vector<uint32_t> drawn;
+    for (uint32_t frame = 0; frame < 8; ++frame)
+    {
+        uint32_t slot = frame_ring_next_slot(ring);
+        EXPECT_EQ(slot, frame % 3);
+        inputs[slot].assign(1000, frame);
+
+        const std::vector<uint32_t>& input = inputs[slot];
+        ASSERT_TRUE(frame_ring_render(ring, color_buffer,
+                                      [&drawn, &input](ColorBuffer&) {
+            for (uint32_t value : input)
+            {
+                ASSERT_EQ(value, input[0]);
+            }
+            drawn.push_back(input[0]);
+        }));
+        if (frame == 2)
+        {
+            // Three unpresented frames fill the ring
+            EXPECT_FALSE(frame_ring_render(ring, color_buffer, nullptr));
+        }
+
+        // Two frames stay queued behind the one presented
+        frame_ring_present(ring, sdl);
+        EXPECT_EQ(ring.presented, frame < 2 ? 0u : (uint64_t)frame - 1);
+    }
+
+    frame_ring_wait(ring);
+    ASSERT_EQ(drawn.size(), 8u);
+    for (uint32_t frame = 0; frame < 8; ++frame)
+    {
+        EXPECT_EQ(drawn[frame], frame);
+    }
+
+    frame_ring_destroy(ring);
+    destroy_color_buffer(color_buffer);
+
+    SDL_DestroyRenderer(sdl.renderer);
+    SDL_DestroyWindow(sdl.window);
+    SDL_Quit();
+}
+
+TEST(FrameRing, default_present_mode_overlaps_frames)
+{
+    SDL_API sdl = {};
+    SDL_Init(SDL_INIT_VIDEO);
+    sdl.window = SDL_CreateWindow("test-CPU-Renderer", 100, 100, 0x0);
+    sdl.renderer = SDL_CreateRenderer(sdl.window, 0, 0);
+
+    // Set up like the app: frames in flight whatever the present mode
+    ColorBuffer color_buffer = {};
+    color_buffer.present_mode = DEFAULT_PRESENT_MODE;
+    create_color_buffer(sdl, color_buffer);
+    frame_ring_t ring;
+    frame_ring_init(ring, FRAMES_IN_FLIGHT + 1, sdl.renderer);
+    EXPECT_GT(ring.size, 1u);
+
+    std::thread::id caller = std::this_thread::get_id();
+    bool off_thread = false;
+    ASSERT_TRUE(frame_ring_render(ring, color_buffer,
+                                  [&](ColorBuffer&) {
+        off_thread = std::this_thread::get_id() != caller;
+    }));
+    frame_ring_present(ring, sdl);
+    EXPECT_EQ(ring.presented, 0u); // Still in flight
+    frame_ring_wait(ring);
+    EXPECT_TRUE(off_thread);
+
+    frame_ring_destroy(ring);
+    destroy_color_buffer(color_buffer);
+
+    SDL_DestroyRenderer(sdl.renderer);
+    SDL_DestroyWindow(sdl.window);
+    SDL_Quit();
+}
@@ -0,0 +1,53 @@
+#include "gtest/gtest.h"
+#include "frustum.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "test-meshes.h"
+
+#include <cmath>
+
+TEST(Frustum, mesh_tests)
+{
+    mat4_t projection_matrix = mat4_make_perspective(1.0f, 0.75f, 0.1f,
+                                                     100.0f);
+    frustum_t frustum = make_frustum(projection_matrix);
+    mesh_t cube = make_cube_mesh();
+
+    struct
+    {
+        vec3_t       translation;
+        FRUSTUM_TEST expected;
+    } cases[] = {
+        { {   0.0f, 0.0f,   10.0f }, FRUSTUM_TEST::INSIDE       },
+        { {   0.0f, 0.0f,  -10.0f }, FRUSTUM_TEST::OUTSIDE      }, // Behind
+        { {   0.0f, 0.0f,    0.5f }, FRUSTUM_TEST::INTERSECTING }, // Near
+        { {   0.0f, 0.0f,  100.0f }, FRUSTUM_TEST::INTERSECTING }, // Far
+        { {   0.0f, 0.0f,  150.0f }, FRUSTUM_TEST::OUTSIDE      },
+        { { -60.0f, 0.0f,   10.0f }, FRUSTUM_TEST::OUTSIDE      }, // Left
+        { {   0.0f, 60.0f,  10.0f }, FRUSTUM_TEST::OUTSIDE      }, // Top
+        // Off the screen edge, inside the guard band: nothing to clip
+        { {   9.0f, 0.0f,   10.0f }, FRUSTUM_TEST::INSIDE       },
+        { {  30.0f, 0.0f,   10.0f }, FRUSTUM_TEST::OUTSIDE      }
+    };
+    for (const auto& test_case : cases)
+    {
+        mat4_t world_matrix = mat4_make_translation(test_case.translation.x,
+                                                    test_case.translation.y,
+                                                    test_case.translation.z);
+        EXPECT_EQ(frustum_test_mesh(frustum, cube, world_matrix),
+                  test_case.expected)
+            << test_case.translation.x << ", " << test_case.translation.y
+            << ", " << test_case.translation.z;
+    }
+
+    // Scaled and rotated: the box decides where the sphere cannot
+    mat4_t world_matrix = mat4_make_rotation_y(0.5f).mul_mat4(
+        mat4_make_scale(3.0f, 0.25f, 0.25f));
+    world_matrix = mat4_make_translation(0.0f, 7.1f, 10.0f).mul_mat4(
+        world_matrix);
+    EXPECT_NE(frustum_test_sphere(frustum, { 0.0f, 7.1f, 10.0f },
+                                  sqrtf(3.0f) * 3.0f),
+              FRUSTUM_TEST::OUTSIDE);
+    EXPECT_EQ(frustum_test_mesh(frustum, cube, world_matrix),
+              FRUSTUM_TEST::OUTSIDE);
+}
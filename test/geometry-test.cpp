@@ -0,0 +1,229 @@
+#include "gtest/gtest.h"
+#include "geometry.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "test-meshes.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+static float random_float(float min, float max)
+{
+    return min + (max - min) * (rand() % 10000) / 10000.0f;
+}
+
+TEST(Geometry, parallel_matches_serial_face_order)
+{
+    // Several batches and a partial one. Vertices behind the camera and past
+    // the sides get clipped into fans.
+    mesh_t soup = {};
+    srand(7);
+    for (int i = 0; i < 3000; ++i)
+    {
+        soup.vertices.push_back({ random_float(-6.0f, 6.0f),
+                                  random_float(-6.0f, 6.0f),
+                                  random_float(-6.0f, 6.0f) });
+    }
+    for (int i = 0; i < 2 * GEOMETRY_BATCH_SIZE + 300; ++i)
+    {
+        face_t face = {};
+        face.a = 1 + rand() % 3000;
+        face.b = 1 + rand() % 3000;
+        face.c = 1 + rand() % 3000;
+        face.a_uv = { random_float(0.0f, 1.0f), random_float(0.0f, 1.0f) };
+        face.b_uv = { random_float(0.0f, 1.0f), random_float(0.0f, 1.0f) };
+        face.c_uv = { random_float(0.0f, 1.0f), random_float(0.0f, 1.0f) };
+        face.color = 0xFF000000 | (uint32_t)rand();
+        soup.faces.push_back(face);
+    }
+    mesh_compute_face_planes(soup);
+
+    mat4_t world_matrix = mat4_make_rotation_x(0.4f);
+    world_matrix = mat4_make_translation(0.0f, 0.0f, 5.0f).mul_mat4(
+        world_matrix);
+    mat4_t projection_matrix = mat4_make_perspective(1.0f, 0.75f, 0.1f,
+                                                     100.0f);
+    transformed_mesh_t transformed;
+    transform_mesh(soup, world_matrix, projection_matrix, 800.0f, 600.0f,
+                   transformed);
+
+    geometry_bins_t bins;
+    for (int culling = 0; culling < 2; ++culling)
+    {
+        geometry_view_t view;
+        view.light.direction = { 0.0f, 0.0f, 1.0f };
+        view.world_matrix = world_matrix;
+        view.culling = culling == 1;
+        view.width = 800.0f;
+        view.height = 600.0f;
+
+        std::vector<triangle_t> serial;
+        assemble_faces(soup, transformed, view, 0,
+                       (uint32_t)soup.faces.size(), serial);
+        // Appended after the triangles already there
+        const size_t first = 5;
+        std::vector<triangle_t> triangles(first);
+        assemble_triangles(bins, soup, transformed, view, triangles);
+
+        ASSERT_GT(serial.size(), soup.faces.size() / 4);
+        ASSERT_EQ(first + serial.size(), triangles.size());
+        triangles.erase(triangles.begin(), triangles.begin() + first);
+        for (size_t i = 0; i < serial.size(); ++i)
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                for (int k = 0; k < 4; ++k)
+                {
+                    ASSERT_EQ(serial[i].points[j].data[k],
+                              triangles[i].points[j].data[k])
+                        << "Culling " << culling << ", triangle " << i;
+                }
+                ASSERT_EQ(serial[i].texcoord[j].u, triangles[i].texcoord[j].u);
+                ASSERT_EQ(serial[i].texcoord[j].v, triangles[i].texcoord[j].v);
+            }
+            ASSERT_EQ(serial[i].color, triangles[i].color);
+        }
+    }
+}
+
+TEST(Geometry, object_space_culling_matches_world_space)
+{
+    // In front of the camera and inside the frustum: no clipping, one
+    // triangle per face kept
+    mesh_t soup = {};
+    srand(8);
+    for (int i = 0; i < 600; ++i)
+    {
+        soup.vertices.push_back({ random_float(-1.0f, 1.0f),
+                                  random_float(-1.0f, 1.0f),
+                                  random_float(-1.0f, 1.0f) });
+    }
+    for (int i = 0; i < 1000; ++i)
+    {
+        // Three different corners: no degenerate faces
+        face_t face = {};
+        face.a = 1 + rand() % 600;
+        face.b = 1 + (face.a + rand() % 599) % 600;
+        do
+        {
+            face.c = 1 + rand() % 600;
+        } while (face.c == face.a || face.c == face.b);
+        face.color = 0xFFFFFFFF;
+        soup.faces.push_back(face);
+    }
+    mesh_compute_face_planes(soup);
+
+    mat4_t projection_matrix = mat4_make_perspective(1.0f, 0.75f, 0.1f,
+                                                     100.0f);
+    const mat4_t scales[] = {
+        mat4_make_scale(1.5f, 0.5f, 1.0f),
+        mat4_make_scale(-1.0f, 1.0f, 2.0f) // Mirrored
+    };
+    for (const mat4_t& scale : scales)
+    {
+        mat4_t world_matrix = mat4_make_rotation_y(0.6f).mul_mat4(scale);
+        world_matrix = mat4_make_translation(0.3f, 0.2f, 8.0f).mul_mat4(
+            world_matrix);
+        transformed_mesh_t transformed;
+        transform_mesh(soup, world_matrix, projection_matrix, 800.0f, 600.0f,
+                       transformed);
+
+        geometry_view_t view;
+        view.camera_pos = { 0.0f, 0.0f, -5.0f };
+        view.world_matrix = world_matrix;
+        view.light.direction = { 0.0f, 0.0f, 1.0f };
+        view.width = 800.0f;
+        view.height = 600.0f;
+        std::vector<triangle_t> triangles;
+        assemble_faces(soup, transformed, view, 0, (uint32_t)soup.faces.size(),
+                       triangles);
+
+        // The world space test, on normalized edges as update() had it
+        size_t kept = 0;
+        for (const face_t& face : soup.faces)
+        {
+            vec3_t vertex_a = transformed_world(transformed, face.a - 1).to_vec3();
+            vec3_t vertex_b = transformed_world(transformed, face.b - 1).to_vec3();
+            vec3_t vertex_c = transformed_world(transformed, face.c - 1).to_vec3();
+            vec3_t vector_ab = vertex_b - vertex_a;
+            vec3_t vector_ac = vertex_c - vertex_a;
+            vector_ab.normalize();
+            vector_ac.normalize();
+            vec3_t normal = vector_ab.cross_product(vector_ac);
+            normal.normalize();
+            if (normal.dot_product(view.camera_pos - vertex_a) <= 0)
+            {
+                continue;
+            }
+
+            ASSERT_LT(kept, triangles.size());
+            vec4_t screen = transformed_screen(transformed, face.a - 1);
+            EXPECT_EQ(triangles[kept].points[0].x, screen.x);
+            EXPECT_EQ(triangles[kept].points[0].y, screen.y);
+
+            // Same shading as from the world space normal
+            float percentage = -normal.dot_product(view.light.direction);
+            uint32_t color = light_apply_intensity(face.color, percentage);
+            for (int shift = 0; shift < 24; shift += 8)
+            {
+                EXPECT_NEAR((int)(triangles[kept].color >> shift & 0xFF),
+                            (int)(color >> shift & 0xFF), 1);
+            }
+            ++kept;
+        }
+        EXPECT_GT(kept, soup.faces.size() / 4);
+        EXPECT_EQ(kept, triangles.size());
+    }
+}
+
+TEST(Geometry, meshlet_culling_matches_face_culling)
+{
+    mesh_t sphere = make_sphere_mesh(40, 80);
+    mesh_t clustered = sphere;
+    mesh_build_meshlets(clustered);
+
+    mat4_t world_matrix = mat4_make_rotation_y(0.6f).mul_mat4(
+        mat4_make_scale(1.0f, 1.5f, 1.0f));
+    world_matrix = mat4_make_translation(0.0f, 0.0f, 4.0f).mul_mat4(
+        world_matrix);
+    mat4_t projection_matrix = mat4_make_perspective(1.0f, 0.75f, 0.1f,
+                                                     100.0f);
+    transformed_mesh_t transformed;
+    transform_mesh(clustered, world_matrix, projection_matrix, 800.0f, 600.0f,
+                   transformed);
+
+    geometry_view_t view;
+    view.world_matrix = world_matrix;
+    view.light.direction = { 0.0f, 0.0f, 1.0f };
+    view.width = 800.0f;
+    view.height = 600.0f;
+
+    // The faces one by one, in the same order
+    std::vector<triangle_t> expected;
+    assemble_faces(clustered, transformed, view, 0,
+                   (uint32_t)clustered.faces.size(), expected);
+    mesh_t unclustered = clustered;
+    unclustered.meshlets.clear();
+    geometry_bins_t bins;
+    std::vector<triangle_t> faces_only;
+    assemble_triangles(bins, unclustered, transformed, view, faces_only);
+    EXPECT_EQ(bins.meshlets_culled, 0u);
+
+    std::vector<triangle_t> triangles;
+    assemble_triangles(bins, clustered, transformed, view, triangles);
+    EXPECT_GT(bins.meshlets_culled, clustered.meshlets.size() / 4);
+    ASSERT_EQ(expected.size(), faces_only.size());
+    ASSERT_EQ(expected.size(), triangles.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            ASSERT_EQ(expected[i].points[j].x, triangles[i].points[j].x);
+            ASSERT_EQ(expected[i].points[j].y, triangles[i].points[j].y);
+        }
+        ASSERT_EQ(expected[i].color, triangles[i].color);
+    }
+}
+
@@ -0,0 +1,133 @@
+#include "gtest/gtest.h"
+#include "lod.h"
+#include "mesh.h"
+#include "test-meshes.h"
+
+#include <cmath>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+// Sphere with meshlets, as a loaded mesh has them
+static mesh_t make_lod_sphere_mesh(int rings, int segments)
+{
+    mesh_t sphere = make_sphere_mesh(rings, segments);
+    mesh_build_meshlets(sphere);
+    return sphere;
+}
+
+// Every vertex close to the unit sphere, no face turned inward
+static void expect_sphere_shape(const mesh_t& level, float tolerance)
+{
+    for (const vec3_t& vertex : level.vertices)
+    {
+        EXPECT_NEAR(vertex.length(), 1.0f, tolerance);
+    }
+    for (const face_t& face : level.faces)
+    {
+        for (int index : face.data)
+        {
+            ASSERT_GE(index, 1);
+            ASSERT_LE(index, (int)level.vertices.size());
+        }
+        vec3_t a = level.vertices[face.a - 1];
+        vec3_t normal = (level.vertices[face.b - 1] - a)
+            .cross_product(level.vertices[face.c - 1] - a);
+        EXPECT_GE(normal.dot_product(a), 0.0f);
+    }
+}
+
+TEST(Lod, simplify_reaches_target)
+{
+    mesh_t sphere = make_lod_sphere_mesh(24, 48);
+    uint32_t target = (uint32_t)sphere.faces.size() / 4;
+
+    mesh_t simplified;
+    EXPECT_TRUE(simplify_mesh(sphere, target, simplified));
+    EXPECT_LE(simplified.faces.size(), target);
+    EXPECT_GE(simplified.faces.size(), target - 2); // One collapse at a time
+    EXPECT_LT(simplified.vertices.size(), sphere.vertices.size());
+    expect_sphere_shape(simplified, 0.05f);
+}
+
+TEST(Lod, build_chain)
+{
+    mesh_t sphere = make_lod_sphere_mesh(24, 48);
+    mesh_build_lods(sphere);
+    ASSERT_EQ(sphere.lods.size(), (size_t)LOD_LEVELS);
+
+    size_t faces = sphere.faces.size();
+    for (int level = 0; level < LOD_LEVELS; ++level)
+    {
+        const mesh_t& lod = sphere.lods[level];
+        EXPECT_LE(lod.faces.size(), faces >> (level + 1));
+        EXPECT_EQ(lod.face_normals.size(), lod.faces.size());
+        EXPECT_FALSE(lod.meshlets.empty());
+        EXPECT_GT(lod.sphere_radius, 0.9f);
+        expect_sphere_shape(lod, 0.15f);
+    }
+
+    // Too few faces to simplify
+    mesh_t cube = make_cube_mesh();
+    mesh_build_lods(cube);
+    EXPECT_TRUE(cube.lods.empty());
+}
+
+TEST(Lod, select_by_screen_size)
+{
+    mesh_t sphere = make_lod_sphere_mesh(24, 48);
+    EXPECT_EQ(&mesh_select_lod(sphere, 1.0f), &sphere); // No levels
+
+    mesh_build_lods(sphere);
+    EXPECT_EQ(&mesh_select_lod(sphere, 1000.0f), &sphere);
+    EXPECT_EQ(&mesh_select_lod(sphere, 1.0f), &sphere.lods.back());
+
+    // Each level once its faces fit in the circle
+    for (const mesh_t& lod : sphere.lods)
+    {
+        float radius = sqrtf(lod.faces.size() * LOD_PIXELS_PER_FACE /
+                             3.14159265f) + 0.5f;
+        const mesh_t& selected = mesh_select_lod(sphere, radius);
+        EXPECT_LE(selected.faces.size(), lod.faces.size());
+        EXPECT_GE(selected.faces.size(), lod.faces.size() / 2);
+    }
+}
+
+TEST(Lod, save_and_load)
+{
+    mesh_t sphere = make_lod_sphere_mesh(24, 48);
+    mesh_build_lods(sphere);
+    const char* filepath = "lod-test.lod";
+    ASSERT_TRUE(mesh_save_lods(sphere, filepath));
+
+    mesh_t loaded = make_lod_sphere_mesh(24, 48);
+    ASSERT_TRUE(mesh_load_lods(loaded, filepath));
+    ASSERT_EQ(loaded.lods.size(), sphere.lods.size());
+    for (size_t level = 0; level < sphere.lods.size(); ++level)
+    {
+        const mesh_t& expected = sphere.lods[level];
+        const mesh_t& lod = loaded.lods[level];
+        ASSERT_EQ(lod.vertices.size(), expected.vertices.size());
+        ASSERT_EQ(lod.faces.size(), expected.faces.size());
+        for (size_t i = 0; i < lod.faces.size(); ++i)
+        {
+            EXPECT_EQ(lod.faces[i].a, expected.faces[i].a);
+            EXPECT_EQ(lod.faces[i].b, expected.faces[i].b);
+            EXPECT_EQ(lod.faces[i].c, expected.faces[i].c);
+        }
+        EXPECT_EQ(lod.meshlets.size(), expected.meshlets.size());
+        EXPECT_EQ(lod.sphere_radius, expected.sphere_radius);
+    }
+
+    // Built for another mesh
+    mesh_t other = make_lod_sphere_mesh(12, 24);
+    EXPECT_FALSE(mesh_load_lods(other, filepath));
+    EXPECT_TRUE(other.lods.empty());
+
+    // Same counts, one vertex moved
+    mesh_t moved = make_lod_sphere_mesh(24, 48);
+    moved.vertices[100].x += 0.01f;
+    EXPECT_FALSE(mesh_load_lods(moved, filepath));
+    EXPECT_TRUE(moved.lods.empty());
+    remove(filepath);
+}
@@ -0,0 +1,142 @@
+#include "gtest/gtest.h"
+#include "matrix.h"
+
+#include <cstdlib>
+#include <vector>
+
+static mat4_t test_world_matrix()
+{
+    mat4_t world_matrix = mat4_make_rotation_x(0.3f).mul_mat4(
+        mat4_make_scale(1.5f, 0.5f, 2.0f));
+    world_matrix = mat4_make_rotation_y(1.1f).mul_mat4(world_matrix);
+    return mat4_make_translation(0.25f, -0.5f, 6.0f).mul_mat4(world_matrix);
+}
+
+TEST(Matrix, transform_points_matches_mul_vec4)
+{
+    // Not a multiple of 8, the last points take the scalar path
+    const uint32_t count = 21;
+    std::vector<float> streams[3];
+    srand(5);
+    for (std::vector<float>& stream : streams)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            stream.push_back((rand() % 2000 - 1000) / 100.0f);
+        }
+    }
+    const float* in[3] = { streams[0].data(), streams[1].data(),
+                           streams[2].data() };
+
+    mat4_t world_matrix = test_world_matrix();
+    std::vector<float> results[4];
+    float* out[4] = {};
+    for (int k = 0; k < 4; ++k)
+    {
+        results[k].resize(count);
+        out[k] = results[k].data();
+    }
+    mat4_transform_points(world_matrix, in, count, out);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        vec4_t expected = world_matrix.mul_vec4(
+            { in[0][i], in[1][i], in[2][i], 1.0f });
+        for (int k = 0; k < 4; ++k)
+        {
+            ASSERT_EQ(results[k][i], expected.data[k])
+                << "Point " << i << ", component " << k;
+        }
+    }
+}
+
+TEST(Matrix, project_points_matches_per_vertex_projection)
+{
+    const uint32_t count = 29;
+    std::vector<float> streams[3];
+    srand(6);
+    for (std::vector<float>& stream : streams)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            stream.push_back((rand() % 2000 - 1000) / 1000.0f);
+        }
+    }
+    const float* in[3] = { streams[0].data(), streams[1].data(),
+                           streams[2].data() };
+
+    mat4_t world_matrix = test_world_matrix();
+    mat4_t projection_matrix = mat4_make_perspective(1.0f, 0.75f, 0.1f,
+                                                     100.0f);
+    std::vector<float> world_streams[3];
+    std::vector<float> clip_streams[4];
+    std::vector<float> screen_streams[3];
+    float* world[4] = {};
+    float* clip[4] = {};
+    float* screen[3] = {};
+    for (int k = 0; k < 4; ++k)
+    {
+        clip_streams[k].resize(count);
+        clip[k] = clip_streams[k].data();
+    }
+    for (int k = 0; k < 3; ++k)
+    {
+        world_streams[k].resize(count);
+        screen_streams[k].resize(count);
+        world[k] = world_streams[k].data();
+        screen[k] = screen_streams[k].data();
+    }
+    mat4_transform_points(world_matrix, in, count, world);
+    mat4_project_points(projection_matrix, world, count, 800.0f, 600.0f, clip,
+                        screen);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        // The steps update() takes for a clipped vertex
+        vec4_t point = projection_matrix.mul_vec4(world_matrix.mul_vec4(
+            { in[0][i], in[1][i], in[2][i], 1.0f }));
+        for (int k = 0; k < 4; ++k)
+        {
+            ASSERT_EQ(clip_streams[k][i], point.data[k]) << "Point " << i;
+        }
+        point.x /= point.w;
+        point.y /= point.w;
+        point.z /= point.w;
+        point.y *= -1.0f;
+        point.x *= 800.0f / 2.0f;
+        point.y *= 600.0f / 2.0f;
+        point.x += 800.0f / 2.0f;
+        point.y += 600.0f / 2.0f;
+        ASSERT_EQ(screen_streams[0][i], point.x) << "Point " << i;
+        ASSERT_EQ(screen_streams[1][i], point.y) << "Point " << i;
+        ASSERT_EQ(screen_streams[2][i], point.z) << "Point " << i;
+    }
+}
+
+TEST(Matrix, inverse_affine)
+{
+    const mat4_t scales[] = {
+        mat4_make_scale(1.5f, 0.5f, 2.0f),
+        mat4_make_scale(-1.0f, 1.0f, 1.0f)
+    };
+    for (const mat4_t& scale : scales)
+    {
+        mat4_t world_matrix = mat4_make_rotation_x(0.3f).mul_mat4(scale);
+        world_matrix = mat4_make_translation(0.25f, -0.5f, 6.0f).mul_mat4(
+            world_matrix);
+        EXPECT_EQ(mat4_determinant_3x3(world_matrix) < 0.0f,
+                  scale.m[0][0] < 0.0f);
+
+        mat4_t product = mat4_inverse_affine(world_matrix).mul_mat4(
+            world_matrix);
+        mat4_t identity = mat4_identity();
+        for (int row = 0; row < 4; ++row)
+        {
+            for (int column = 0; column < 4; ++column)
+            {
+                EXPECT_NEAR(product.m[row][column], identity.m[row][column],
+                            1e-5f);
+            }
+        }
+    }
+}
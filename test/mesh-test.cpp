@@ -0,0 +1,176 @@
+#include "gtest/gtest.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "test-meshes.h"
+
+#include <cmath>
+#include <utility>
+#include <vector>
+
+TEST(Mesh, transform_mesh)
+{
+    mesh_t cube = make_cube_mesh();
+
+    mat4_t world_matrix = mat4_make_rotation_y(0.7f).mul_mat4(
+        mat4_make_scale(2.0f, 1.0f, 0.5f));
+    world_matrix = mat4_make_translation(0.5f, -1.0f, 5.0f).mul_mat4(
+        world_matrix);
+    mat4_t projection_matrix = mat4_make_perspective(1.0f, 0.75f, 0.1f,
+                                                     100.0f);
+
+    transformed_mesh_t transformed;
+    transform_mesh(cube, world_matrix, projection_matrix, 800.0f, 600.0f,
+                   transformed);
+    ASSERT_EQ(transformed.world[0].size(), cube.vertices.size());
+    ASSERT_EQ(transformed.clip[3].size(), cube.vertices.size());
+
+    // Same as transforming every face corner on its own
+    for (const face_t& face : cube.faces)
+    {
+        for (int index : face.data)
+        {
+            vec4_t world = world_matrix.mul_vec4(
+                cube.vertices[index - 1].to_vec4());
+            vec4_t clip = projection_matrix.mul_vec4(world);
+            vec4_t cached_world = transformed_world(transformed, index - 1);
+            vec4_t cached_clip = transformed_clip(transformed, index - 1);
+            for (int k = 0; k < 4; ++k)
+            {
+                EXPECT_EQ(cached_world.data[k], world.data[k]);
+                EXPECT_EQ(cached_clip.data[k], clip.data[k]);
+            }
+        }
+    }
+
+    // The SoA storage mode gives the same vertex cache
+    mesh_t soa_cube = cube;
+    mesh_store_soa(soa_cube);
+    EXPECT_TRUE(soa_cube.vertices.empty());
+    EXPECT_EQ(mesh_vertex_count(soa_cube), (uint32_t)N_CUBE_VERTICES);
+    transformed_mesh_t soa_transformed;
+    transform_mesh(soa_cube, world_matrix, projection_matrix, 800.0f, 600.0f,
+                   soa_transformed);
+    for (int k = 0; k < 3; ++k)
+    {
+        EXPECT_EQ(soa_transformed.screen[k], transformed.screen[k]);
+    }
+    EXPECT_EQ(soa_transformed.clip[3], transformed.clip[3]);
+}
+
+TEST(Mesh, face_planes)
+{
+    mesh_t cube = {};
+    cube.vertices.assign(cube_vertices, cube_vertices + N_CUBE_VERTICES);
+    cube.faces.assign(cube_faces, cube_faces + N_CUBE_FACES);
+    mesh_compute_face_planes(cube);
+    ASSERT_EQ(cube.face_normals.size(), cube.faces.size());
+    ASSERT_EQ(cube.face_distances.size(), cube.faces.size());
+
+    for (size_t i = 0; i < cube.faces.size(); ++i)
+    {
+        // Every corner on the plane, the cube center behind it
+        for (int index : cube.faces[i].data)
+        {
+            EXPECT_FLOAT_EQ(cube.face_normals[i].dot_product(
+                                cube.vertices[index - 1]),
+                            cube.face_distances[i]);
+        }
+        EXPECT_LT(-cube.face_distances[i], 0.0f);
+    }
+}
+
+TEST(Mesh, bounds)
+{
+    mesh_t cube = {};
+    cube.vertices.assign(cube_vertices, cube_vertices + N_CUBE_VERTICES);
+    mesh_compute_bounds(cube);
+    EXPECT_EQ(cube.bounds_min.x, -1.0f);
+    EXPECT_EQ(cube.bounds_min.y, -1.0f);
+    EXPECT_EQ(cube.bounds_min.z, -1.0f);
+    EXPECT_EQ(cube.bounds_max.x, 1.0f);
+    EXPECT_EQ(cube.bounds_max.y, 1.0f);
+    EXPECT_EQ(cube.bounds_max.z, 1.0f);
+    EXPECT_EQ(cube.sphere_center.x, 0.0f);
+    EXPECT_FLOAT_EQ(cube.sphere_radius, sqrtf(3.0f));
+}
+
+TEST(Mesh, meshlets)
+{
+    mesh_t sphere = make_sphere_mesh(24, 48);
+    std::vector<face_t> faces = sphere.faces;
+    mesh_build_meshlets(sphere);
+
+    // Every face once, in meshlet order, with its plane
+    ASSERT_EQ(sphere.faces.size(), faces.size());
+    ASSERT_GE(sphere.meshlets.size(), faces.size() / MESHLET_MAX_FACES);
+    std::vector<int> seen(faces.size(), 0);
+    uint32_t next = 0;
+    for (const meshlet_t& meshlet : sphere.meshlets)
+    {
+        EXPECT_EQ(meshlet.first_face, next);
+        EXPECT_GT(meshlet.face_count, 0u);
+        EXPECT_LE(meshlet.face_count, (uint32_t)MESHLET_MAX_FACES);
+        next += meshlet.face_count;
+        for (uint32_t i = meshlet.first_face; i < next; ++i)
+        {
+            const face_t& face = sphere.faces[i];
+            vec3_t a = sphere.vertices[face.a - 1];
+            vec3_t normal = (sphere.vertices[face.b - 1] - a)
+                .cross_product(sphere.vertices[face.c - 1] - a);
+            EXPECT_EQ(sphere.face_normals[i].x, normal.x);
+            EXPECT_EQ(sphere.face_distances[i], normal.dot_product(a));
+            for (int index : face.data)
+            {
+                vec3_t offset = sphere.vertices[index - 1] - meshlet.center;
+                EXPECT_LE(offset.length(), meshlet.radius * 1.0001f);
+            }
+        }
+    }
+    EXPECT_EQ(next, faces.size());
+    for (const face_t& face : faces)
+    {
+        for (size_t i = 0; i < sphere.faces.size(); ++i)
+        {
+            if (sphere.faces[i].a == face.a && sphere.faces[i].b == face.b &&
+                sphere.faces[i].c == face.c)
+            {
+                ++seen[i];
+            }
+        }
+    }
+    for (int count : seen)
+    {
+        EXPECT_EQ(count, 1);
+    }
+
+    // A culled meshlet only holds faces the camera sees from behind
+    uint32_t culled = 0;
+    const vec3_t cameras[] = {
+        { 0.0f, 0.0f, -5.0f }, { 3.0f, 2.0f, 1.0f }, { 0.0f, 20.0f, 0.0f },
+        { -1.5f, -0.5f, 0.3f }
+    };
+    for (const vec3_t& camera : cameras)
+    {
+        for (float facing : { 1.0f, -1.0f })
+        {
+            for (const meshlet_t& meshlet : sphere.meshlets)
+            {
+                if (!meshlet_backfacing(meshlet, camera, facing))
+                {
+                    continue;
+                }
+                ++culled;
+                for (uint32_t i = meshlet.first_face;
+                     i < meshlet.first_face + meshlet.face_count; ++i)
+                {
+                    float camera_side = sphere.face_normals[i].dot_product(
+                        camera) - sphere.face_distances[i];
+                    EXPECT_LE(facing * camera_side, 0.0f);
+                }
+            }
+        }
+    }
+    // Roughly a third of the meshlets face away from a camera outside
+    EXPECT_GT(culled, sphere.meshlets.size());
+}
+
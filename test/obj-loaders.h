@@ -0,0 +1,88 @@
+#pragma once
+
+#include "mesh.h"
+#include "obj_parser.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Loaders shared by the parser tests and the parser benchmark
+
+#ifndef OBJ_DIR
+#define OBJ_DIR "obj"
+#endif
+
+// The loader as it was: fgets, then sscanf and strtol per line
+inline bool parse_with_libc(const char* filepath, mesh_t& out_mesh)
+{
+    FILE* file_ptr = fopen(filepath, "r");
+    if (!file_ptr)
+    {
+        return false;
+    }
+
+    char line[4096];
+    std::vector<tex2_t> texcoords;
+    while (fgets(line, sizeof(line), file_ptr))
+    {
+        if (strncmp(line, "v ", 2) == 0)
+        {
+            vec3_t vertex = {};
+            sscanf(line, "v %f %f %f", &vertex.x, &vertex.y, &vertex.z);
+            out_mesh.vertices.push_back(vertex);
+        }
+        else if (strncmp(line, "vt ", 3) == 0)
+        {
+            tex2_t texcoord = {};
+            sscanf(line, "vt %f %f", &texcoord.u, &texcoord.v);
+            texcoords.push_back(texcoord);
+        }
+        else if (strncmp(line, "f ", 2) == 0)
+        {
+            std::vector<int> vertices;
+            std::vector<int> uvs;
+            for (char* token = strtok(line + 2, " \t\r\n"); token;
+                 token = strtok(nullptr, " \t\r\n"))
+            {
+                char* slash = nullptr;
+                vertices.push_back((int)strtol(token, &slash, 10));
+                uvs.push_back(*slash == '/' && slash[1] != '/'
+                                  ? (int)strtol(slash + 1, nullptr, 10)
+                                  : 0);
+            }
+            for (size_t i = 1; i + 1 < vertices.size(); ++i)
+            {
+                size_t fan[3] = { 0, i, i + 1 };
+                face_t face = {};
+                tex2_t* face_uvs[3] = { &face.a_uv, &face.b_uv, &face.c_uv };
+                for (int j = 0; j < 3; ++j)
+                {
+                    face.data[j] = vertices[fan[j]];
+                    if (uvs[fan[j]])
+                    {
+                        *face_uvs[j] = texcoords[uvs[fan[j]] - 1];
+                    }
+                }
+                face.color = 0xFFFFFFFF;
+                out_mesh.faces.push_back(face);
+            }
+        }
+    }
+    fclose(file_ptr);
+    return true;
+}
+
+inline bool parse_mapped(const char* filepath, mesh_t& out_mesh,
+                         uint32_t chunk_count = 0)
+{
+    mapped_file_t file;
+    if (!map_file(filepath, file))
+    {
+        return false;
+    }
+    bool result = obj_parse(file.data, file.size, out_mesh, chunk_count);
+    unmap_file(file);
+    return result;
+}
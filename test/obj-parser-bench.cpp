@@ -0,0 +1,54 @@
+#include "mesh.h"
+#include "obj-loaders.h"
+#include "obj_parser.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+// Throughput of the loaders on the largest files, best of a few runs. Not a
+// test: run by hand, on a quiet machine.
+int main()
+{
+    const char* names[] = { "roi.obj", "symphysis.obj" };
+    for (const char* name : names)
+    {
+        std::string filepath = std::string(OBJ_DIR) + "/" + name;
+        mapped_file_t file;
+        if (!map_file(filepath.c_str(), file))
+        {
+            fprintf(stderr, "Cannot open %s\n", filepath.c_str());
+            return 1;
+        }
+        double megabytes = file.size / (1024.0 * 1024.0);
+        unmap_file(file);
+
+        // fgets + sscanf, one chunk, chunks in parallel
+        double best[3] = { 1e9, 1e9, 1e9 };
+        for (int run = 0; run < 3; ++run)
+        {
+            for (int loader = 0; loader < 3; ++loader)
+            {
+                mesh_t mesh = {};
+                auto start = std::chrono::steady_clock::now();
+                bool result = loader == 0
+                    ? parse_with_libc(filepath.c_str(), mesh)
+                    : parse_mapped(filepath.c_str(), mesh, loader == 1 ? 1 : 0);
+                std::chrono::duration<double> seconds =
+                    std::chrono::steady_clock::now() - start;
+                if (!result)
+                {
+                    fprintf(stderr, "Cannot parse %s\n", filepath.c_str());
+                    return 1;
+                }
+                best[loader] = std::min(best[loader], seconds.count());
+            }
+        }
+        printf("%s, %.1f MB: fgets + sscanf %.0f MB/s, mapped %.0f MB/s, "
+               "%u threads %.0f MB/s\n", name, megabytes, megabytes / best[0],
+               megabytes / best[1], thread_count(), megabytes / best[2]);
+    }
+    return 0;
+}
@@ -0,0 +1,234 @@
+#include "gtest/gtest.h"
+#include "mesh.h"
+#include "obj-loaders.h"
+#include "obj_parser.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const char* OBJ_FILES[] = {
+    "airboat.obj", "al.obj", "cessna.obj", "cube.obj", "diamond.obj",
+    "dodecahedron.obj", "gourd.obj", "humanoid_quad.obj", "humanoid_tri.obj",
+    "icosahedron.obj", "lamp.obj", "magnolia.obj", "octahedron.obj",
+    "power_lines.obj", "pyramid.obj", "roi.obj", "sandal.obj", "shuttle.obj",
+    "skyscraper.obj", "slot_machine.obj", "symphysis.obj", "teapot.obj",
+    "tetrahedron.obj", "trumpet.obj", "violin_case.obj"
+};
+
+static bool parse_text(const std::string& text, mesh_t& out_mesh,
+                       uint32_t chunk_count = 0)
+{
+    return obj_parse(text.data(), text.size(), out_mesh, chunk_count);
+}
+
+static void expect_same_mesh(const mesh_t& mesh, const mesh_t& expected,
+                             const char* name)
+{
+    ASSERT_EQ(mesh.vertices.size(), expected.vertices.size()) << name;
+    for (size_t i = 0; i < mesh.vertices.size(); ++i)
+    {
+        ASSERT_EQ(memcmp(&mesh.vertices[i], &expected.vertices[i],
+                         sizeof(vec3_t)), 0) << name << ", vertex " << i;
+    }
+    ASSERT_EQ(mesh.faces.size(), expected.faces.size()) << name;
+    for (size_t i = 0; i < mesh.faces.size(); ++i)
+    {
+        ASSERT_EQ(memcmp(&mesh.faces[i], &expected.faces[i], sizeof(face_t)),
+                  0) << name << ", face " << i;
+    }
+}
+
+TEST(ObjParser, face_formats)
+{
+    std::string text =
+        "# comment\r\n"
+        "v 0 0 0\r\n"
+        "v 1.5 -2 3e-1\n"
+        "  v\t+2 0.25 -1.0E2\n"
+        "v 3 3 3\n"
+        "vt 0.25 0.75\n"
+        "vt 0.5 # no v\n"
+        "vt 0.125 0.5 0\n"
+        "vn 0 0 1\n"
+        "f 1 2 3\n"
+        "f 1/1 2/2 3/1\n"
+        "f 1//1 2//1 4//1 # trailing comment\n"
+        "f 1/2/1 3/1/1 4/2/1\n"
+        "f -4 -3 -2 -1\n"
+        "o other\n"
+        "f 2 3 4";
+    mesh_t mesh = {};
+    ASSERT_TRUE(parse_text(text, mesh));
+    ASSERT_EQ(mesh.vertices.size(), 4u);
+    EXPECT_EQ(mesh.vertices[1].x, 1.5f);
+    EXPECT_EQ(mesh.vertices[1].z, 0.3f);
+    EXPECT_EQ(mesh.vertices[2].x, 2.0f);
+    EXPECT_EQ(mesh.vertices[2].z, -100.0f);
+
+    // The quad splits in two
+    const int expected[][3] = { { 1, 2, 3 }, { 1, 2, 3 }, { 1, 2, 4 },
+                                { 1, 3, 4 }, { 1, 2, 3 }, { 1, 3, 4 },
+                                { 2, 3, 4 } };
+    ASSERT_EQ(mesh.faces.size(), 7u);
+    for (size_t i = 0; i < mesh.faces.size(); ++i)
+    {
+        EXPECT_EQ(mesh.faces[i].a, expected[i][0]) << "Face " << i;
+        EXPECT_EQ(mesh.faces[i].b, expected[i][1]) << "Face " << i;
+        EXPECT_EQ(mesh.faces[i].c, expected[i][2]) << "Face " << i;
+        EXPECT_EQ(mesh.faces[i].color, 0xFFFFFFFF);
+    }
+    EXPECT_EQ(mesh.faces[0].a_uv.u, 0.0f);
+    EXPECT_EQ(mesh.faces[1].b_uv.u, 0.5f);
+    EXPECT_EQ(mesh.faces[1].b_uv.v, 0.0f);
+    EXPECT_EQ(mesh.faces[1].c_uv.v, 0.75f);
+    EXPECT_EQ(mesh.faces[3].a_uv.u, 0.5f);
+    EXPECT_EQ(mesh.faces[3].b_uv.v, 0.75f);
+}
+
+TEST(ObjParser, floats_round_like_strtof)
+{
+    // Short and long mantissas, small and large exponents
+    std::string text;
+    std::vector<std::string> numbers;
+    srand(42);
+    for (int i = 0; i < 30000; ++i)
+    {
+        char number[64];
+        int digits = 1 + rand() % 18;
+        int point = rand() % (digits + 1);
+        int length = 0;
+        number[length++] = rand() % 2 ? '-' : '0';
+        for (int j = 0; j < digits; ++j)
+        {
+            if (j == point)
+            {
+                number[length++] = '.';
+            }
+            number[length++] = (char)('0' + rand() % 10);
+        }
+        if (rand() % 4 == 0)
+        {
+            length += snprintf(number + length, sizeof(number) - length,
+                               "e%d", rand() % 31 - 15);
+        }
+        number[length] = '\0';
+        numbers.push_back(number);
+        if (numbers.size() % 3 == 0)
+        {
+            size_t last = numbers.size() - 1;
+            text += "v " + numbers[last - 2] + " " + numbers[last - 1] + " " +
+                    numbers[last] + "\n";
+        }
+    }
+
+    mesh_t mesh = {};
+    ASSERT_TRUE(parse_text(text, mesh));
+    ASSERT_EQ(mesh.vertices.size(), numbers.size() / 3);
+    for (size_t i = 0; i < mesh.vertices.size(); ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            const std::string& number = numbers[i * 3 + j];
+            float expected = strtof(number.c_str(), nullptr);
+            ASSERT_EQ(memcmp(&mesh.vertices[i].data[j], &expected,
+                             sizeof(float)), 0) << number;
+        }
+    }
+}
+
+TEST(ObjParser, rejects_malformed_lines)
+{
+    const char* texts[] = {
+        "v 1 2\n",
+        "v 1 2 x\n",
+        "vt 0.5 abc\n",
+        "vt 0.5 0.5 0 abc\n",
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n",
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 0 1 2\n",
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nf -4 1 2\n",
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1/1 2/1 3/1\n",
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nf 1/0 2/1 3/1\n",
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2\n",
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 x3\n",
+        "f 1 2 3\nv 0 0 0\nv 1 0 0\nv 0 1 0\n"
+    };
+    for (const char* text : texts)
+    {
+        mesh_t mesh = {};
+        EXPECT_FALSE(parse_text(text, mesh)) << text;
+    }
+
+    mesh_t mesh = {};
+    EXPECT_TRUE(parse_text("", mesh));
+    EXPECT_TRUE(mesh.faces.empty());
+}
+
+TEST(ObjParser, matches_libc_parsing)
+{
+    for (const char* name : OBJ_FILES)
+    {
+        std::string filepath = std::string(OBJ_DIR) + "/" + name;
+        mesh_t expected = {};
+        ASSERT_TRUE(parse_with_libc(filepath.c_str(), expected)) << filepath;
+        mesh_t mesh = {};
+        if (strcmp(name, "pyramid.obj") == 0)
+        {
+            // Its faces use a 6th vertex, of 5
+            EXPECT_FALSE(parse_mapped(filepath.c_str(), mesh));
+            continue;
+        }
+        ASSERT_TRUE(parse_mapped(filepath.c_str(), mesh)) << filepath;
+        expect_same_mesh(mesh, expected, name);
+    }
+}
+
+TEST(ObjParser, chunks_match_serial_parse)
+{
+    for (const char* name : OBJ_FILES)
+    {
+        std::string filepath = std::string(OBJ_DIR) + "/" + name;
+        mesh_t expected = {};
+        bool result = parse_mapped(filepath.c_str(), expected, 1);
+        for (uint32_t chunk_count : { 2u, 7u, 64u, 1000u })
+        {
+            mesh_t mesh = {};
+            ASSERT_EQ(parse_mapped(filepath.c_str(), mesh, chunk_count),
+                      result) << name << ", " << chunk_count << " chunks";
+            expect_same_mesh(mesh, expected, name);
+        }
+    }
+
+    // Relative indices and texture coordinates reaching back across chunks
+    std::string text;
+    for (int i = 0; i < 50; ++i)
+    {
+        text += "v " + std::to_string(i) + " 0 0\nvt 0." + std::to_string(i) +
+                " 0.5\n";
+        if (i >= 2)
+        {
+            text += "f -3/-3 -2/-2 -1/-1 " + std::to_string(i) + "/" +
+                    std::to_string(i - 1) + "\n";
+        }
+    }
+    mesh_t expected = {};
+    ASSERT_TRUE(parse_text(text, expected, 1));
+    for (uint32_t chunk_count = 2; chunk_count < 200; chunk_count += 13)
+    {
+        mesh_t mesh = {};
+        ASSERT_TRUE(parse_text(text, mesh, chunk_count));
+        expect_same_mesh(mesh, expected, "relative indices");
+    }
+
+    // An index defined later fails, and the mesh is left alone
+    text += "f 1 2 52\nv 0 0 0\nv 1 1 1\n";
+    for (uint32_t chunk_count : { 1u, 2u, 5u })
+    {
+        mesh_t mesh = {};
+        EXPECT_FALSE(parse_text(text, mesh, chunk_count));
+        EXPECT_TRUE(mesh.vertices.empty());
+        EXPECT_TRUE(mesh.faces.empty());
+    }
+}
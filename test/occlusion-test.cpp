@@ -0,0 +1,137 @@
+#include "gtest/gtest.h"
+#include "display.h"
+#include "geometry.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "occlusion.h"
+#include "scene.h"
+#include "test-meshes.h"
+#include "tiler.h"
+
+#include <cstdlib>
+#include <vector>
+
+// Cube with a random color per face, and meshlets
+static mesh_t make_colored_cube_mesh()
+{
+    mesh_t cube = make_cube_mesh();
+    for (face_t& face : cube.faces)
+    {
+        face.color = 0xFF000000 | (uint32_t)rand();
+    }
+    mesh_build_meshlets(cube);
+    return cube;
+}
+
+TEST(Occlusion, boxes_behind_a_wall)
+{
+    mat4_t projection_matrix = mat4_make_perspective(1.0f, 0.75f, 0.1f,
+                                                     100.0f);
+    occlusion_buffer_t buffer;
+    occlusion_clear(buffer, 800.0f, 600.0f, projection_matrix);
+
+    // A wall facing the camera at z = 5, 4 wide and 3 high
+    mesh_t cube = make_colored_cube_mesh();
+    mat4_t wall_matrix = mat4_make_translation(0.0f, 0.0f, 5.0f).mul_mat4(
+        mat4_make_scale(2.0f, 1.5f, 0.1f));
+    transformed_mesh_t transformed;
+    transform_mesh(cube, wall_matrix, projection_matrix, 800.0f, 600.0f,
+                   transformed);
+    geometry_view_t view;
+    view.world_matrix = wall_matrix;
+    view.width = 800.0f;
+    view.height = 600.0f;
+    std::vector<triangle_t> triangles;
+    assemble_faces(cube, transformed, view, 0, (uint32_t)cube.faces.size(),
+                   triangles);
+    occlusion_draw_triangles(buffer, triangles);
+
+    const vec3_t unit_min = { -1.0f, -1.0f, -1.0f };
+    const vec3_t unit_max = { 1.0f, 1.0f, 1.0f };
+    struct
+    {
+        vec3_t translation;
+        bool   hidden;
+    } cases[] = {
+        { {  0.0f, 0.0f, 10.0f }, true  }, // Behind the middle
+        { {  3.0f, 2.0f, 20.0f }, true  }, // Far behind a corner
+        { {  0.0f, 0.0f,  2.0f }, false }, // In front
+        { {  0.0f, 0.0f,  5.5f }, false }, // Through the wall
+        { { 14.0f, 0.0f, 20.0f }, false }, // Beside
+        { {  4.5f, 0.0f, 10.0f }, false }  // Sticking out on the right
+    };
+    for (const auto& test_case : cases)
+    {
+        mat4_t world_matrix = mat4_make_translation(test_case.translation.x,
+                                                    test_case.translation.y,
+                                                    test_case.translation.z);
+        EXPECT_EQ(occlusion_test_box(buffer, world_matrix, unit_min, unit_max),
+                  test_case.hidden)
+            << test_case.translation.x << ", " << test_case.translation.y
+            << ", " << test_case.translation.z;
+        EXPECT_EQ(occlusion_test_sphere(buffer, test_case.translation, 1.0f),
+                  test_case.hidden);
+    }
+}
+
+TEST(Occlusion, scene_image_unchanged)
+{
+    srand(3);
+    scene_t scene;
+    scene.meshes.push_back(make_colored_cube_mesh());
+
+    // A wall in front, a grid of cubes behind it and around it
+    scene_object_t wall;
+    wall.scale = { 3.0f, 2.0f, 0.2f };
+    wall.translation = { 0.0f, 0.0f, 6.0f };
+    wall.occluder = true;
+    scene.objects.push_back(wall);
+    for (int y = -3; y <= 3; ++y)
+    {
+        for (int x = -5; x <= 5; ++x)
+        {
+            scene_object_t object;
+            object.scale = { 0.4f, 0.4f, 0.4f };
+            object.rotation = { 0.1f * x, 0.2f * y, 0.0f };
+            object.translation = { 1.5f * x, 1.5f * y, 12.0f };
+            scene.objects.push_back(object);
+        }
+    }
+
+    mat4_t projection_matrix = mat4_make_perspective(1.0f, 0.75f, 0.1f,
+                                                     100.0f);
+    geometry_view_t view;
+    view.light.direction = { 0.0f, 0.0f, 1.0f };
+    view.width = 200.0f;
+    view.height = 150.0f;
+
+    ColorBuffer color_buffer = {};
+    color_buffer.width = 200;
+    color_buffer.height = 150;
+    uint32_t size = color_buffer.width * color_buffer.height;
+    color_buffer.memory = (uint32_t*)malloc(sizeof(uint32_t) * size);
+    z_buffer = malloc(sizeof(float) * size);
+    pipeline_state_t state = {};
+
+    std::vector<uint32_t> images[2];
+    uint32_t occluded[2] = {};
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        scene.occlusion_culling = pass == 1;
+        std::vector<triangle_t> triangles;
+        scene_assemble(scene, view, projection_matrix, triangles);
+        occluded[pass] = scene.objects_occluded;
+
+        clear_color_buffer(color_buffer, 0xFF18191A);
+        clear_z_buffer(color_buffer);
+        render_triangles(color_buffer, triangles, state, nullptr);
+        images[pass].assign(color_buffer.memory, color_buffer.memory + size);
+    }
+    EXPECT_EQ(occluded[0], 0u);
+    EXPECT_GT(occluded[1], 4u);
+    EXPECT_EQ(images[0], images[1]);
+
+    free(color_buffer.memory);
+    free(z_buffer);
+    z_buffer = nullptr;
+}
@@ -0,0 +1,122 @@
+#include "gtest/gtest.h"
+#include "mesh.h"
+#include "optimize.h"
+#include "test-meshes.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Sphere with its faces in random order
+static mesh_t make_shuffled_sphere_mesh(int rings, int segments)
+{
+    mesh_t sphere = make_sphere_mesh(rings, segments);
+    std::mt19937 random(42);
+    std::shuffle(sphere.faces.begin(), sphere.faces.end(), random);
+    mesh_compute_face_planes(sphere);
+    return sphere;
+}
+
+// Corner positions of faces [first, first + count), sorted
+static std::vector<std::array<float, 9>> face_positions(const mesh_t& in_mesh,
+                                                        uint32_t first,
+                                                        uint32_t count)
+{
+    std::vector<std::array<float, 9>> positions;
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        std::array<float, 9> corners;
+        for (int j = 0; j < 3; ++j)
+        {
+            vec3_t p = mesh_position(in_mesh, in_mesh.faces[i].data[j] - 1);
+            corners[j * 3 + 0] = p.x;
+            corners[j * 3 + 1] = p.y;
+            corners[j * 3 + 2] = p.z;
+        }
+        positions.push_back(corners);
+    }
+    std::sort(positions.begin(), positions.end());
+    return positions;
+}
+
+TEST(Optimize, reorders_faces_for_vertex_cache)
+{
+    mesh_t sphere = make_shuffled_sphere_mesh(24, 48);
+    mesh_t optimized = sphere;
+    mesh_optimize_faces(optimized);
+
+    // Same faces, far fewer misses
+    uint32_t face_count = (uint32_t)sphere.faces.size();
+    EXPECT_EQ(face_positions(optimized, 0, face_count),
+              face_positions(sphere, 0, face_count));
+    EXPECT_EQ(optimized.vertices.size(), sphere.vertices.size());
+    float before = mesh_cache_miss_ratio(sphere, VERTEX_CACHE_SIZE);
+    float after = mesh_cache_miss_ratio(optimized, VERTEX_CACHE_SIZE);
+    EXPECT_GT(before, 2.0f);
+    EXPECT_LT(after, 0.8f);
+
+    // Planes follow the faces, vertices come in the order they are used
+    for (uint32_t i = 0; i < face_count; ++i)
+    {
+        vec3_t a = optimized.vertices[optimized.faces[i].a - 1];
+        EXPECT_NEAR(optimized.face_normals[i].dot_product(a),
+                    optimized.face_distances[i], 1e-5f);
+    }
+    int next = 1;
+    for (const face_t& face : optimized.faces)
+    {
+        for (int index : face.data)
+        {
+            ASSERT_LE(index, next);
+            next = std::max(next, index + 1);
+        }
+    }
+}
+
+TEST(Optimize, keeps_meshlets)
+{
+    mesh_t sphere = make_shuffled_sphere_mesh(24, 48);
+    mesh_build_meshlets(sphere);
+    mesh_t optimized = sphere;
+    mesh_optimize_faces(optimized);
+    EXPECT_LT(mesh_cache_miss_ratio(optimized, VERTEX_CACHE_SIZE),
+              mesh_cache_miss_ratio(sphere, VERTEX_CACHE_SIZE));
+
+    // Every meshlet keeps its faces, the meshlets still cover the faces in
+    // order
+    ASSERT_EQ(optimized.meshlets.size(), sphere.meshlets.size());
+    uint32_t first_face = 0;
+    for (const meshlet_t& meshlet : optimized.meshlets)
+    {
+        EXPECT_EQ(meshlet.first_face, first_face);
+        first_face += meshlet.face_count;
+
+        auto original = std::find_if(
+            sphere.meshlets.begin(), sphere.meshlets.end(),
+            [&](const meshlet_t& other) {
+                return other.center.x == meshlet.center.x &&
+                       other.center.y == meshlet.center.y &&
+                       other.center.z == meshlet.center.z &&
+                       other.face_count == meshlet.face_count;
+            });
+        ASSERT_NE(original, sphere.meshlets.end());
+        EXPECT_EQ(face_positions(optimized, meshlet.first_face,
+                                 meshlet.face_count),
+                  face_positions(sphere, original->first_face,
+                                 original->face_count));
+    }
+    EXPECT_EQ(first_face, optimized.faces.size());
+}
+
+TEST(Optimize, cache_miss_ratio)
+{
+    mesh_t cube = make_cube_mesh();
+
+    // Every vertex once with a large cache, more with a single entry
+    EXPECT_FLOAT_EQ(mesh_cache_miss_ratio(cube, 32),
+                    (float)N_CUBE_VERTICES / N_CUBE_FACES);
+    EXPECT_GT(mesh_cache_miss_ratio(cube, 1), 2.0f);
+}
@@ -0,0 +1,390 @@
+#include "gtest/gtest.h"
+#include "display.h"
+#include "raster.h"
+
+#include <cstdlib>
+#include <vector>
+
+static void render_random_triangles(ColorBuffer& color_buffer,
+                                    const uint32_t* texture, bool textured)
+{
+    clear_color_buffer(color_buffer, 0xFF000000);
+    clear_z_buffer(color_buffer);
+
+    srand(1234);
+    for (int i = 0; i < 200; ++i)
+    {
+        vec4_t points[3];
+        tex2_t texcoords[3];
+        for (int j = 0; j < 3; ++j)
+        {
+            points[j].x = (float)(rand() % 100 - 10);
+            points[j].y = (float)(rand() % 100 - 10);
+            points[j].z = 0.0f;
+            points[j].w = 1.0f + (rand() % 1000) / 100.0f;
+            texcoords[j].u = (rand() % 1000) / 1000.0f;
+            texcoords[j].v = (rand() % 1000) / 1000.0f;
+        }
+
+        raster_triangle_t triangle;
+        if (!raster_setup_triangle(triangle, color_buffer, points, texcoords))
+        {
+            continue;
+        }
+        if (textured)
+        {
+            raster_textured_triangle(color_buffer, triangle, texture,
+                                     color_buffer_rect(color_buffer));
+        }
+        else
+        {
+            raster_filled_triangle(color_buffer, triangle,
+                                   0xFF000000 | (uint32_t)rand(),
+                                   color_buffer_rect(color_buffer));
+        }
+    }
+}
+
+TEST(Raster, simd_matches_scalar)
+{
+    RASTER_ISA default_isa = raster_get_isa();
+    if (!raster_set_isa(RASTER_ISA::AVX2))
+    {
+        GTEST_SKIP() << "AVX2 not available";
+    }
+
+    ColorBuffer color_buffer = {};
+    color_buffer.width = 83; // Not a multiple of the SIMD width
+    color_buffer.height = 79;
+    uint32_t size = color_buffer.width * color_buffer.height;
+    color_buffer.memory = (uint32_t*)malloc(sizeof(uint32_t) * size);
+    z_buffer = malloc(sizeof(float) * size);
+
+    texture_width = 13;
+    texture_height = 7;
+    std::vector<uint32_t> texture(texture_width * texture_height);
+    for (size_t i = 0; i < texture.size(); ++i)
+    {
+        texture[i] = 0xFF000000 | (uint32_t)(i * 2654435761u);
+    }
+
+    for (bool textured : { false, true })
+    {
+        raster_set_isa(RASTER_ISA::AVX2);
+        render_random_triangles(color_buffer, texture.data(), textured);
+        std::vector<uint32_t> simd_color(color_buffer.memory,
+                                         color_buffer.memory + size);
+        std::vector<float> simd_depth((float*)z_buffer,
+                                         (float*)z_buffer + size);
+
+        raster_set_isa(RASTER_ISA::SCALAR);
+        render_random_triangles(color_buffer, texture.data(), textured);
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            ASSERT_EQ(simd_color[i], color_buffer.memory[i]) << "Pixel " << i;
+            ASSERT_EQ(simd_depth[i], ((float*)z_buffer)[i])
+                << "Pixel " << i;
+        }
+    }
+
+    raster_set_isa(default_isa);
+    free(color_buffer.memory);
+    free(z_buffer);
+    z_buffer = nullptr;
+    texture_width = 0;
+    texture_height = 0;
+}
+
+TEST(Raster, simd_pipelines_match_scalar)
+{
+    RASTER_ISA default_isa = raster_get_isa();
+    if (!raster_set_isa(RASTER_ISA::AVX2))
+    {
+        GTEST_SKIP() << "AVX2 not available";
+    }
+
+    ColorBuffer color_buffer = {};
+    color_buffer.width = 83;
+    color_buffer.height = 79;
+    uint32_t size = color_buffer.width * color_buffer.height;
+    color_buffer.memory = (uint32_t*)malloc(sizeof(uint32_t) * size);
+    z_buffer = malloc(sizeof(float) * size);
+
+    const uint32_t texels[3 * 5] = {
+        0xFF000001, 0xFF000002, 0xFF000003, 0xFF000004, 0xFF000005,
+        0xFF000006, 0xFF000007, 0xFF000008, 0xFF000009, 0xFF00000A,
+        0xFF00000B, 0xFF00000C, 0xFF00000D, 0xFF00000E, 0xFF00000F
+    };
+
+    // Texture coordinates well outside [0, 1] to exercise the wrap modes
+    srand(99);
+    std::vector<triangle_t> triangles(150);
+    std::vector<raster_triangle_t> setups(triangles.size());
+    std::vector<uint8_t> covered(triangles.size());
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            triangles[i].points[j].x = (float)(rand() % 100 - 10);
+            triangles[i].points[j].y = (float)(rand() % 100 - 10);
+            triangles[i].points[j].w = 1.0f + (rand() % 1000) / 100.0f;
+            triangles[i].texcoord[j].u = (rand() % 4000) / 1000.0f - 1.5f;
+            triangles[i].texcoord[j].v = (rand() % 4000) / 1000.0f - 1.5f;
+        }
+        triangles[i].color = 0xFF000000 | (uint32_t)rand();
+        covered[i] = raster_setup_triangle(setups[i], color_buffer,
+                                           triangles[i].points,
+                                           triangles[i].texcoord);
+    }
+
+    raster_batch_t batch = {};
+    batch.triangles = triangles.data();
+    batch.setups = setups.data();
+    batch.covered = covered.data();
+    batch.count = (uint32_t)triangles.size();
+    batch.sampler.texels = texels;
+    batch.sampler.width = 5;
+    batch.sampler.height = 3;
+    batch.bounds = color_buffer_rect(color_buffer);
+
+    uint32_t state_count = NUM_RENDER_MODES * 2 * NUM_DEPTH_FORMATS *
+                           NUM_WRAP_MODES;
+    for (uint32_t index = 0; index < state_count; ++index)
+    {
+        pipeline_state_t state = {};
+        state.render_mode = (RENDER_MODE)(index % NUM_RENDER_MODES);
+        state.depth_test = (index / NUM_RENDER_MODES) % 2 != 0;
+        state.wrap_mode = (WRAP_MODE)(index / NUM_RENDER_MODES / 2 %
+                                      NUM_WRAP_MODES);
+        color_buffer.depth_format = (DEPTH_FORMAT)(
+            index / NUM_RENDER_MODES / 2 / NUM_WRAP_MODES);
+        uint32_t depth_bytes = size *
+                               depth_format_size(color_buffer.depth_format);
+
+        raster_set_isa(RASTER_ISA::AVX2);
+        clear_color_buffer(color_buffer, 0xFF000000);
+        clear_z_buffer(color_buffer);
+        raster_select_pipeline(state, color_buffer.depth_format)(color_buffer,
+                                                                 batch);
+        std::vector<uint32_t> simd_color(color_buffer.memory,
+                                         color_buffer.memory + size);
+        std::vector<uint8_t> simd_depth((uint8_t*)z_buffer,
+                                        (uint8_t*)z_buffer + depth_bytes);
+
+        raster_set_isa(RASTER_ISA::SCALAR);
+        clear_color_buffer(color_buffer, 0xFF000000);
+        clear_z_buffer(color_buffer);
+        raster_select_pipeline(state, color_buffer.depth_format)(color_buffer,
+                                                                 batch);
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            ASSERT_EQ(simd_color[i], color_buffer.memory[i])
+                << "State " << index << ", pixel " << i;
+        }
+        for (uint32_t i = 0; i < depth_bytes; ++i)
+        {
+            ASSERT_EQ(simd_depth[i], ((uint8_t*)z_buffer)[i])
+                << "State " << index << ", depth byte " << i;
+        }
+    }
+
+    raster_set_isa(default_isa);
+    free(color_buffer.memory);
+    free(z_buffer);
+    z_buffer = nullptr;
+}
+
+// Closer than w = 1, as after clipping at a near plane of 0.1: depth is mapped
+// over [near, far] so the unorm formats still keep the order
+TEST(Raster, depth_formats_near_the_camera)
+{
+    ColorBuffer color_buffer = {};
+    color_buffer.width = 16;
+    color_buffer.height = 16;
+    color_buffer.depth_near = 0.1f;
+    color_buffer.depth_far = 100.0f;
+    uint32_t size = color_buffer.width * color_buffer.height;
+    color_buffer.memory = (uint32_t*)malloc(sizeof(uint32_t) * size);
+    rect_t screen = color_buffer_rect(color_buffer);
+
+    const tex2_t texcoords[3] = {};
+    const vec4_t far_points[3] = {
+        { -1.0f, -1.0f, 0.0f, 0.2f }, { 40.0f, -1.0f, 0.0f, 0.2f },
+        { -1.0f, 40.0f, 0.0f, 0.2f }
+    };
+    const vec4_t near_points[3] = {
+        { -1.0f, -1.0f, 0.0f, 0.15f }, { 40.0f, -1.0f, 0.0f, 0.15f },
+        { -1.0f, 40.0f, 0.0f, 0.15f }
+    };
+
+    for (int format = 0; format < NUM_DEPTH_FORMATS; ++format)
+    {
+        set_depth_format(color_buffer, (DEPTH_FORMAT)format);
+        clear_color_buffer(color_buffer, 0xFF000000);
+
+        raster_triangle_t far_triangle;
+        raster_triangle_t near_triangle;
+        ASSERT_TRUE(raster_setup_triangle(far_triangle, color_buffer,
+                                          far_points, texcoords));
+        ASSERT_TRUE(raster_setup_triangle(near_triangle, color_buffer,
+                                          near_points, texcoords));
+
+        // (1/near - 1/w) / (1/near - 1/far)
+        EXPECT_NEAR(near_triangle.min_depth, (10.0f - 1.0f / 0.15f) / 9.99f,
+                    1e-6f);
+        EXPECT_NEAR(far_triangle.min_depth, 5.0f / 9.99f, 1e-6f);
+
+        // The nearer one wins whatever the order
+        raster_filled_triangle(color_buffer, near_triangle, 0xFF0000FF,
+                               screen);
+        raster_filled_triangle(color_buffer, far_triangle, 0xFF00FF00, screen);
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            ASSERT_EQ(color_buffer.memory[i], 0xFF0000FFu)
+                << "Format " << format << ", pixel " << i;
+        }
+        clear_color_buffer(color_buffer, 0xFF000000);
+        clear_z_buffer(color_buffer);
+        raster_filled_triangle(color_buffer, far_triangle, 0xFF00FF00, screen);
+        raster_filled_triangle(color_buffer, near_triangle, 0xFF0000FF,
+                               screen);
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            ASSERT_EQ(color_buffer.memory[i], 0xFF0000FFu)
+                << "Format " << format << ", pixel " << i;
+        }
+    }
+
+    free(color_buffer.memory);
+    free(z_buffer);
+    z_buffer = nullptr;
+}
+
+TEST(Raster, hiz_rejects_hidden_triangles)
+{
+    ColorBuffer color_buffer = {};
+    color_buffer.width = 37;
+    color_buffer.height = 29;
+    uint32_t size = color_buffer.width * color_buffer.height;
+    color_buffer.memory = (uint32_t*)malloc(sizeof(uint32_t) * size);
+    z_buffer = malloc(sizeof(float) * size);
+    hiz_buffer = (float*)malloc(sizeof(float) * hiz_width(color_buffer) *
+                                hiz_height(color_buffer));
+    clear_color_buffer(color_buffer, 0xFF000000);
+    clear_z_buffer(color_buffer);
+    rect_t screen = color_buffer_rect(color_buffer);
+
+    // Near quad over the whole buffer
+    const tex2_t texcoords[3] = {};
+    const vec4_t near_a[3] = {
+        { -1.0f, -1.0f, 0.0f, 2.0f }, { 100.0f, -1.0f, 0.0f, 2.0f },
+        { -1.0f, 100.0f, 0.0f, 2.0f }
+    };
+    raster_triangle_t near_triangle;
+    ASSERT_TRUE(raster_setup_triangle(near_triangle, color_buffer, near_a,
+                                      texcoords));
+    raster_filled_triangle(color_buffer, near_triangle, 0xFF0000FF, screen);
+
+    // Every block fully covered by the near triangle holds its depth
+    EXPECT_FLOAT_EQ(hiz_buffer[0], 0.5f);
+
+    // A farther triangle is rejected without touching the buffers
+    const vec4_t far_points[3] = {
+        { 2.0f, 2.0f, 0.0f, 4.0f }, { 20.0f, 3.0f, 0.0f, 4.0f },
+        { 5.0f, 20.0f, 0.0f, 4.0f }
+    };
+    raster_triangle_t far_triangle;
+    ASSERT_TRUE(raster_setup_triangle(far_triangle, color_buffer, far_points,
+                                      texcoords));
+    EXPECT_FLOAT_EQ(far_triangle.min_depth, 0.75f);
+    raster_filled_triangle(color_buffer, far_triangle, 0xFF00FF00, screen);
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        ASSERT_EQ(color_buffer.memory[i], 0xFF0000FFu) << "Pixel " << i;
+    }
+
+    // A nearer triangle still draws
+    const vec4_t closer_points[3] = {
+        { 2.0f, 2.0f, 0.0f, 1.0f }, { 20.0f, 3.0f, 0.0f, 1.0f },
+        { 5.0f, 20.0f, 0.0f, 1.0f }
+    };
+    raster_triangle_t closer_triangle;
+    ASSERT_TRUE(raster_setup_triangle(closer_triangle, color_buffer,
+                                      closer_points, texcoords));
+    raster_filled_triangle(color_buffer, closer_triangle, 0xFFFF0000, screen);
+    EXPECT_EQ(color_buffer.memory[color_buffer.width * 5 + 5], 0xFFFF0000u);
+
+    free(color_buffer.memory);
+    free(z_buffer);
+    free(hiz_buffer);
+    z_buffer = nullptr;
+    hiz_buffer = nullptr;
+}
+
+TEST(Raster, depth_formats)
+{
+    ColorBuffer color_buffer = {};
+    color_buffer.width = 16;
+    color_buffer.height = 16;
+    uint32_t size = color_buffer.width * color_buffer.height;
+    color_buffer.memory = (uint32_t*)malloc(sizeof(uint32_t) * size);
+    rect_t screen = color_buffer_rect(color_buffer);
+
+    const tex2_t texcoords[3] = {};
+    const vec4_t far_points[3] = {
+        { -1.0f, -1.0f, 0.0f, 4.0f }, { 40.0f, -1.0f, 0.0f, 4.0f },
+        { -1.0f, 40.0f, 0.0f, 4.0f }
+    };
+    const vec4_t near_points[3] = {
+        { -1.0f, -1.0f, 0.0f, 2.0f }, { 40.0f, -1.0f, 0.0f, 2.0f },
+        { -1.0f, 40.0f, 0.0f, 2.0f }
+    };
+
+    for (int format = 0; format < NUM_DEPTH_FORMATS; ++format)
+    {
+        set_depth_format(color_buffer, (DEPTH_FORMAT)format);
+        clear_color_buffer(color_buffer, 0xFF000000);
+        if (color_buffer.depth_format == DEPTH_FORMAT::UNORM24)
+        {
+            ((uint32_t*)z_buffer)[0] |= 0xAB000000; // Spare bits
+        }
+
+        raster_triangle_t far_triangle;
+        raster_triangle_t near_triangle;
+        ASSERT_TRUE(raster_setup_triangle(far_triangle, color_buffer,
+                                          far_points, texcoords));
+        ASSERT_TRUE(raster_setup_triangle(near_triangle, color_buffer,
+                                          near_points, texcoords));
+        raster_filled_triangle(color_buffer, far_triangle, 0xFF00FF00, screen);
+        raster_filled_triangle(color_buffer, near_triangle, 0xFF0000FF,
+                               screen);
+        raster_filled_triangle(color_buffer, far_triangle, 0xFF00FF00, screen);
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            ASSERT_EQ(color_buffer.memory[i], 0xFF0000FFu)
+                << "Format " << format << ", pixel " << i;
+        }
+
+        // Depth 1 - 1/2 in every format
+        switch (color_buffer.depth_format)
+        {
+            case DEPTH_FORMAT::FLOAT32:
+            {
+                EXPECT_FLOAT_EQ(((float*)z_buffer)[0], 0.5f);
+            } break;
+            case DEPTH_FORMAT::UNORM24:
+            {
+                EXPECT_EQ(((uint32_t*)z_buffer)[0], 0xAB800000u);
+                EXPECT_EQ(((uint32_t*)z_buffer)[1], 0x00800000u);
+            } break;
+            case DEPTH_FORMAT::UNORM16:
+            {
+                EXPECT_EQ(((uint16_t*)z_buffer)[0], 0x8000u);
+            } break;
+        }
+    }
+
+    free(color_buffer.memory);
+    free(z_buffer);
+    z_buffer = nullptr;
+}
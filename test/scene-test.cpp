@@ -0,0 +1,116 @@
+#include "gtest/gtest.h"
+#include "geometry.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "scene.h"
+#include "test-meshes.h"
+
+#include <cmath>
+#include <vector>
+
+TEST(Scene, assemble_skips_objects_out_of_view)
+{
+    scene_t scene;
+    scene.meshes.push_back(make_cube_mesh());
+    mat4_t projection_matrix = mat4_make_perspective(1.0f, 0.75f, 0.1f,
+                                                     100.0f);
+
+    // A row of cubes across the view, most of them off screen
+    for (int i = -20; i <= 20; ++i)
+    {
+        scene_object_t object;
+        object.rotation = { 0.3f * i, 0.7f, 0.0f };
+        object.translation = { 2.5f * i, 0.5f, 6.0f };
+        scene.objects.push_back(object);
+    }
+
+    geometry_view_t view;
+    view.light.direction = { 0.0f, 0.0f, 1.0f };
+    view.width = 800.0f;
+    view.height = 600.0f;
+    std::vector<triangle_t> triangles;
+    scene_assemble(scene, view, projection_matrix, triangles);
+    EXPECT_GT(scene.objects_drawn, 0u);
+    EXPECT_LT(scene.objects_drawn, scene.objects.size() / 2);
+    EXPECT_LT(scene.objects_clipped, scene.objects_drawn);
+
+    // Every object clipped, none skipped, gives the same triangles on screen
+    std::vector<triangle_t> expected;
+    transformed_mesh_t transformed;
+    for (const scene_object_t& object : scene.objects)
+    {
+        mat4_t world_matrix = scene_object_world_matrix(object);
+        transform_mesh(scene.meshes[0], world_matrix, projection_matrix,
+                       view.width, view.height, transformed);
+        geometry_view_t object_view = view;
+        object_view.world_matrix = world_matrix;
+        assemble_faces(scene.meshes[0], transformed, object_view, 0,
+                       N_CUBE_FACES, expected);
+    }
+    std::vector<triangle_t> on_screen;
+    for (const triangle_t& triangle : expected)
+    {
+        for (const vec4_t& point : triangle.points)
+        {
+            if (point.x >= 0.0f && point.x <= view.width && point.y >= 0.0f &&
+                point.y <= view.height)
+            {
+                on_screen.push_back(triangle);
+                break;
+            }
+        }
+    }
+    ASSERT_LE(on_screen.size(), triangles.size());
+    size_t next = 0;
+    for (const triangle_t& triangle : triangles)
+    {
+        if (next < on_screen.size() &&
+            triangle.points[0].x == on_screen[next].points[0].x &&
+            triangle.points[0].y == on_screen[next].points[0].y &&
+            triangle.points[1].x == on_screen[next].points[1].x &&
+            triangle.points[2].y == on_screen[next].points[2].y &&
+            triangle.color == on_screen[next].color)
+        {
+            ++next;
+        }
+    }
+    EXPECT_EQ(next, on_screen.size());
+}
+
+TEST(Scene, culling_uses_the_drawn_level)
+{
+    // A coarse level reaching far past the full mesh, as a level may
+    scene_t scene;
+    scene.meshes.push_back(make_sphere_mesh(24, 48));
+    mesh_t level = make_cube_mesh();
+    for (vec3_t& vertex : level.vertices)
+    {
+        vertex = vertex * 8.0f;
+    }
+    mesh_compute_face_planes(level);
+    mesh_compute_bounds(level);
+    scene.meshes[0].lods.push_back(level);
+    mat4_t projection_matrix = mat4_make_perspective(1.0f, 0.75f, 0.1f,
+                                                     100.0f);
+
+    // Far away, just above the view: the sphere is out of view, the level
+    // drawn for it is not
+    scene_object_t object;
+    object.translation = { 0.0f, 32.0f, 50.0f };
+    scene.objects.push_back(object);
+
+    geometry_view_t view;
+    view.light.direction = { 0.0f, 0.0f, 1.0f };
+    view.width = 800.0f;
+    view.height = 600.0f;
+    std::vector<triangle_t> triangles;
+    scene_assemble(scene, view, projection_matrix, triangles);
+    EXPECT_EQ(scene.objects_drawn, 1u);
+    EXPECT_FALSE(triangles.empty());
+
+    // Without LOD selection the sphere is skipped
+    scene.lod_selection = false;
+    scene_assemble(scene, view, projection_matrix, triangles);
+    EXPECT_EQ(scene.objects_drawn, 0u);
+    EXPECT_TRUE(triangles.empty());
+}
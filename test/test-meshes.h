@@ -0,0 +1,68 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <cmath>
+#include <utility>
+
+// Meshes shared by the tests. Face planes and bounds are computed, meshlets
+// are not.
+
+// Unit sphere around the origin, faces wound to face outward. The poles are
+// rings of 'segments' vertices at the same place.
+inline mesh_t make_sphere_mesh(int rings, int segments)
+{
+    mesh_t sphere = {};
+    for (int ring = 0; ring <= rings; ++ring)
+    {
+        float theta = 3.14159265f * ring / rings;
+        for (int segment = 0; segment < segments; ++segment)
+        {
+            float phi = 2.0f * 3.14159265f * segment / segments;
+            sphere.vertices.push_back({ sinf(theta) * cosf(phi), cosf(theta),
+                                        sinf(theta) * sinf(phi) });
+        }
+    }
+    for (int ring = 0; ring < rings; ++ring)
+    {
+        for (int segment = 0; segment < segments; ++segment)
+        {
+            int next = (segment + 1) % segments;
+            int quad[4] = { 1 + ring * segments + segment,
+                            1 + ring * segments + next,
+                            1 + (ring + 1) * segments + next,
+                            1 + (ring + 1) * segments + segment };
+            const int corners[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+            for (const int* corner : corners)
+            {
+                face_t face = {};
+                face.a = quad[corner[0]];
+                face.b = quad[corner[1]];
+                face.c = quad[corner[2]];
+                face.color = 0xFFFFFFFF;
+                vec3_t a = sphere.vertices[face.a - 1];
+                vec3_t normal = (sphere.vertices[face.b - 1] - a)
+                    .cross_product(sphere.vertices[face.c - 1] - a);
+                if (normal.dot_product(a) < 0.0f)
+                {
+                    std::swap(face.b, face.c);
+                }
+                sphere.faces.push_back(face);
+            }
+        }
+    }
+    mesh_compute_face_planes(sphere);
+    mesh_compute_bounds(sphere);
+    return sphere;
+}
+
+// The cube of cube_vertices and cube_faces, 2 wide around the origin
+inline mesh_t make_cube_mesh()
+{
+    mesh_t cube = {};
+    cube.vertices.assign(cube_vertices, cube_vertices + N_CUBE_VERTICES);
+    cube.faces.assign(cube_faces, cube_faces + N_CUBE_FACES);
+    mesh_compute_face_planes(cube);
+    mesh_compute_bounds(cube);
+    return cube;
+}
@@ -0,0 +1,257 @@
+#include "gtest/gtest.h"
+#include "display.h"
+#include "tiler.h"
+
+#include <cstdlib>
+#include <vector>
+
+static std::vector<triangle_t> random_triangles(int count, int extent)
+{
+    std::vector<triangle_t> triangles;
+    srand(42);
+    for (int i = 0; i < count; ++i)
+    {
+        triangle_t triangle = {};
+        for (int j = 0; j < 3; ++j)
+        {
+            triangle.points[j].x = (float)(rand() % extent - extent / 4);
+            triangle.points[j].y = (float)(rand() % extent - extent / 4);
+            triangle.points[j].w = 1.0f + (rand() % 1000) / 100.0f;
+            triangle.texcoord[j].u = (rand() % 1000) / 1000.0f;
+            triangle.texcoord[j].v = (rand() % 1000) / 1000.0f;
+        }
+        triangle.color = 0xFF000000 | (uint32_t)rand();
+        triangles.push_back(triangle);
+    }
+    return triangles;
+}
+
+TEST(Tiler, matches_serial_rendering)
+{
+    ColorBuffer color_buffer = {};
+    color_buffer.width = 300; // Partial tiles on the right and bottom
+    color_buffer.height = 170;
+    uint32_t size = color_buffer.width * color_buffer.height;
+    color_buffer.memory = (uint32_t*)malloc(sizeof(uint32_t) * size);
+    z_buffer = malloc(sizeof(float) * size);
+    float* hiz = (float*)malloc(sizeof(float) * hiz_width(color_buffer) *
+                                hiz_height(color_buffer));
+
+    texture_width = 16;
+    texture_height = 16;
+    std::vector<uint32_t> texture(texture_width * texture_height);
+    for (size_t i = 0; i < texture.size(); ++i)
+    {
+        texture[i] = 0xFF000000 | (uint32_t)(i * 2654435761u);
+    }
+
+    std::vector<triangle_t> triangles = random_triangles(500, 400);
+    tile_grid_t grid;
+    const RENDER_MODE modes[] = {
+        RENDER_MODE::WIREFRAME_DOTS,
+        RENDER_MODE::WIREFRAME_LINES,
+        RENDER_MODE::FILLED_TRIANGLES,
+        RENDER_MODE::FILLED_TRIANGLES_AND_WIREFRAME,
+        RENDER_MODE::TEXTURED_TRIANGLES,
+        RENDER_MODE::TEXTURED_TRIANGLES_AND_WIREFRAME
+    };
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        if (pass == 1)
+        {
+            // Scissor cutting through tiles
+            set_scissor(color_buffer, 37, 21, 150, 100);
+        }
+
+        for (int index = 0; index < 2 * 6 * NUM_DEPTH_FORMATS; ++index)
+        {
+            pipeline_state_t state = {};
+            state.render_mode = modes[index % 6];
+            state.depth_test = index / 6 % 2 == 0;
+            color_buffer.depth_format = (DEPTH_FORMAT)(index / 12);
+
+            // Reference without hierarchical z
+            hiz_buffer = nullptr;
+            clear_color_buffer(color_buffer, 0xFF18191A);
+            clear_z_buffer(color_buffer);
+            render_triangles(color_buffer, triangles, state, texture.data());
+            std::vector<uint32_t> serial(color_buffer.memory,
+                                         color_buffer.memory + size);
+
+            hiz_buffer = hiz;
+            clear_color_buffer(color_buffer, 0xFF18191A);
+            clear_z_buffer(color_buffer);
+            render_triangles_tiled(grid, color_buffer, triangles, state,
+                                   texture.data());
+            for (uint32_t i = 0; i < size; ++i)
+            {
+                ASSERT_EQ(serial[i], color_buffer.memory[i])
+                    << "Mode " << (int)state.render_mode << ", depth test "
+                    << state.depth_test << ", depth format "
+                    << (int)color_buffer.depth_format << ", pixel " << i;
+            }
+        }
+    }
+
+    free(color_buffer.memory);
+    free(z_buffer);
+    free(hiz);
+    z_buffer = nullptr;
+    hiz_buffer = nullptr;
+    texture_width = 0;
+    texture_height = 0;
+}
+
+TEST(Tiler, deferred_clear_matches_full_clear)
+{
+    ColorBuffer color_buffer = {};
+    color_buffer.width = 300;
+    color_buffer.height = 170;
+    uint32_t size = color_buffer.width * color_buffer.height;
+    color_buffer.memory = (uint32_t*)malloc(sizeof(uint32_t) * size);
+    z_buffer = malloc(sizeof(float) * size);
+    hiz_buffer = (float*)malloc(sizeof(float) * hiz_width(color_buffer) *
+                                hiz_height(color_buffer));
+
+    // Only the top left of the screen gets triangles, other tiles stay empty
+    std::vector<triangle_t> triangles = random_triangles(200, 150);
+    pipeline_state_t state = {};
+    state.render_mode = RENDER_MODE::FILLED_TRIANGLES_AND_WIREFRAME;
+
+    tile_grid_t eager_grid;
+    clear_color_buffer(color_buffer, 0xFF18191A);
+    clear_z_buffer(color_buffer);
+    draw_grid(color_buffer, 20, 0xFFE4E6EB);
+    render_triangles_tiled(eager_grid, color_buffer, triangles, state,
+                           nullptr);
+    std::vector<uint32_t> expected(color_buffer.memory,
+                                   color_buffer.memory + size);
+
+    tile_grid_t grid;
+    grid.background = [](ColorBuffer& buffer, const rect_t& bounds) {
+        draw_grid(buffer, 20, 0xFFE4E6EB, bounds);
+    };
+    for (int frame = 0; frame < 2; ++frame)
+    {
+        // Leftovers of a previous frame
+        clear_color_buffer(color_buffer, 0xFF00FF00);
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            ((float*)z_buffer)[i] = 0.0f;
+        }
+
+        tile_grid_clear(grid, color_buffer, 0xFF18191A);
+        render_triangles_tiled(grid, color_buffer, triangles, state, nullptr);
+        tile_grid_resolve(grid, color_buffer);
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            ASSERT_EQ(expected[i], color_buffer.memory[i])
+                << "Frame " << frame << ", pixel " << i;
+        }
+    }
+
+    free(color_buffer.memory);
+    free(z_buffer);
+    free(hiz_buffer);
+    z_buffer = nullptr;
+    hiz_buffer = nullptr;
+}
+
+TEST(Tiler, tiled_layout_matches_linear)
+{
+    ColorBuffer color_buffer = {};
+    color_buffer.width = 300;
+    color_buffer.height = 170;
+    uint32_t size = color_buffer.width * color_buffer.height;
+    hiz_buffer = (float*)malloc(sizeof(float) * hiz_width(color_buffer) *
+                                hiz_height(color_buffer));
+
+    texture_width = 16;
+    texture_height = 16;
+    std::vector<uint32_t> texture(texture_width * texture_height);
+    for (size_t i = 0; i < texture.size(); ++i)
+    {
+        texture[i] = 0xFF000000 | (uint32_t)(i * 2654435761u);
+    }
+
+    std::vector<triangle_t> triangles = random_triangles(500, 400);
+    tile_grid_t grid;
+    grid.background = [](ColorBuffer& buffer, const rect_t& bounds) {
+        draw_grid(buffer, 20, 0xFFE4E6EB, bounds);
+    };
+    for (int index = 0; index < 6 * NUM_DEPTH_FORMATS; ++index)
+    {
+        pipeline_state_t state = {};
+        state.render_mode = (RENDER_MODE)(index % 6);
+        state.depth_test = true;
+        color_buffer.depth_format = (DEPTH_FORMAT)(index / 6);
+
+        // Packed rows, blocks, then rows padded like a locked texture's
+        std::vector<uint32_t> frames[3];
+        std::vector<float> depths[3];
+        const FRAME_LAYOUT layouts[] = { FRAME_LAYOUT::LINEAR,
+                                         FRAME_LAYOUT::TILED,
+                                         FRAME_LAYOUT::LINEAR };
+        for (int layout = 0; layout < 3; ++layout)
+        {
+            set_frame_layout(color_buffer, layouts[layout]);
+            if (layout == 2)
+            {
+                color_buffer.pitch = color_buffer.width + 13;
+                free(color_buffer.memory);
+                free(z_buffer);
+                uint32_t padded = color_buffer_size(color_buffer);
+                color_buffer.memory = (uint32_t*)malloc(sizeof(uint32_t) *
+                                                        padded);
+                z_buffer = malloc(depth_format_size(color_buffer.depth_format) *
+                                  padded);
+            }
+            tile_grid_clear(grid, color_buffer, 0xFF18191A);
+            render_triangles_tiled(grid, color_buffer, triangles, state,
+                                   texture.data());
+            tile_grid_resolve(grid, color_buffer);
+
+            const uint32_t* pixels = linear_pixels(color_buffer);
+            uint32_t pitch = layout == 1 ? color_buffer.width
+                                         : row_pitch(color_buffer);
+            for (uint32_t y = 0; y < color_buffer.height; ++y)
+            {
+                frames[layout].insert(frames[layout].end(), pixels + pitch * y,
+                                      pixels + pitch * y + color_buffer.width);
+            }
+            if (color_buffer.depth_format == DEPTH_FORMAT::FLOAT32)
+            {
+                for (int y = 0; y < (int)color_buffer.height; ++y)
+                {
+                    for (int x = 0; x < (int)color_buffer.width; ++x)
+                    {
+                        depths[layout].push_back(((float*)z_buffer)[
+                            pixel_index(color_buffer, x, y)]);
+                    }
+                }
+            }
+        }
+
+        for (int layout = 1; layout < 3; ++layout)
+        {
+            for (uint32_t i = 0; i < size; ++i)
+            {
+                ASSERT_EQ(frames[0][i], frames[layout][i])
+                    << "Mode " << (int)state.render_mode << ", depth format "
+                    << (int)color_buffer.depth_format << ", layout " << layout
+                    << ", pixel " << i;
+            }
+            EXPECT_EQ(depths[0], depths[layout]);
+        }
+        color_buffer.pitch = 0;
+    }
+
+    free(color_buffer.memory);
+    free(color_buffer.staging);
+    free(z_buffer);
+    free(hiz_buffer);
+    z_buffer = nullptr;
+    hiz_buffer = nullptr;
+    texture_width = 0;
+    texture_height = 0;
+}